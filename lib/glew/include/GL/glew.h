@@ -19328,6 +19328,8 @@ GLEWAPI GLboolean GLEWAPIENTRY glewContextIsSupported (const GLEWContext *ctx, c
 
 #else /* GLEW_MX */
 
+/* oncgl: exported like in GLEW 2.0, only loads the GL entry points */
+GLEWAPI GLenum GLEWAPIENTRY glewContextInit (void);
 GLEWAPI GLenum GLEWAPIENTRY glewInit (void);
 GLEWAPI GLboolean GLEWAPIENTRY glewIsSupported (const char *name);
 #define glewIsExtensionSupported(x) glewIsSupported(x)
@@ -1,20 +1,62 @@
 #version 330 
 
 layout(location = 0) in vec3 position;
+#ifdef PACKED_VERTICES
+// octahedral encoded normal, see src/model/vertex_packing.h
+layout(location = 1) in vec2 octNormal;
+#else
 layout(location = 1) in vec3 normal;
+#endif
 layout(location = 2) in vec2 texCoords; 
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// world matrices of the scene graph nodes, four texels each, and the node of
+// every instance, see src/scene/scene.h
+uniform samplerBuffer worldTransforms;
+uniform usamplerBuffer instanceNodes;
+uniform int instanceOffset;
+
+// per-frame values, see src/renderer/frame_constants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 eyePos;
+    vec4 screenSize;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+};
 
 out vec2 TexCoord0; 
 out vec3 Normal0; 
 out vec3 WorldPos0; 
 
+#ifdef PACKED_VERTICES
+vec3 octDecode(vec2 oct) {
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                        n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+#endif
+
+mat4 instanceTransform() {
+    uint node = texelFetch(instanceNodes, instanceOffset + gl_InstanceID).r;
+    int texel = int(node) * 4;
+    return mat4(texelFetch(worldTransforms, texel),
+                texelFetch(worldTransforms, texel + 1),
+                texelFetch(worldTransforms, texel + 2),
+                texelFetch(worldTransforms, texel + 3));
+}
+
 void main() { 
 
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    mat4 model = instanceTransform();
+#ifdef PACKED_VERTICES
+    vec3 normal = octDecode(octNormal);
+#endif
+    gl_Position = viewProjection * model * vec4(position, 1.0);
     TexCoord0 = texCoords; 
     Normal0 = (model * vec4(normal, 0.0)).xyz;
     WorldPos0 = (model * vec4(position, 1.0)).xyz;
@@ -43,11 +43,16 @@ uniform sampler2D gPositionMap;
 uniform sampler2D gColorMap;
 uniform sampler2D gNormalMap;
 
-uniform DirectionalLight dirLight;
-
-uniform vec3 screenSize;
-
-uniform vec3 eyePos;
+// per-frame values, see src/renderer/frame_constants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 eyePos;
+    vec4 screenSize;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+};
 
 /**
  * OUT
@@ -70,7 +75,7 @@ vec4 calcLightInternal(Light light, vec3 lightDirection, vec3 worldPos, vec3 nor
   if (diffuseFactor > 0.0) {
     diffuseColor = vec4(light.color, 1.0) * light.diffuse_intensity * diffuseFactor;
 
-    vec3 viewDir = normalize(eyePos - worldPos);
+    vec3 viewDir = normalize(eyePos.xyz - worldPos);
     vec3 halfwayDir = normalize(-lightDirection + viewDir);
     float specularFactor = pow(max(dot(normal, halfwayDir), 0.0), 1024);
 
@@ -84,9 +89,13 @@ vec4 calcLightInternal(Light light, vec3 lightDirection, vec3 worldPos, vec3 nor
 
 vec4 calcDirectionalLight(vec3 worldPos, vec3 normal) {
 
-  vec4 lightDir = vec4(dirLight.direction, 1.0f);
+  DirectionalLight dirLight;
+  dirLight.direction = dirLightDirection.xyz;
+  dirLight.light.color = dirLightColor.rgb;
+  dirLight.light.ambient_intensity = dirLightDirection.w;
+  dirLight.light.diffuse_intensity = dirLightColor.w;
 
-  return calcLightInternal(dirLight.light, lightDir.xyz, worldPos, normal);
+  return calcLightInternal(dirLight.light, dirLight.direction, worldPos, normal);
 }
 
 void main() {
@@ -2,11 +2,43 @@
 
 layout(location = 0) in vec3 position;
 
+// per-frame values, see src/renderer/frame_constants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 eyePos;
+    vec4 screenSize;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+};
+
+#if defined(POINT_LIGHT)
+// parameters of all point lights and the lights of the instances,
+// see src/light/light_buffer.h
+uniform samplerBuffer pointLights;
+uniform usamplerBuffer lightSelection;
+// first entry of lightSelection drawn
+uniform int lightSelectionOffset;
+
+flat out int lightIndex;
+#elif !defined(TILED_LIGHTS)
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
 void main() { 
 
-    gl_Position = projection * view * model * vec4(position, 1.0);
+#if defined(POINT_LIGHT)
+    // the unit sphere scaled to the volume of the light of the instance
+    lightIndex = int(texelFetch(lightSelection,
+                               lightSelectionOffset + gl_InstanceID).r);
+    vec4 sphere = texelFetch(pointLights, lightIndex * 3);
+    gl_Position = viewProjection * vec4(position * sphere.w + sphere.xyz, 1.0);
+#elif defined(TILED_LIGHTS)
+    // one triangle covering the screen, drawn without vertex data
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+#else
+    gl_Position = viewProjection * model * vec4(position, 1.0);
+#endif
 }
@@ -43,11 +43,30 @@ uniform sampler2D gPositionMap;
 uniform sampler2D gColorMap;
 uniform sampler2D gNormalMap;
 
-uniform PointLight pointLight;
-
-uniform vec3 screenSize;
+// per-frame values, see src/renderer/frame_constants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 eyePos;
+    vec4 screenSize;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+};
 
-uniform vec3 eyePos;
+// parameters of all point lights, see src/light/light_buffer.h
+uniform samplerBuffer pointLights;
+#ifdef TILED_LIGHTS
+// offset and count of the light list of every cluster into lightIndices,
+// see src/light/tiled_light_culler.h
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+// slice of a view distance: log(distance) * x + y
+uniform vec2 lightSliceScaleBias;
+#else
+// light of the instance, see light_pass.vert
+flat in int lightIndex;
+#endif
 
 /**
  * OUT
@@ -70,7 +89,7 @@ vec4 calcLightInternal(Light light, vec3 lightDirection, vec3 worldPos, vec3 nor
   if (diffuseFactor > 0.0) {
     diffuseColor = vec4(light.color, 1.0) * light.diffuse_intensity * diffuseFactor;
 
-    vec3 viewDir = normalize(eyePos - worldPos);
+    vec3 viewDir = normalize(eyePos.xyz - worldPos);
     vec3 halfwayDir = normalize(-lightDirection + viewDir);
     // 0.25 -> material shininess
     float specularFactor = pow(max(dot(normal, halfwayDir), 0.0), 128 * 0.25);
@@ -83,7 +102,26 @@ vec4 calcLightInternal(Light light, vec3 lightDirection, vec3 worldPos, vec3 nor
   return (ambientColor + diffuseColor + specularColor);
 }
 
-vec4 calcPointLight(vec3 worldPos, vec3 normal) {
+PointLight fetchPointLight(int index) {
+
+  vec4 sphere = texelFetch(pointLights, index * 3);
+  vec4 color = texelFetch(pointLights, index * 3 + 1);
+  vec4 factors = texelFetch(pointLights, index * 3 + 2);
+
+  PointLight pointLight;
+  pointLight.position = sphere.xyz;
+  pointLight.light.color = color.rgb;
+  pointLight.light.ambient_intensity = color.a;
+  pointLight.light.diffuse_intensity = factors.x;
+  pointLight.atten.constant = factors.y;
+  pointLight.atten.linear = factors.z;
+  pointLight.atten.exponent = factors.w;
+  return pointLight;
+}
+
+vec4 calcPointLight(int index, vec3 worldPos, vec3 normal) {
+
+  PointLight pointLight = fetchPointLight(index);
 
   vec3 lightDirection = worldPos - pointLight.position;
   float lightDistance = length(lightDirection);
@@ -100,6 +138,13 @@ vec4 calcPointLight(vec3 worldPos, vec3 normal) {
   return color / attenuation;
 }
 
+// only pixels inside the volume of a light are lit by it
+bool insideLight(int index, vec3 worldPos) {
+
+  vec4 sphere = texelFetch(pointLights, index * 3);
+  return distance(worldPos, sphere.xyz) < sphere.w;
+}
+
 void main() {
 
   vec2 TexCoord = calcTexCoord();
@@ -107,5 +152,27 @@ void main() {
   vec3 Color = texture(gColorMap, TexCoord).xyz;
   vec3 Normal = normalize(texture(gNormalMap, TexCoord).xyz);
 
-  FragColor = vec4(Color, 1.0) * calcPointLight(WorldPos, Normal);
+#ifdef TILED_LIGHTS
+  ivec2 tile = ivec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE;
+  float viewDistance = max(-(view * vec4(WorldPos, 1.0)).z, 1e-4);
+  int slice = clamp(int(log(viewDistance) * lightSliceScaleBias.x +
+                        lightSliceScaleBias.y), 0, LIGHT_DEPTH_SLICES - 1);
+  int cluster = (tile.y * LIGHT_TILES_X + tile.x) * LIGHT_DEPTH_SLICES + slice;
+  uvec2 list = texelFetch(lightClusters, cluster).xy;
+
+  vec4 lighting = vec4(0.0);
+  for (uint i = 0u; i < list.y; i++) {
+    int index = int(texelFetch(lightIndices, int(list.x + i)).r);
+    if (insideLight(index, WorldPos)) {
+      lighting += calcPointLight(index, WorldPos, Normal);
+    }
+  }
+  FragColor = vec4(Color, 1.0) * lighting;
+#else
+  // the stencil only tells that some volume holds the pixel, not which one
+  if (!insideLight(lightIndex, WorldPos)) {
+    discard;
+  }
+  FragColor = vec4(Color, 1.0) * calcPointLight(lightIndex, WorldPos, Normal);
+#endif
 }
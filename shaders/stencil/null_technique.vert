@@ -2,11 +2,26 @@
 
 layout (location = 0) in vec3 position;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-frame values, see src/renderer/frame_constants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 eyePos;
+    vec4 screenSize;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+};
+
+// parameters of all point lights and the lights of the instances,
+// see src/light/light_buffer.h
+uniform samplerBuffer pointLights;
+uniform usamplerBuffer lightSelection;
 
 void main() {
 
-  gl_Position = projection * view * model * vec4(position, 1.0);
+  // the unit sphere scaled to the volume of the light of the instance
+  int lightIndex = int(texelFetch(lightSelection, gl_InstanceID).r);
+  vec4 sphere = texelFetch(pointLights, lightIndex * 3);
+  gl_Position = viewProjection * vec4(position * sphere.w + sphere.xyz, 1.0);
 }
@@ -0,0 +1,122 @@
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+namespace oncgl {
+
+Benchmark::Benchmark(unsigned int num_frames, Clock::time_point start,
+                     unsigned int warmup_frames) :
+    num_frames_(num_frames),
+    warmup_frames_(warmup_frames),
+    frame_(0),
+    start_(start),
+    time_to_first_frame_ms_(-1.0),
+    time_to_resident_ms_(-1.0) {
+
+  glGenQueries(2, queries_);
+  cpu_times_ms_.reserve(num_frames_);
+  gpu_times_ms_.reserve(num_frames_);
+}
+
+Benchmark::~Benchmark() {
+  glDeleteQueries(2, queries_);
+}
+
+void Benchmark::BeginFrame(Camera *camera) {
+
+  // the warmup frames already move along the path, so the first measured frame
+  // does not pay for anything that is only touched once
+  unsigned int total_frames = warmup_frames_ + num_frames_;
+  CameraPath((float) frame_ / total_frames, camera);
+
+  cpu_start_ = Clock::now();
+  glQueryCounter(queries_[ 0 ], GL_TIMESTAMP);
+}
+
+void Benchmark::EndFrame(bool assets_resident) {
+
+  glQueryCounter(queries_[ 1 ], GL_TIMESTAMP);
+  double cpu_ms = std::chrono::duration<double, std::milli>(
+      Clock::now() - cpu_start_).count();
+
+  // blocks until the GPU reached the end of the frame
+  GLuint64 start, end;
+  glGetQueryObjectui64v(queries_[ 0 ], GL_QUERY_RESULT, &start);
+  glGetQueryObjectui64v(queries_[ 1 ], GL_QUERY_RESULT, &end);
+  double gpu_ms = (end - start) / 1.0e6;
+
+  double since_start_ms = std::chrono::duration<double, std::milli>(
+      Clock::now() - start_).count();
+  if (time_to_first_frame_ms_ < 0.0) {
+    time_to_first_frame_ms_ = since_start_ms;
+  }
+  if (assets_resident && time_to_resident_ms_ < 0.0) {
+    time_to_resident_ms_ = since_start_ms;
+  }
+
+  if (frame_ >= warmup_frames_) {
+    cpu_times_ms_.push_back(cpu_ms);
+    gpu_times_ms_.push_back(gpu_ms);
+  }
+  frame_++;
+}
+
+bool Benchmark::Finished() const {
+  return frame_ >= warmup_frames_ + num_frames_;
+}
+
+void Benchmark::PrintReport(std::ostream &out) const {
+
+  out << std::fixed << std::setprecision(3);
+  out << "frame\tcpu_ms\tgpu_ms" << std::endl;
+  for (unsigned int i = 0; i < cpu_times_ms_.size(); ++i) {
+    out << i << "\t" << cpu_times_ms_[ i ] << "\t" << gpu_times_ms_[ i ] <<
+        std::endl;
+  }
+
+  out << K_GREEN << "Benchmark: " << cpu_times_ms_.size() << " frames (" <<
+      warmup_frames_ << " warmup frames skipped)" << K_RESET << std::endl;
+  PrintSummary(out, "cpu", cpu_times_ms_);
+  PrintSummary(out, "gpu", gpu_times_ms_);
+
+  out << "time_to_first_frame_ms\t" << time_to_first_frame_ms_ << std::endl;
+  if (time_to_resident_ms_ < 0.0) {
+    out << "time_to_fully_resident_ms\tnot reached" << std::endl;
+  } else {
+    out << "time_to_fully_resident_ms\t" << time_to_resident_ms_ << std::endl;
+  }
+}
+
+void Benchmark::PrintSummary(std::ostream &out, const char *name,
+                             std::vector<double> times) {
+
+  if (times.empty()) {
+    return;
+  }
+
+  std::sort(times.begin(), times.end());
+  double mean = std::accumulate(times.begin(), times.end(), 0.0) /
+      times.size();
+
+  out << name << "_ms\tmin " << times.front() <<
+      "\tmedian " << times[ times.size() / 2 ] <<
+      "\tmean " << mean <<
+      "\tmax " << times.back() << std::endl;
+}
+
+void Benchmark::CameraPath(float t, Camera *camera) {
+
+  // same height and distance as the interactive start position
+  const float radius = 60.0f;
+  const float height = 40.0f;
+  float angle = t * 2.0f * (float) M_PI;
+
+  camera->set_position(glm::vec3(radius * sinf(angle), height,
+                                 radius * cosf(angle)));
+  camera->LookAt(glm::vec3(0.0f, 0.0f, 0.0f));
+}
+
+} // namespace oncgl
@@ -0,0 +1,102 @@
+#ifndef ONCGL_BENCHMARK_BENCHMARK_H
+#define ONCGL_BENCHMARK_BENCHMARK_H
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "camera/camera.h"
+#include "misc/constants.h"
+
+namespace oncgl {
+
+/**
+ * Renders a fixed number of frames along a fixed camera path and measures the
+ * CPU and GPU time of every frame.
+ *
+ * The camera path only depends on the frame number, never on the time, so
+ * every run renders exactly the same images.
+ *
+ * Besides the frame times the time from program start to the first finished
+ * frame and to the first frame with all assets resident is reported.
+ */
+class Benchmark {
+ public:
+  typedef std::chrono::high_resolution_clock Clock;
+
+  /**
+   * @param num_frames      number of measured frames
+   * @param start           time the program started
+   * @param warmup_frames   frames rendered before measuring starts, they are
+   *                        not part of the report (shader compiles, uploads...)
+   */
+  Benchmark(unsigned int num_frames, Clock::time_point start,
+            unsigned int warmup_frames = 10);
+
+  ~Benchmark();
+
+  /**
+   * Move the camera to the position of the current frame on the path and start
+   * the timers. Must be called with a current OpenGL context.
+   *
+   * @param camera  camera to move
+   */
+  void BeginFrame(Camera *camera);
+
+  /**
+   * Stop the timers of the current frame
+   * This waits until the GPU finished the frame, so frames never overlap
+   *
+   * @param assets_resident   true if the frame was rendered with all textures
+   *                          and models, no placeholders
+   */
+  void EndFrame(bool assets_resident = true);
+
+  /**
+   * @returns true - if all frames are rendered
+   */
+  bool Finished() const;
+
+  /**
+   * Print the time of every frame and a summary (min, median, mean, max)
+   *
+   * @param out   stream to write the report to
+   */
+  void PrintReport(std::ostream &out) const;
+
+  /**
+   * Place the camera on the benchmark path
+   * The camera circles once around the scene while looking at its center.
+   *
+   * @param t       position on the path in [0, 1)
+   * @param camera  camera to place
+   */
+  static void CameraPath(float t, Camera *camera);
+
+ private:
+  unsigned int num_frames_;
+  unsigned int warmup_frames_;
+  unsigned int frame_;
+
+  // timestamp-queries for begin and end of a frame
+  GLuint queries_[2];
+  Clock::time_point cpu_start_;
+
+  Clock::time_point start_;
+  // -1 until reached
+  double time_to_first_frame_ms_;
+  double time_to_resident_ms_;
+
+  std::vector<double> cpu_times_ms_;
+  std::vector<double> gpu_times_ms_;
+
+  static void PrintSummary(std::ostream &out, const char *name,
+                           std::vector<double> times);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_BENCHMARK_BENCHMARK_H
@@ -71,8 +71,8 @@ void Camera::offset_orientation(float up_angle, float right_angle) {
 void Camera::LookAt(glm::vec3 position) {
   assert(position != position_);
   glm::vec3 direction = glm::normalize(position - position_);
-  vertical_angle_ = glm::radians(asinf(-direction.y));
-  horizontal_angle_ = -glm::radians(atan2f(-direction.x, -direction.z));
+  vertical_angle_ = glm::degrees(asinf(-direction.y));
+  horizontal_angle_ = -glm::degrees(atan2f(-direction.x, -direction.z));
   NormalizeAngles();
 }
 
@@ -0,0 +1,24 @@
+#include "camera/frustum.h"
+
+namespace oncgl {
+
+Frustum Frustum::FromMatrix(const glm::mat4 &matrix) {
+
+  // rows of the matrix, glm stores columns
+  glm::mat4 rows = glm::transpose(matrix);
+
+  Frustum frustum;
+  frustum.planes[ PLANE_LEFT ] = rows[ 3 ] + rows[ 0 ];
+  frustum.planes[ PLANE_RIGHT ] = rows[ 3 ] - rows[ 0 ];
+  frustum.planes[ PLANE_BOTTOM ] = rows[ 3 ] + rows[ 1 ];
+  frustum.planes[ PLANE_TOP ] = rows[ 3 ] - rows[ 1 ];
+  frustum.planes[ PLANE_NEAR ] = rows[ 3 ] + rows[ 2 ];
+  frustum.planes[ PLANE_FAR ] = rows[ 3 ] - rows[ 2 ];
+
+  for (int i = 0; i < NUM_PLANES; i++) {
+    frustum.planes[ i ] /= glm::length(glm::vec3(frustum.planes[ i ]));
+  }
+  return frustum;
+}
+
+} // namespace oncgl
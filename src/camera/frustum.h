@@ -0,0 +1,33 @@
+#ifndef ONCGL_CAMERA_FRUSTUM_H
+#define ONCGL_CAMERA_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+namespace oncgl {
+
+/**
+ * The six planes of a view frustum
+ * Every plane is (normal, distance) with the normal pointing inwards, so a
+ * point p is inside if dot(normal, p) + distance >= 0 for all planes.
+ */
+struct Frustum {
+
+  enum Plane {
+    PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR,
+    NUM_PLANES
+  };
+
+  glm::vec4 planes[ NUM_PLANES ];
+
+  /**
+   * Extract the planes from a view-projection matrix (Gribb, Hartmann)
+   *
+   * @param matrix  projection * view, e.g. Camera::matrix()
+   * @returns the frustum in world space, planes normalized
+   */
+  static Frustum FromMatrix(const glm::mat4 &matrix);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_CAMERA_FRUSTUM_H
@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 
+#include "renderer/gl_state.h"
+
 namespace oncgl {
 
 FrameBuffer::FrameBuffer() {
@@ -12,15 +14,16 @@ FrameBuffer::FrameBuffer() {
 FrameBuffer::~FrameBuffer() {
 
   if (fbo_ != 0) {
-    glDeleteFramebuffers(1, &fbo_);
+    GLState::Instance().DeleteFramebuffers(1, &fbo_);
   }
 
   if (textures_[ 0 ] != 0) {
-    glDeleteTextures(ARRAY_SIZE_IN_ELEMENTS(textures_), textures_);
+    GLState::Instance().DeleteTextures(ARRAY_SIZE_IN_ELEMENTS(textures_),
+                                       textures_);
   }
 
   if (depth_texture_ != 0) {
-    glDeleteTextures(1, &depth_texture_);
+    GLState::Instance().DeleteTextures(1, &depth_texture_);
   }
 }
 
@@ -28,7 +31,7 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
 
   // Create the FBO
   glGenFramebuffers(1, &fbo_);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+  GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
 
   std::cout << "Create Framebuffer number: " << fbo_ << std::endl;
   std::cout << "Size of Framebuffer: " << window_width << "x" <<
@@ -42,7 +45,7 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
   std::cout << "Generating " << ARRAY_SIZE_IN_ELEMENTS(textures_) <<
   " textures" << std::endl;
   for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(textures_); ++i) {
-    glBindTexture(GL_TEXTURE_2D, textures_[ i ]);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D, textures_[ i ]);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, window_width, window_height, 0,
                  GL_RGB, GL_FLOAT, NULL);
 
@@ -55,7 +58,7 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
   std::cout << "Generated all textures" << std::endl;
 
   // depth
-  glBindTexture(GL_TEXTURE_2D, depth_texture_);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, depth_texture_);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, window_width,
                window_height, 0, GL_DEPTH_STENCIL,
                GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
@@ -63,7 +66,7 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
                          GL_TEXTURE_2D, depth_texture_, 0);
 
   // final
-  glBindTexture(GL_TEXTURE_2D, final_texture_);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, final_texture_);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, window_width, window_height, 0,
                GL_RGB, GL_FLOAT, NULL);
   glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT4,
@@ -109,7 +112,7 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
   }
 
   // restore default FBO
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
   std::cout << K_GREEN << "Framebuffer #" << fbo_ << " created successfully " <<
   K_RESET << std::endl;
@@ -118,44 +121,44 @@ bool FrameBuffer::Init(GLuint window_width, GLuint window_height) {
 
 void FrameBuffer::StartFrame() {
 
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
-  glDrawBuffer(GL_COLOR_ATTACHMENT4);
+  GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+  GLState::Instance().DrawBuffer(GL_COLOR_ATTACHMENT4);
   glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void FrameBuffer::BindForGeometryPass() {
 
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+  GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
 
   GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0,
                             GL_COLOR_ATTACHMENT1,
                             GL_COLOR_ATTACHMENT2 };
 
-  glDrawBuffers(ARRAY_SIZE_IN_ELEMENTS(draw_buffers), draw_buffers);
+  GLState::Instance().DrawBuffers(ARRAY_SIZE_IN_ELEMENTS(draw_buffers),
+                                  draw_buffers);
 }
 
 void FrameBuffer::BindForStencilPass() {
 
   // must disable the draw buffers
-  glDrawBuffer(GL_NONE);
+  GLState::Instance().DrawBuffer(GL_NONE);
 }
 
 void FrameBuffer::BindForLightPass() {
 
-  glDrawBuffer(GL_COLOR_ATTACHMENT4);
+  GLState::Instance().DrawBuffer(GL_COLOR_ATTACHMENT4);
 
   for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(textures_); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D,
-                  textures_[ FRAMEBUFFER_TEXTURE_TYPE_POSITION + i ]);
+    GLState::Instance().BindTexture(
+        i, GL_TEXTURE_2D, textures_[ FRAMEBUFFER_TEXTURE_TYPE_POSITION + i ]);
   }
 }
 
-void FrameBuffer::BindForFinalPass() {
+void FrameBuffer::BindForFinalPass(GLuint output_framebuffer) {
 
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
-  glReadBuffer(GL_COLOR_ATTACHMENT4);
+  GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, output_framebuffer);
+  GLState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+  GLState::Instance().ReadBuffer(GL_COLOR_ATTACHMENT4);
 }
 
 } // namespace oncgl
@@ -60,8 +60,10 @@ class FrameBuffer {
   /**
    * Bind the framebuffer for the final-rendering pass
    * The final pass will draw the framebuffer to the backbuffer
+   *
+   * @param output_framebuffer  framebuffer to draw to, 0 is the backbuffer
    */
-  void BindForFinalPass();
+  void BindForFinalPass(GLuint output_framebuffer = 0);
 
  private:
   GLuint fbo_;
@@ -0,0 +1,118 @@
+#include "light/light_buffer.h"
+
+#include <algorithm>
+
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+const GLint LightBuffer::kTexelsPerLight;
+
+LightBuffer::LightBuffer() :
+    buffer_(0),
+    texture_(0),
+    size_(0),
+    selection_buffer_(0),
+    selection_texture_(0),
+    num_selected_(0) {
+
+  glGenBuffers(1, &buffer_);
+  glGenTextures(1, &texture_);
+  glGenBuffers(1, &selection_buffer_);
+  glGenTextures(1, &selection_texture_);
+
+  // the texture keeps referencing the buffer when Select replaces its data
+  glBindBuffer(GL_TEXTURE_BUFFER, selection_buffer_);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, selection_texture_);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, selection_buffer_);
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+LightBuffer::~LightBuffer() {
+
+  if (selection_texture_) {
+    GLState::Instance().DeleteTextures(1, &selection_texture_);
+  }
+  if (selection_buffer_) {
+    glDeleteBuffers(1, &selection_buffer_);
+  }
+  if (texture_) {
+    GLState::Instance().DeleteTextures(1, &texture_);
+  }
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+  }
+}
+
+void LightBuffer::Upload(const std::vector<PointLight> &lights,
+                         const std::vector<glm::vec4> &spheres) {
+
+  std::vector<glm::vec4> texels;
+  texels.reserve(lights.size() * kTexelsPerLight);
+  for (size_t i = 0; i < lights.size(); ++i) {
+    const PointLight &light = lights[ i ];
+    texels.push_back(spheres[ i ]);
+    texels.push_back(glm::vec4(light.color, light.ambient_intensity));
+    texels.push_back(glm::vec4(light.diffuse_intensity,
+                               light.attenuation.constant,
+                               light.attenuation.linear,
+                               light.attenuation.exp));
+  }
+  size_ = lights.size();
+
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+  // a texture buffer must not be empty
+  glBufferData(GL_TEXTURE_BUFFER,
+               texels.empty() ? sizeof(glm::vec4)
+                              : texels.size() * sizeof(glm::vec4),
+               texels.empty() ? NULL : texels.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, texture_);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_);
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::Bind(GLint unit) const {
+
+  GLState::Instance().BindTexture(unit, GL_TEXTURE_BUFFER, texture_);
+}
+
+void LightBuffer::Unbind(GLint unit) const {
+
+  GLState::Instance().BindTexture(unit, GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::Select(const std::vector<uint32_t> &indices) {
+
+  num_selected_ = indices.size();
+
+  // orphaned, the selection of the last frame may still be read
+  glBindBuffer(GL_TEXTURE_BUFFER, selection_buffer_);
+  glBufferData(GL_TEXTURE_BUFFER,
+               std::max<size_t>(indices.size(), 1) * sizeof(uint32_t),
+               indices.empty() ? NULL : indices.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::BindSelection(GLint unit) const {
+
+  GLState::Instance().BindTexture(unit, GL_TEXTURE_BUFFER, selection_texture_);
+}
+
+void LightBuffer::UnbindSelection(GLint unit) const {
+
+  GLState::Instance().BindTexture(unit, GL_TEXTURE_BUFFER, 0);
+}
+
+size_t LightBuffer::size() const {
+  return size_;
+}
+
+size_t LightBuffer::num_selected() const {
+  return num_selected_;
+}
+
+} // namespace oncgl
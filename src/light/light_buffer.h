@@ -0,0 +1,95 @@
+#ifndef ONCGL_LIGHT_LIGHT_BUFFER_H
+#define ONCGL_LIGHT_LIGHT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "light/lights.h"
+
+namespace oncgl {
+
+/**
+ * Parameters of all point lights in one texture buffer
+ *
+ * A light pass selects its light by index instead of uploading the light's
+ * fields as uniforms. Every light is kTexelsPerLight RGBA32F texels:
+ *   0: position.xyz, radius of the light volume
+ *   1: color.rgb, ambient intensity
+ *   2: diffuse intensity, constant, linear and exponential attenuation
+ * A second, R32UI texture buffer holds the indices of a selection of lights,
+ * instanced light passes read the light of an instance with
+ * texelFetch(selection, gl_InstanceID).
+ */
+class LightBuffer {
+ public:
+  static const GLint kTexelsPerLight = 3;
+
+  LightBuffer();
+
+  ~LightBuffer();
+
+  /**
+   * Replace all lights, the index of a light is its position in the vector
+   *
+   * @param lights    parameters of the lights
+   * @param spheres   center and bounding radius of every light, see
+   *                  LightCuller
+   */
+  void Upload(const std::vector<PointLight> &lights,
+              const std::vector<glm::vec4> &spheres);
+
+  /**
+   * Bind the buffer to a texture unit, read with texelFetch from a
+   * samplerBuffer
+   *
+   * @param unit  texture unit to bind to
+   */
+  void Bind(GLint unit) const;
+
+  void Unbind(GLint unit) const;
+
+  /**
+   * Replace the selected lights, e.g. the visible ones of a frame
+   *
+   * @param indices   indices of the lights, instance i draws light indices[i]
+   */
+  void Select(const std::vector<uint32_t> &indices);
+
+  /**
+   * Bind the selection to a texture unit, read with texelFetch from a
+   * usamplerBuffer
+   *
+   * @param unit  texture unit to bind to
+   */
+  void BindSelection(GLint unit) const;
+
+  void UnbindSelection(GLint unit) const;
+
+  size_t size() const;
+
+  // lights of the last Select
+  size_t num_selected() const;
+
+ private:
+  GLuint buffer_;
+  GLuint texture_;
+  size_t size_;
+
+  GLuint selection_buffer_;
+  GLuint selection_texture_;
+  size_t num_selected_;
+
+  //copying disabled
+  LightBuffer(const LightBuffer &);
+
+  const LightBuffer &operator=(const LightBuffer &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_LIGHT_LIGHT_BUFFER_H
@@ -0,0 +1,215 @@
+#include "light/light_culler.h"
+
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "camera/frustum.h"
+
+namespace oncgl {
+
+const float LightCuller::kDefaultMinScreenArea = 1.0f;
+
+namespace {
+
+// only these fields of a light decide its radius
+bool SameRadius(const PointLight &a, const PointLight &b) {
+
+  return a.color == b.color && a.diffuse_intensity == b.diffuse_intensity &&
+      a.attenuation.constant == b.attenuation.constant &&
+      a.attenuation.linear == b.attenuation.linear &&
+      a.attenuation.exp == b.attenuation.exp;
+}
+
+/**
+ * Test one sphere against the frustum and its projected size, like the SSE
+ * path of Cull
+ *
+ * @param w_row         last row of the view-projection, the view depth
+ * @param size_scale    pixels per unit of radius at view depth 1
+ * @param min_radius    radius in pixels of a circle of the minimum area
+ * @param small         set to true if the sphere is too small
+ * @returns false - if the sphere is outside or too small
+ */
+bool TestSphere(float x, float y, float z, float radius,
+                const Frustum &frustum, const glm::vec4 &w_row,
+                float size_scale, float min_radius, bool *small) {
+
+  *small = false;
+  for (int i = 0; i < Frustum::NUM_PLANES; ++i) {
+    const glm::vec4 &plane = frustum.planes[ i ];
+    // negated, so a NaN radius is outside like in the SSE path
+    if (!(plane.x * x + plane.y * y + plane.z * z + plane.w >= -radius)) {
+      return false;
+    }
+  }
+  // radius * size_scale / nearest_depth >= min_radius, without dividing, a
+  // sphere around the near plane always passes
+  float nearest_depth = w_row.x * x + w_row.y * y + w_row.z * z + w_row.w -
+      radius;
+  *small = !(radius * size_scale >= min_radius * nearest_depth);
+  return !*small;
+}
+
+} // namespace
+
+LightCuller::LightCuller() :
+    min_screen_area_(kDefaultMinScreenArea),
+    radius_updates_(0) {
+
+  stats_.tested = 0;
+  stats_.outside = 0;
+  stats_.small = 0;
+  stats_.occluded = 0;
+  stats_.visible = 0;
+}
+
+bool LightCuller::set_lights(const std::vector<PointLight> &lights) {
+
+  bool changed = lights.size() != lights_.size();
+  spheres_.resize(lights.size());
+  for (size_t i = 0; i < lights.size(); ++i) {
+    const PointLight &light = lights[ i ];
+    bool known = i < lights_.size();
+    if (!known || !SameRadius(light, lights_[ i ])) {
+      spheres_[ i ].w = light.CalcBoundingSphere();
+      radius_updates_++;
+      changed = true;
+    } else if (light.position != lights_[ i ].position ||
+               light.ambient_intensity != lights_[ i ].ambient_intensity) {
+      changed = true;
+    }
+    spheres_[ i ] = glm::vec4(light.position, spheres_[ i ].w);
+  }
+  lights_ = lights;
+
+  xs_.resize(spheres_.size());
+  ys_.resize(spheres_.size());
+  zs_.resize(spheres_.size());
+  radii_.resize(spheres_.size());
+  for (size_t i = 0; i < spheres_.size(); ++i) {
+    xs_[ i ] = spheres_[ i ].x;
+    ys_[ i ] = spheres_[ i ].y;
+    zs_[ i ] = spheres_[ i ].z;
+    radii_[ i ] = spheres_[ i ].w;
+  }
+  return changed;
+}
+
+void LightCuller::set_min_screen_area(float pixels) {
+  min_screen_area_ = pixels;
+}
+
+void LightCuller::Cull(const glm::mat4 &view_projection,
+                       const glm::mat4 &projection, float screen_height,
+                       const OcclusionBuffer *occlusion,
+                       std::vector<uint32_t> *visible) {
+
+  visible->clear();
+  stats_.tested = spheres_.size();
+  stats_.outside = 0;
+  stats_.small = 0;
+  stats_.occluded = 0;
+
+  Frustum frustum = Frustum::FromMatrix(view_projection);
+  // clip w of a point is its view depth
+  glm::vec4 w_row(view_projection[ 0 ][ 3 ], view_projection[ 1 ][ 3 ],
+                  view_projection[ 2 ][ 3 ], view_projection[ 3 ][ 3 ]);
+  float size_scale = projection[ 1 ][ 1 ] * 0.5f * screen_height;
+  float min_radius = std::sqrt(min_screen_area_ / static_cast<float>(M_PI));
+
+  size_t i = 0;
+#ifdef __SSE__
+  __m128 planes[ Frustum::NUM_PLANES ][ 4 ];
+  for (int p = 0; p < Frustum::NUM_PLANES; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[ p ][ c ] = _mm_set1_ps(frustum.planes[ p ][ c ]);
+    }
+  }
+  const __m128 w_x = _mm_set1_ps(w_row.x);
+  const __m128 w_y = _mm_set1_ps(w_row.y);
+  const __m128 w_z = _mm_set1_ps(w_row.z);
+  const __m128 w_w = _mm_set1_ps(w_row.w);
+  const __m128 scale = _mm_set1_ps(size_scale);
+  const __m128 min_r = _mm_set1_ps(min_radius);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= spheres_.size(); i += 4) {
+    __m128 x = _mm_loadu_ps(&xs_[ i ]);
+    __m128 y = _mm_loadu_ps(&ys_[ i ]);
+    __m128 z = _mm_loadu_ps(&zs_[ i ]);
+    __m128 radius = _mm_loadu_ps(&radii_[ i ]);
+    __m128 negative_radius = _mm_sub_ps(zero, radius);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < Frustum::NUM_PLANES; ++p) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes[ p ][ 0 ], x),
+                     _mm_mul_ps(planes[ p ][ 1 ], y)),
+          _mm_add_ps(_mm_mul_ps(planes[ p ][ 2 ], z), planes[ p ][ 3 ]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+    }
+
+    __m128 nearest_depth = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(w_x, x), _mm_mul_ps(w_y, y)),
+                   _mm_add_ps(_mm_mul_ps(w_z, z), w_w)),
+        radius);
+    __m128 large = _mm_cmpge_ps(_mm_mul_ps(radius, scale),
+                                _mm_mul_ps(min_r, nearest_depth));
+
+    int inside_mask = _mm_movemask_ps(inside);
+    int visible_mask = _mm_movemask_ps(_mm_and_ps(inside, large));
+    for (int lane = 0; lane < 4; ++lane) {
+      if (!(inside_mask & (1 << lane))) {
+        stats_.outside++;
+      } else if (!(visible_mask & (1 << lane))) {
+        stats_.small++;
+      } else {
+        visible->push_back(i + lane);
+      }
+    }
+  }
+#endif
+  for (; i < spheres_.size(); ++i) {
+    bool small;
+    if (TestSphere(xs_[ i ], ys_[ i ], zs_[ i ], radii_[ i ], frustum, w_row,
+                   size_scale, min_radius, &small)) {
+      visible->push_back(i);
+    } else if (small) {
+      stats_.small++;
+    } else {
+      stats_.outside++;
+    }
+  }
+
+  // the occlusion buffer tests boxes one at a time
+  if (occlusion) {
+    size_t kept = 0;
+    for (size_t j = 0; j < visible->size(); ++j) {
+      const glm::vec4 &sphere = spheres_[ (*visible)[ j ]];
+      glm::vec3 extent(sphere.w);
+      if (occlusion->TestBox(glm::vec3(sphere) - extent,
+                             glm::vec3(sphere) + extent)) {
+        (*visible)[ kept++ ] = (*visible)[ j ];
+      }
+    }
+    stats_.occluded = visible->size() - kept;
+    visible->resize(kept);
+  }
+  stats_.visible = visible->size();
+}
+
+const std::vector<glm::vec4> &LightCuller::spheres() const {
+  return spheres_;
+}
+
+const LightCuller::Stats &LightCuller::stats() const {
+  return stats_;
+}
+
+size_t LightCuller::radius_updates() const {
+  return radius_updates_;
+}
+
+} // namespace oncgl
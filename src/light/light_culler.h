@@ -0,0 +1,110 @@
+#ifndef ONCGL_LIGHT_LIGHT_CULLER_H
+#define ONCGL_LIGHT_LIGHT_CULLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "light/lights.h"
+#include "scene/occlusion_buffer.h"
+
+namespace oncgl {
+
+/**
+ * Visibility of the point lights, decided on the CPU before the light passes
+ *
+ * The bounding spheres are kept in structure of arrays and tested four at a
+ * time with SSE against the planes of the view frustum and for their
+ * projected size: a sphere whose projected circle covers less than
+ * min_screen_area pixels is dropped. The survivors can be tested against the
+ * CPU occlusion buffer. Only the visible lights reach the light passes, a
+ * culled light costs nothing on the GPU.
+ * The radius of a light only changes with its color, intensity and
+ * attenuation, so it is cached and only recomputed when one of those changes.
+ * Does not touch OpenGL.
+ */
+class LightCuller {
+ public:
+  // lights covering fewer pixels are culled by default
+  static const float kDefaultMinScreenArea;
+
+  // counters of the last Cull
+  struct Stats {
+    size_t tested;
+    // outside the view frustum
+    size_t outside;
+    // projected smaller than the minimum screen area
+    size_t small;
+    // hidden behind the occluders
+    size_t occluded;
+    size_t visible;
+  };
+
+  LightCuller();
+
+  /**
+   * Update the lights, a light is identified by its position in the vector
+   * like in LightBuffer
+   * Radii are only recomputed for new lights and for lights whose color,
+   * intensity or attenuation changed.
+   *
+   * @returns true - if any light changed
+   */
+  bool set_lights(const std::vector<PointLight> &lights);
+
+  /**
+   * @param pixels  minimum area of the projected sphere, 0 keeps every light
+   *                in the frustum
+   */
+  void set_min_screen_area(float pixels);
+
+  /**
+   * Collect the visible lights
+   *
+   * @param view_projection   projection * view of the camera
+   * @param projection        symmetric perspective projection of the camera
+   * @param screen_height     height of the screen in pixels
+   * @param occlusion         occluders to test the lights against, NULL skips
+   *                          the occlusion test
+   * @param visible           receives the indices of the visible lights in
+   *                          ascending order
+   */
+  void Cull(const glm::mat4 &view_projection, const glm::mat4 &projection,
+            float screen_height, const OcclusionBuffer *occlusion,
+            std::vector<uint32_t> *visible);
+
+  // center and radius of every light
+  const std::vector<glm::vec4> &spheres() const;
+
+  const Stats &stats() const;
+
+  // radii computed since the lights were first set
+  size_t radius_updates() const;
+
+ private:
+  // lights as of the last set_lights, to find the changed ones
+  std::vector<PointLight> lights_;
+  std::vector<glm::vec4> spheres_;
+
+  // the spheres in structure of arrays
+  std::vector<float> xs_;
+  std::vector<float> ys_;
+  std::vector<float> zs_;
+  std::vector<float> radii_;
+
+  float min_screen_area_;
+  Stats stats_;
+  size_t radius_updates_;
+
+  //copying disabled
+  LightCuller(const LightCuller &);
+
+  const LightCuller &operator=(const LightCuller &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_LIGHT_LIGHT_CULLER_H
@@ -54,7 +54,7 @@ struct PointLight : public Light {
    *
    * @returns size of the bounding-box
    */
-  float CalcBoundingSphere() {
+  float CalcBoundingSphere() const {
 
     float max_channel = glm::max(glm::max(color.r, color.g), color.b);
     return (-attenuation.linear +
@@ -0,0 +1,488 @@
+#include "light/tiled_light_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+const int TiledLightCuller::kTileSize;
+const int TiledLightCuller::kDefaultDepthSlices;
+
+namespace {
+
+// the terms of a symmetric perspective projection the culler needs
+struct Projection {
+
+  // projection[ 0 ][ 0 ] and projection[ 1 ][ 1 ]
+  float scale_x;
+  float scale_y;
+  // projection[ 2 ][ 2 ] and projection[ 3 ][ 2 ]
+  float depth_scale;
+  float depth_offset;
+  float near_plane;
+};
+
+// screen rectangle in NDC (min x, min y, max x, max y), window depth of the
+// nearest point and view distance of the nearest and farthest point of a
+// projected sphere
+const int kNumBounds = 7;
+
+/**
+ * Bound a view space sphere on the screen
+ * The rectangle bounds the view space box of the sphere, the part in front of
+ * the near plane.
+ *
+ * @returns false - if the sphere is behind the near plane
+ */
+bool ProjectSphere(const glm::vec3 &center, float radius,
+                   const Projection &projection, float bounds[ kNumBounds ]) {
+
+  // distances along the view direction
+  float far_distance = radius - center.z;
+  if (far_distance < projection.near_plane) {
+    return false;
+  }
+  float near_distance = std::max(-center.z - radius, projection.near_plane);
+  float inverse_near = 1.0f / near_distance;
+  float inverse_far = 1.0f / far_distance;
+
+  // an edge left of the view axis is farthest out when nearest, one right of
+  // it when farthest
+  float min_x = center.x - radius;
+  float max_x = center.x + radius;
+  float min_y = center.y - radius;
+  float max_y = center.y + radius;
+  bounds[ 0 ] = projection.scale_x * min_x *
+      (min_x < 0.0f ? inverse_near : inverse_far);
+  bounds[ 1 ] = projection.scale_y * min_y *
+      (min_y < 0.0f ? inverse_near : inverse_far);
+  bounds[ 2 ] = projection.scale_x * max_x *
+      (max_x > 0.0f ? inverse_near : inverse_far);
+  bounds[ 3 ] = projection.scale_y * max_y *
+      (max_y > 0.0f ? inverse_near : inverse_far);
+  bounds[ 4 ] = 0.5f * (projection.depth_offset * inverse_near -
+                        projection.depth_scale) + 0.5f;
+  bounds[ 5 ] = near_distance;
+  bounds[ 6 ] = far_distance;
+  return true;
+}
+
+#ifdef __SSE__
+// mask ? a : b
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/**
+ * ProjectSphere for four view space spheres in structure of arrays
+ *
+ * @returns bit i set if sphere i is in front of the near plane
+ */
+int ProjectSpheres(__m128 x, __m128 y, __m128 z, __m128 radius,
+                   const Projection &projection,
+                   __m128 bounds[ kNumBounds ]) {
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 near_plane = _mm_set1_ps(projection.near_plane);
+  const __m128 scale_x = _mm_set1_ps(projection.scale_x);
+  const __m128 scale_y = _mm_set1_ps(projection.scale_y);
+
+  __m128 far_distance = _mm_sub_ps(radius, z);
+  __m128 near_distance = _mm_max_ps(
+      _mm_sub_ps(_mm_sub_ps(zero, z), radius), near_plane);
+  __m128 inverse_near = _mm_div_ps(one, near_distance);
+  __m128 inverse_far = _mm_div_ps(one, far_distance);
+
+  __m128 min_x = _mm_sub_ps(x, radius);
+  __m128 max_x = _mm_add_ps(x, radius);
+  __m128 min_y = _mm_sub_ps(y, radius);
+  __m128 max_y = _mm_add_ps(y, radius);
+  bounds[ 0 ] = _mm_mul_ps(_mm_mul_ps(scale_x, min_x), Select(
+      _mm_cmplt_ps(min_x, zero), inverse_near, inverse_far));
+  bounds[ 1 ] = _mm_mul_ps(_mm_mul_ps(scale_y, min_y), Select(
+      _mm_cmplt_ps(min_y, zero), inverse_near, inverse_far));
+  bounds[ 2 ] = _mm_mul_ps(_mm_mul_ps(scale_x, max_x), Select(
+      _mm_cmpgt_ps(max_x, zero), inverse_near, inverse_far));
+  bounds[ 3 ] = _mm_mul_ps(_mm_mul_ps(scale_y, max_y), Select(
+      _mm_cmpgt_ps(max_y, zero), inverse_near, inverse_far));
+  bounds[ 4 ] = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(
+      _mm_mul_ps(_mm_set1_ps(projection.depth_offset), inverse_near),
+      _mm_set1_ps(projection.depth_scale))), half);
+  bounds[ 5 ] = near_distance;
+  bounds[ 6 ] = far_distance;
+
+  return _mm_movemask_ps(_mm_cmpge_ps(far_distance, near_plane));
+}
+#endif
+
+} // namespace
+
+TiledLightCuller::TiledLightCuller(int width, int height, int depth_slices) :
+    width_(width),
+    height_(height),
+    tiles_x_((width + kTileSize - 1) / kTileSize),
+    tiles_y_((height + kTileSize - 1) / kTileSize),
+    depth_slices_(std::max(depth_slices, 1)),
+    slice_scale_(0.0f),
+    slice_bias_(0.0f),
+    far_depths_(tiles_x_ * tiles_y_, 1.0f),
+    clusters_(tiles_x_ * tiles_y_ * depth_slices_ * 2, 0),
+    max_cluster_lights_(0),
+    cluster_buffer_(0),
+    cluster_texture_(0),
+    index_buffer_(0),
+    index_texture_(0) {
+
+  GLState &state = GLState::Instance();
+  GLuint buffers[ 2 ];
+  GLuint textures[ 2 ];
+  GLenum formats[ 2 ] = { GL_RG32UI, GL_R32UI };
+  glGenBuffers(2, buffers);
+  glGenTextures(2, textures);
+  for (int i = 0; i < 2; ++i) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[ i ]);
+    // a texture buffer must not be empty
+    glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(uint32_t), NULL,
+                 GL_STREAM_DRAW);
+    state.BindTexture(GL_TEXTURE_BUFFER, textures[ i ]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[ i ], buffers[ i ]);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  state.BindTexture(GL_TEXTURE_BUFFER, 0);
+
+  cluster_buffer_ = buffers[ 0 ];
+  cluster_texture_ = textures[ 0 ];
+  index_buffer_ = buffers[ 1 ];
+  index_texture_ = textures[ 1 ];
+}
+
+TiledLightCuller::~TiledLightCuller() {
+
+  GLuint textures[] = { cluster_texture_, index_texture_ };
+  GLuint buffers[] = { cluster_buffer_, index_buffer_ };
+  GLState::Instance().DeleteTextures(2, textures);
+  glDeleteBuffers(2, buffers);
+}
+
+void TiledLightCuller::set_spheres(const std::vector<glm::vec4> &spheres) {
+  spheres_ = spheres;
+}
+
+void TiledLightCuller::ProjectLights(const std::vector<uint32_t> &visible,
+                                     const glm::mat4 &view,
+                                     const glm::mat4 &projection) {
+
+  Projection terms;
+  terms.scale_x = projection[ 0 ][ 0 ];
+  terms.scale_y = projection[ 1 ][ 1 ];
+  terms.depth_scale = projection[ 2 ][ 2 ];
+  terms.depth_offset = projection[ 3 ][ 2 ];
+  terms.near_plane = terms.depth_offset / (terms.depth_scale - 1.0f);
+  float far_plane = terms.depth_offset / (terms.depth_scale + 1.0f);
+
+  slice_scale_ = depth_slices_ / std::log(far_plane / terms.near_plane);
+  slice_bias_ = -std::log(terms.near_plane) * slice_scale_;
+
+  binned_.clear();
+  rects_.clear();
+  slices_.clear();
+  near_depths_.clear();
+
+  // NDC bounds of one light to its tile rectangle and slice range
+  const float width = static_cast<float>(width_);
+  const float height = static_cast<float>(height_);
+  auto slice_of = [&](float distance) {
+    float slice = std::log(distance) * slice_scale_ + slice_bias_;
+    return static_cast<int>(
+        std::min(std::max(slice, 0.0f), depth_slices_ - 1.0f));
+  };
+  auto bin = [&](uint32_t light, const float bounds[ kNumBounds ]) {
+    float min_x = (bounds[ 0 ] * 0.5f + 0.5f) * width;
+    float min_y = (bounds[ 1 ] * 0.5f + 0.5f) * height;
+    float max_x = (bounds[ 2 ] * 0.5f + 0.5f) * width;
+    float max_y = (bounds[ 3 ] * 0.5f + 0.5f) * height;
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height) {
+      return;
+    }
+    binned_.push_back(light);
+    rects_.push_back(static_cast<int>(std::max(min_x, 0.0f)) / kTileSize);
+    rects_.push_back(static_cast<int>(std::max(min_y, 0.0f)) / kTileSize);
+    rects_.push_back(static_cast<int>(std::min(max_x, width - 1.0f)) /
+                     kTileSize);
+    rects_.push_back(static_cast<int>(std::min(max_y, height - 1.0f)) /
+                     kTileSize);
+    slices_.push_back(slice_of(bounds[ 5 ]));
+    slices_.push_back(slice_of(bounds[ 6 ]));
+    near_depths_.push_back(bounds[ 4 ]);
+  };
+
+  size_t i = 0;
+#ifdef __SSE__
+  const __m128 view_columns[ 4 ][ 3 ] = {
+      { _mm_set1_ps(view[ 0 ][ 0 ]), _mm_set1_ps(view[ 0 ][ 1 ]),
+        _mm_set1_ps(view[ 0 ][ 2 ]) },
+      { _mm_set1_ps(view[ 1 ][ 0 ]), _mm_set1_ps(view[ 1 ][ 1 ]),
+        _mm_set1_ps(view[ 1 ][ 2 ]) },
+      { _mm_set1_ps(view[ 2 ][ 0 ]), _mm_set1_ps(view[ 2 ][ 1 ]),
+        _mm_set1_ps(view[ 2 ][ 2 ]) },
+      { _mm_set1_ps(view[ 3 ][ 0 ]), _mm_set1_ps(view[ 3 ][ 1 ]),
+        _mm_set1_ps(view[ 3 ][ 2 ]) }
+  };
+  for (; i + 4 <= visible.size(); i += 4) {
+    const glm::vec4 &s0 = spheres_[ visible[ i ]];
+    const glm::vec4 &s1 = spheres_[ visible[ i + 1 ]];
+    const glm::vec4 &s2 = spheres_[ visible[ i + 2 ]];
+    const glm::vec4 &s3 = spheres_[ visible[ i + 3 ]];
+    __m128 world[ 4 ] = {
+        _mm_set_ps(s3.x, s2.x, s1.x, s0.x),
+        _mm_set_ps(s3.y, s2.y, s1.y, s0.y),
+        _mm_set_ps(s3.z, s2.z, s1.z, s0.z),
+        _mm_set_ps(s3.w, s2.w, s1.w, s0.w)
+    };
+
+    // the centers to view space
+    __m128 center[ 3 ];
+    for (int row = 0; row < 3; ++row) {
+      center[ row ] = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(view_columns[ 0 ][ row ], world[ 0 ]),
+                     _mm_mul_ps(view_columns[ 1 ][ row ], world[ 1 ])),
+          _mm_add_ps(_mm_mul_ps(view_columns[ 2 ][ row ], world[ 2 ]),
+                     view_columns[ 3 ][ row ]));
+    }
+
+    __m128 bounds[ kNumBounds ];
+    int in_front = ProjectSpheres(center[ 0 ], center[ 1 ], center[ 2 ],
+                                  world[ 3 ], terms, bounds);
+    if (!in_front) {
+      continue;
+    }
+    float lanes[ kNumBounds ][ 4 ];
+    for (int b = 0; b < kNumBounds; ++b) {
+      _mm_storeu_ps(lanes[ b ], bounds[ b ]);
+    }
+    for (int lane = 0; lane < 4; ++lane) {
+      if (in_front & (1 << lane)) {
+        float light_bounds[ kNumBounds ];
+        for (int b = 0; b < kNumBounds; ++b) {
+          light_bounds[ b ] = lanes[ b ][ lane ];
+        }
+        bin(visible[ i + lane ], light_bounds);
+      }
+    }
+  }
+#endif
+  for (; i < visible.size(); ++i) {
+    const glm::vec4 &sphere = spheres_[ visible[ i ]];
+    glm::vec3 center(view * glm::vec4(glm::vec3(sphere), 1.0f));
+    float bounds[ kNumBounds ];
+    if (ProjectSphere(center, sphere.w, terms, bounds)) {
+      bin(visible[ i ], bounds);
+    }
+  }
+}
+
+void TiledLightCuller::ComputeFarDepths(const OcclusionBuffer *occlusion) {
+
+  std::fill(far_depths_.begin(), far_depths_.end(), 1.0f);
+  if (!occlusion || occlusion->num_triangles() == 0) {
+    return;
+  }
+
+  // pixels of the occlusion buffer per screen pixel
+  float scale_x = occlusion->width() / static_cast<float>(width_);
+  float scale_y = occlusion->height() / static_cast<float>(height_);
+  int occlusion_tiles_x = occlusion->width() / OcclusionBuffer::kTileWidth;
+  int occlusion_tiles_y = occlusion->height() / OcclusionBuffer::kTileHeight;
+
+  for (int y = 0; y < tiles_y_; ++y) {
+    int min_y = static_cast<int>(y * kTileSize * scale_y) /
+        OcclusionBuffer::kTileHeight;
+    int max_y = std::min(
+        occlusion_tiles_y - 1,
+        (static_cast<int>(std::ceil(std::min((y + 1) * kTileSize, height_) *
+                                    scale_y)) - 1) /
+            OcclusionBuffer::kTileHeight);
+    for (int x = 0; x < tiles_x_; ++x) {
+      int min_x = static_cast<int>(x * kTileSize * scale_x) /
+          OcclusionBuffer::kTileWidth;
+      int max_x = std::min(
+          occlusion_tiles_x - 1,
+          (static_cast<int>(std::ceil(std::min((x + 1) * kTileSize, width_) *
+                                      scale_x)) - 1) /
+              OcclusionBuffer::kTileWidth);
+
+      float far_depth = 0.0f;
+      for (int oy = min_y; oy <= max_y; ++oy) {
+        for (int ox = min_x; ox <= max_x; ++ox) {
+          far_depth = std::max(far_depth, occlusion->tile_depth(ox, oy));
+        }
+      }
+      far_depths_[ y * tiles_x_ + x ] = far_depth;
+    }
+  }
+}
+
+template <typename Visitor>
+void TiledLightCuller::VisitClusters(size_t binned, int first_row,
+                                     int end_row, Visitor visit) const {
+
+  const int *rect = &rects_[ binned * 4 ];
+  int first_slice = slices_[ binned * 2 ];
+  int last_slice = slices_[ binned * 2 + 1 ];
+  float near_depth = near_depths_[ binned ];
+  auto visit_tile = [&](int tile) {
+    for (int slice = first_slice; slice <= last_slice; ++slice) {
+      visit(tile * depth_slices_ + slice);
+    }
+  };
+
+#ifdef __SSE__
+  __m128 light_depth = _mm_set1_ps(near_depth);
+#endif
+  int last_row = std::min(rect[ 3 ], end_row - 1);
+  for (int y = std::max(rect[ 1 ], first_row); y <= last_row; ++y) {
+    const float *row = &far_depths_[ y * tiles_x_ ];
+    int x = rect[ 0 ];
+#ifdef __SSE__
+    for (; x + 4 <= rect[ 2 ] + 1; x += 4) {
+      int mask = _mm_movemask_ps(
+          _mm_cmplt_ps(light_depth, _mm_loadu_ps(row + x)));
+      for (int lane = 0; lane < 4; ++lane) {
+        if (mask & (1 << lane)) {
+          visit_tile(y * tiles_x_ + x + lane);
+        }
+      }
+    }
+#endif
+    for (; x <= rect[ 2 ]; ++x) {
+      if (near_depth < row[ x ]) {
+        visit_tile(y * tiles_x_ + x);
+      }
+    }
+  }
+}
+
+template <typename Band>
+void TiledLightCuller::RunBands(ThreadPool *pool, Band band) const {
+
+  int num_bands = 1;
+  if (pool != NULL) {
+    num_bands = std::min(static_cast<int>(pool->size()) + 1, tiles_y_);
+  }
+  int rows_per_band = (tiles_y_ + num_bands - 1) / num_bands;
+
+  std::vector<std::future<void> > bands;
+  for (int first = rows_per_band; first < tiles_y_; first += rows_per_band) {
+    int end = std::min(first + rows_per_band, tiles_y_);
+    bands.push_back(pool->Submit([band, first, end]() {
+      band(first, end);
+    }));
+  }
+  band(0, std::min(rows_per_band, tiles_y_));
+  for (size_t i = 0; i < bands.size(); ++i) {
+    bands[ i ].get();
+  }
+}
+
+void TiledLightCuller::Cull(const std::vector<uint32_t> &visible,
+                            const glm::mat4 &view,
+                            const glm::mat4 &projection,
+                            const OcclusionBuffer *occlusion,
+                            ThreadPool *pool) {
+
+  ComputeFarDepths(occlusion);
+  ProjectLights(visible, view, projection);
+
+  // count the lights per cluster, then fill the lists at their prefix sums
+  std::fill(clusters_.begin(), clusters_.end(), 0);
+  RunBands(pool, [this](int first_row, int end_row) {
+    for (size_t i = 0; i < binned_.size(); ++i) {
+      VisitClusters(i, first_row, end_row, [this](int cluster) {
+        clusters_[ cluster * 2 + 1 ]++;
+      });
+    }
+  });
+
+  uint32_t offset = 0;
+  max_cluster_lights_ = 0;
+  for (size_t cluster = 0; cluster < clusters_.size() / 2; ++cluster) {
+    uint32_t count = clusters_[ cluster * 2 + 1 ];
+    clusters_[ cluster * 2 ] = offset;
+    clusters_[ cluster * 2 + 1 ] = 0;
+    offset += count;
+    max_cluster_lights_ = std::max(max_cluster_lights_, count);
+  }
+
+  indices_.resize(offset);
+  RunBands(pool, [this](int first_row, int end_row) {
+    for (size_t i = 0; i < binned_.size(); ++i) {
+      uint32_t light = binned_[ i ];
+      VisitClusters(i, first_row, end_row, [this, light](int cluster) {
+        uint32_t *list = &clusters_[ cluster * 2 ];
+        indices_[ list[ 0 ] + list[ 1 ]++ ] = light;
+      });
+    }
+  });
+}
+
+void TiledLightCuller::Upload() {
+
+  // orphaned, the lists of the last frame may still be read
+  glBindBuffer(GL_TEXTURE_BUFFER, cluster_buffer_);
+  glBufferData(GL_TEXTURE_BUFFER, clusters_.size() * sizeof(uint32_t),
+               clusters_.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, index_buffer_);
+  glBufferData(GL_TEXTURE_BUFFER,
+               std::max<size_t>(indices_.size(), 1) * sizeof(uint32_t),
+               indices_.empty() ? NULL : indices_.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void TiledLightCuller::Bind(GLint cluster_unit, GLint index_unit) const {
+
+  GLState::Instance().BindTexture(cluster_unit, GL_TEXTURE_BUFFER,
+                                  cluster_texture_);
+  GLState::Instance().BindTexture(index_unit, GL_TEXTURE_BUFFER,
+                                  index_texture_);
+}
+
+void TiledLightCuller::Unbind(GLint cluster_unit, GLint index_unit) const {
+
+  GLState::Instance().BindTexture(cluster_unit, GL_TEXTURE_BUFFER, 0);
+  GLState::Instance().BindTexture(index_unit, GL_TEXTURE_BUFFER, 0);
+}
+
+int TiledLightCuller::tiles_x() const {
+  return tiles_x_;
+}
+
+int TiledLightCuller::tiles_y() const {
+  return tiles_y_;
+}
+
+int TiledLightCuller::depth_slices() const {
+  return depth_slices_;
+}
+
+glm::vec2 TiledLightCuller::slice_scale_bias() const {
+  return glm::vec2(slice_scale_, slice_bias_);
+}
+
+size_t TiledLightCuller::num_indices() const {
+  return indices_.size();
+}
+
+uint32_t TiledLightCuller::max_cluster_lights() const {
+  return max_cluster_lights_;
+}
+
+} // namespace oncgl
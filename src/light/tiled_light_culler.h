@@ -0,0 +1,173 @@
+#ifndef ONCGL_LIGHT_TILED_LIGHT_CULLER_H
+#define ONCGL_LIGHT_TILED_LIGHT_CULLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "misc/thread_pool.h"
+#include "scene/occlusion_buffer.h"
+
+namespace oncgl {
+
+/**
+ * Point lights binned into clusters, screen tiles split into depth slices, so
+ * a fragment only loops over the lights that can reach it
+ *
+ * The slices are spaced exponentially between the near and the far plane,
+ * slice = log(distance / near) / log(far / near) * depth_slices.
+ * Cull projects the bounding spheres of the lights, four at a time with SSE,
+ * to a tile rectangle, a slice range and the depth of their nearest point. A
+ * light is added to the clusters of every tile of its rectangle whose far
+ * depth lies behind that point. The far depths come from the CPU occlusion
+ * buffer, the tile depths of the G-buffer would need a read back.
+ * The lists are assigned in bands of tile rows on the thread pool and
+ * uploaded to two texture buffers: one RG32UI texel per cluster (offset,
+ * count into the index list) and the R32UI light indices. Cluster
+ * (x, y, slice) is texel (y * tiles_x + x) * depth_slices + slice. A pass
+ * only needs the screen position and view distance of a fragment to find its
+ * lights, so deferred and forward passes can share the lists.
+ */
+class TiledLightCuller {
+ public:
+  // width and height of a tile in pixels
+  static const int kTileSize = 16;
+
+  static const int kDefaultDepthSlices = 16;
+
+  /**
+   * @param width         width of the screen in pixels
+   * @param height        height of the screen in pixels
+   * @param depth_slices  clusters per tile, 1 bins into tiles only
+   */
+  TiledLightCuller(int width, int height,
+                   int depth_slices = kDefaultDepthSlices);
+
+  ~TiledLightCuller();
+
+  /**
+   * Keep the bounding spheres of the lights, a light is identified by its
+   * position in the vector like in LightBuffer
+   *
+   * @param spheres   center and radius of every light, see LightCuller
+   */
+  void set_spheres(const std::vector<glm::vec4> &spheres);
+
+  /**
+   * Bin lights into the clusters, does not touch OpenGL
+   * The projection must be a symmetric perspective projection.
+   *
+   * @param visible     indices of the lights to bin, e.g. the lights in the
+   *                    view frustum
+   * @param view        view matrix of the camera
+   * @param projection  projection matrix of the camera
+   * @param occlusion   far depths of the tiles, NULL keeps lights regardless
+   *                    of their depth
+   * @param pool        pool the bands of tile rows are assigned on
+   */
+  void Cull(const std::vector<uint32_t> &visible, const glm::mat4 &view,
+            const glm::mat4 &projection, const OcclusionBuffer *occlusion,
+            ThreadPool *pool = &ThreadPool::Instance());
+
+  /**
+   * Upload the lists of the last Cull
+   */
+  void Upload();
+
+  /**
+   * Bind the cluster and the index buffer, both read with texelFetch from a
+   * usamplerBuffer
+   */
+  void Bind(GLint cluster_unit, GLint index_unit) const;
+
+  void Unbind(GLint cluster_unit, GLint index_unit) const;
+
+  int tiles_x() const;
+
+  int tiles_y() const;
+
+  int depth_slices() const;
+
+  /**
+   * Slice of a view distance of the last Cull:
+   * clamp(int(log(distance) * scale + bias), 0, depth_slices - 1)
+   */
+  glm::vec2 slice_scale_bias() const;
+
+  // entries of all cluster lists of the last Cull
+  size_t num_indices() const;
+
+  // longest cluster list of the last Cull
+  uint32_t max_cluster_lights() const;
+
+ private:
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+  int depth_slices_;
+  // log(distance) * scale + bias is the slice of a view distance
+  float slice_scale_;
+  float slice_bias_;
+
+  // center and radius of every light
+  std::vector<glm::vec4> spheres_;
+
+  // per binned light: index, inclusive tile rectangle, inclusive slice range
+  // and the window depth of its nearest point, empty rectangles are dropped
+  std::vector<uint32_t> binned_;
+  std::vector<int> rects_;
+  std::vector<int> slices_;
+  std::vector<float> near_depths_;
+
+  // per tile
+  std::vector<float> far_depths_;
+  // offset and count per cluster
+  std::vector<uint32_t> clusters_;
+  std::vector<uint32_t> indices_;
+  uint32_t max_cluster_lights_;
+
+  GLuint cluster_buffer_;
+  GLuint cluster_texture_;
+  GLuint index_buffer_;
+  GLuint index_texture_;
+
+  /**
+   * Project the lights to tile rectangles, slice ranges and near depths
+   */
+  void ProjectLights(const std::vector<uint32_t> &visible,
+                     const glm::mat4 &view, const glm::mat4 &projection);
+
+  /**
+   * Far depth of every tile from the tiles of the occlusion buffer it covers
+   */
+  void ComputeFarDepths(const OcclusionBuffer *occlusion);
+
+  /**
+   * Call visit(cluster) for every cluster in the tile rows
+   * [first_row, end_row) a binned light is added to
+   */
+  template <typename Visitor>
+  void VisitClusters(size_t binned, int first_row, int end_row,
+                     Visitor visit) const;
+
+  /**
+   * Run band(first_row, end_row) for bands of tile rows on the pool, bands
+   * never share a cluster
+   */
+  template <typename Band>
+  void RunBands(ThreadPool *pool, Band band) const;
+
+  //copying disabled
+  TiledLightCuller(const TiledLightCuller &);
+
+  const TiledLightCuller &operator=(const TiledLightCuller &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_LIGHT_TILED_LIGHT_CULLER_H
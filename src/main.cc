@@ -1,6 +1,12 @@
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <list>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -13,8 +19,12 @@
 #include "shader_program/shader_program.h"
 #include "camera/camera.h"
 #include "model/model.h"
+#include "model/model_loader.h"
+#include "model/texture_streamer.h"
 #include "framebuffer/framebuffer.h"
 #include "renderer/renderer.h"
+#include "scene/scene.h"
+#include "benchmark/benchmark.h"
 
 // globals
 oncgl::Window _window("Oncgl", 1600, 900);
@@ -30,10 +40,16 @@ enum RenderOptions {
   TOGGLE_DIR_LIGHT, TOGGLE_POINT_LIGHT, TOGGLE_DEBUG, NUM_OPS
 };
 std::vector<bool> renderToggles(RenderOptions::NUM_OPS);
+// shade the point lights in one tiled pass instead of their light volumes
+bool gTiledLights = false;
+// draw the light volumes without a stencil pass
+bool gSinglePassLights = false;
 
 oncgl::DeferredRenderer *deferredRenderer_;
 
-std::vector<oncgl::Model> gModels;
+oncgl::Scene *gScene;
+// result of the last pick, shown in the debug overlay
+std::string gPickText = "none";
 
 std::vector<oncgl::PointLight> gPointLights;
 
@@ -41,6 +57,29 @@ oncgl::DirectionalLight gDirLight;
 
 oncgl::FontRenderer *gFontRenderer;
 
+// time the program was started, for the startup times of the benchmark
+oncgl::Benchmark::Clock::time_point gStartTime;
+
+// command line options
+struct Options {
+  // render without a visible window (EGL)
+  bool headless;
+  // number of frames to benchmark, 0 runs interactively
+  unsigned int benchmark_frames;
+  // vertex layout of the scene models
+  oncgl::VertexFormat vertex_format;
+  // additional copies of the monkeys, to stress instancing
+  unsigned int extra_instances;
+  // skip instances outside the view frustum
+  bool frustum_culling;
+  // skip instances hidden behind large meshes
+  bool occlusion_culling;
+  // start with the tiled point light pass
+  bool tiled_lights;
+  // start with the light volumes without stencil pass
+  bool single_pass_lights;
+};
+
 // Callback for key events.
 void key_callback(GLFWwindow *window, int key, int scancode, int action,
                   int mods) {
@@ -72,6 +111,25 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
     renderToggles[ RenderOptions::TOGGLE_DIR_LIGHT ]
         = !renderToggles[ RenderOptions::TOGGLE_DIR_LIGHT ];
   }
+  if (key == GLFW_KEY_3 && action == GLFW_PRESS) {
+    gTiledLights = !gTiledLights;
+  }
+  if (key == GLFW_KEY_4 && action == GLFW_PRESS) {
+    gSinglePassLights = !gSinglePassLights;
+  }
+  // pick the instance in the center of the screen
+  if (key == GLFW_KEY_E && action == GLFW_PRESS && gScene) {
+    oncgl::Scene::InstanceId instance;
+    float distance;
+    gPickText = "none";
+    if (gScene->Pick(gCamera.position(), gCamera.Forward(),
+                     gCamera.far_plane(), &instance, &distance)) {
+      std::ostringstream pick_text;
+      pick_text << "instance " << instance << " at " << std::fixed
+          << std::setprecision(2) << distance;
+      gPickText = pick_text.str();
+    }
+  }
   if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
     renderToggles[ RenderOptions::TOGGLE_DEBUG ]
         = !renderToggles[ RenderOptions::TOGGLE_DEBUG ];
@@ -83,24 +141,43 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
   }
 }
 
-static std::vector<oncgl::Model> LoadModels() {
+// Start importing the scene in the background, the models are uploaded by
+// FinishLoadingModels
+static void StartLoadingModels(oncgl::ModelLoader *loader,
+                               oncgl::VertexFormat format) {
 
   std::cout << "Loading models..." << std::endl;
 
-  std::vector<oncgl::Model> models;
+  loader->Add(RESOURCE_DIRS_PREFIX + "../objects/sphere.obj", format);
+  loader->Add(RESOURCE_DIRS_PREFIX + "../objects/wooden_floor.obj", format);
+  loader->Add(RESOURCE_DIRS_PREFIX + "../objects/monkeys.obj", format);
+}
 
-  oncgl::Model sphere(RESOURCE_DIRS_PREFIX + "../objects/sphere.obj");
-  models.push_back(sphere);
+// Upload the models and place them in the scene
+static void FinishLoadingModels(oncgl::ModelLoader *loader,
+                                unsigned int extra_instances,
+                                oncgl::Scene *scene) {
 
-  oncgl::Model plane2(RESOURCE_DIRS_PREFIX + "../objects/wooden_floor.obj");
-  models.push_back(plane2);
+  std::vector<oncgl::Model> models = loader->Finish();
+  for (size_t i = 0; i < models.size(); ++i) {
+    oncgl::Scene::AssetId asset = scene->AddAsset(models[ i ]);
+    scene->AddInstance(asset, models[ i ].model_matrix());
+  }
 
-  oncgl::Model monkeys(RESOURCE_DIRS_PREFIX + "../objects/monkeys.obj");
-  models.push_back(monkeys);
+  // copies of the monkeys on rings around the scene
+  // assets are added in the order of StartLoadingModels
+  const oncgl::Scene::AssetId monkeys = 2;
+  for (unsigned int i = 0; i < extra_instances; ++i) {
+    float angle = i * 2.39996f; // golden angle, spreads the copies evenly
+    float radius = 80.0f + 2.0f * sqrtf((float) i);
+    glm::mat4 transform = glm::translate(
+        glm::mat4(1.0f),
+        glm::vec3(radius * cosf(angle), 0.0f, radius * sinf(angle)));
+    scene->AddInstance(monkeys, transform);
+  }
 
-  std::cout << K_GREEN << "Finished loading " << models.size() << " model(s)" <<
-  K_RESET << std::endl;
-  return models;
+  std::cout << K_GREEN << "Finished loading " << models.size() << " model(s), "
+      << scene->num_instances() << " instance(s)" << K_RESET << std::endl;
 }
 
 void Update() {
@@ -143,52 +220,164 @@ void OnScroll(GLFWwindow *window, double deltaX, double deltaY) {
   gScrollY += deltaY;
 }
 
+// Shade the lights with instanced stencil and point light passes, as many
+// lights per pass as the stencil buffer can count
+static void RenderStencilLights(const std::vector<uint32_t> &lights) {
+
+  if (lights.empty()) {
+    return;
+  }
+  const size_t batch_size = oncgl::DeferredRenderer::kMaxStencilVolumes;
+  std::vector<uint32_t> batch;
+  oncgl::GLState::Instance().Enable(GL_STENCIL_TEST);
+  for (size_t first = 0; first < lights.size(); first += batch_size) {
+    size_t end = std::min(first + batch_size, lights.size());
+    batch.assign(lights.begin() + first, lights.begin() + end);
+    deferredRenderer_->RenderStencilPass(batch);
+    deferredRenderer_->RenderPointLightPass();
+  }
+  oncgl::GLState::Instance().Disable(GL_STENCIL_TEST);
+}
+
 void Render(int fps) {
 
+  // replace placeholder textures with the ones that finished loading
+  oncgl::TextureStreamer::Instance().Update();
+
+  oncgl::GLState::Instance().ResetStats();
   deferredRenderer_->Init(_window.width(), _window.height());
+  deferredRenderer_->BeginFrame(gCamera, gDirLight);
 
-  deferredRenderer_->RenderGeometryPass(gModels, gCamera);
+  deferredRenderer_->RenderGeometryPass(gScene, gCamera);
 
   if (renderToggles[ RenderOptions::TOGGLE_POINT_LIGHT ]) {
-    glEnable(GL_STENCIL_TEST);
-    for (int i = 0; i < gPointLights.size(); ++i) {
-      deferredRenderer_->RenderStencilPass(gPointLights[ i ], gCamera);
-      deferredRenderer_->RenderPointLightPass(gPointLights[ i ], gCamera);
+    // lights outside the frustum, smaller than a pixel or occluded never
+    // reach the GPU
+    std::vector<uint32_t> lights;
+    deferredRenderer_->CullPointLights(&lights);
+    if (gTiledLights) {
+      deferredRenderer_->RenderTiledLightPass(lights);
+    } else if (gSinglePassLights) {
+      // the depth test rejects the geometry behind the volumes
+      deferredRenderer_->RenderLightVolumePass(lights);
+    } else {
+      RenderStencilLights(lights);
     }
-    glDisable(GL_STENCIL_TEST);
   }
 
   if (renderToggles[ RenderOptions::TOGGLE_DIR_LIGHT ]) {
-    deferredRenderer_->RenderDirectionalLightPass(gDirLight, gCamera);
+    deferredRenderer_->RenderDirectionalLightPass();
   }
 
   deferredRenderer_->RenderFinalPass();
 
   if (renderToggles[ RenderOptions::TOGGLE_DEBUG ]) {
+    // state changes of the frame, before the text adds its own
+    oncgl::GLState::Stats gl_stats = oncgl::GLState::Instance().stats();
+    oncgl::GpuTimer *gpu_timer = deferredRenderer_->gpu_timer();
+    gpu_timer->Begin(oncgl::GPU_TIMER_TEXT);
     gFontRenderer->RenderText("fps: " + std::to_string(fps),
                               10, _window.height() - 30, 0.5f,
                               glm::vec3(1.0f, 1.0f, 1.0f));
+    const oncgl::RenderQueue::Stats &stats =
+        deferredRenderer_->geometry_stats();
+    gFontRenderer->RenderText(
+        "draws: " + std::to_string(stats.draws) +
+        " programs: " + std::to_string(stats.program_changes) +
+        " materials: " + std::to_string(stats.material_changes) +
+        " vaos: " + std::to_string(stats.vertex_array_changes),
+        10, _window.height() - 55, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    const oncgl::Scene::CullStats &cull_stats = gScene->cull_stats();
+    gFontRenderer->RenderText(
+        "drawn: " + std::to_string(cull_stats.visible) +
+        " culled: " + std::to_string(cull_stats.tested - cull_stats.visible -
+                                     cull_stats.occluded) +
+        " occluded: " + std::to_string(cull_stats.occluded) +
+        " occluders: " + std::to_string(cull_stats.occluders),
+        10, _window.height() - 75, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    const oncgl::LightCuller::Stats &light_stats =
+        deferredRenderer_->light_culler()->stats();
+    gFontRenderer->RenderText(
+        "lights: " + std::to_string(light_stats.visible) +
+        " outside: " + std::to_string(light_stats.outside) +
+        " small: " + std::to_string(light_stats.small) +
+        " occluded: " + std::to_string(light_stats.occluded),
+        10, _window.height() - 135, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    if (gTiledLights) {
+      const oncgl::TiledLightCuller &tiles = deferredRenderer_->tiled_lights();
+      gFontRenderer->RenderText(
+          "clustered lights: " + std::to_string(tiles.num_indices()) +
+          " max per cluster: " + std::to_string(tiles.max_cluster_lights()),
+          10, _window.height() - 155, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    }
+    gFontRenderer->RenderText(
+        "gl state issued: " + std::to_string(gl_stats.issued) +
+        " elided: " + std::to_string(gl_stats.elided),
+        10, _window.height() - 95, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    // GPU time of a frame a few frames back, passes run more than
+    // once are summed
+    std::ostringstream gpu_text;
+    gpu_text << std::fixed << std::setprecision(2) << "gpu ms: "
+        << gpu_timer->total_ms();
+    for (int i = 0; i < oncgl::NUM_GPU_TIMER_PASSES; i++) {
+      oncgl::GpuTimerPass pass = (oncgl::GpuTimerPass) i;
+      gpu_text << " " << oncgl::GpuTimer::name(pass) << ": "
+          << gpu_timer->ms(pass);
+      if (gpu_timer->count(pass) > 1) {
+        gpu_text << " (" << gpu_timer->count(pass) << ")";
+      }
+    }
+    gFontRenderer->RenderText(
+        gpu_text.str(),
+        10, _window.height() - 115, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    gFontRenderer->RenderText(
+        "picked: " + gPickText,
+        10, 30, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
     gFontRenderer->RenderText(
-        "Press [1]: Toggle Point [2]: Toggle Dir [F3]: Toggle Debug [ESC]: Quit",
+        "Press [1]: Toggle Point [2]: Toggle Dir [3]: Toggle Tiled "
+        "[4]: Toggle Single Pass [E]: Pick [F3]: Toggle Debug [ESC]: Quit",
         10, 10, 0.3f, glm::vec3(1.0f, 1.0f, 1.0f));
+    gpu_timer->End();
   }
 
   // Swap the buffers
-  glfwSwapBuffers(_window.window());
+  _window.SwapBuffers();
 }
 
 void onError(int errorCode, const char *msg) {
   throw std::runtime_error(msg);
 }
 
-void AppMain() {
+// Render the benchmark frames along the fixed camera path and print the times
+void RunBenchmark(unsigned int num_frames) {
+
+  oncgl::Benchmark benchmark(num_frames, gStartTime);
+
+  while (!benchmark.Finished() && !_window.ShouldClose()) {
+    if (!_window.headless()) {
+      glfwPollEvents();
+    }
+
+    benchmark.BeginFrame(&gCamera);
+    Render(0);
+    benchmark.EndFrame(oncgl::TextureStreamer::Instance().Idle());
+  }
+
+  benchmark.PrintReport(std::cout);
+}
+
+void AppMain(const Options &options) {
 
   // enable all render-options by default
   for (int i = 0; i < RenderOptions::NUM_OPS; i++) {
     renderToggles[ i ] = true;
   }
 
-  _window.init(key_callback, OnScroll, onError);
+  if (options.headless) {
+    _window.InitHeadless();
+  } else {
+    _window.init(key_callback, OnScroll, onError);
+  }
 
   /************************************************
    *********** Load Models and draw ***************
@@ -199,11 +388,21 @@ void AppMain() {
   gCamera.OffsetPosition(glm::vec3(0, 40.0f, 60.0f));
   gCamera.offset_orientation(30.0f, 0.0f);
 
-  gModels = LoadModels();
+  // the imports run while the renderer compiles its shaders
+  oncgl::ModelLoader modelLoader;
+  StartLoadingModels(&modelLoader, options.vertex_format);
 
   deferredRenderer_ = new oncgl::DeferredRenderer(_window.width(),
                                                   _window.height());
 
+  gScene = new oncgl::Scene();
+  FinishLoadingModels(&modelLoader, options.extra_instances, gScene);
+  deferredRenderer_->set_output_framebuffer(_window.framebuffer());
+  deferredRenderer_->set_frustum_culling(options.frustum_culling);
+  deferredRenderer_->set_occlusion_culling(options.occlusion_culling);
+  gTiledLights = options.tiled_lights;
+  gSinglePassLights = options.single_pass_lights;
+
   for (float i = -10.0; i <= 10.0; i = i + 5.0) {
     for (float j = -10.0; j <= 10.0; j = j + 5.0) {
 
@@ -219,6 +418,9 @@ void AppMain() {
     }
   }
 
+  // the lights do not move, they are uploaded once
+  deferredRenderer_->set_point_lights(gPointLights);
+
   gDirLight.ambient_intensity = 0.8f;
   gDirLight.diffuse_intensity = 0.5f;
   gDirLight.color = COLOR_WHITE;
@@ -229,6 +431,18 @@ void AppMain() {
       48, _window.width(), _window.height());
   gFontRenderer->Init(_window.width(), _window.height());
 
+  if (options.benchmark_frames > 0) {
+    RunBenchmark(options.benchmark_frames);
+    if (!_window.headless()) {
+      glfwTerminate();
+    }
+    return;
+  }
+
+  if (_window.headless()) {
+    throw std::runtime_error("--headless can only be used with --benchmark");
+  }
+
   // glfwGetTime <- time in seconds but with micro-
   // or nanotime resolution as a double
   // fps counter
@@ -274,9 +488,71 @@ void AppMain() {
   glfwTerminate();
 }
 
+static void PrintUsage(const char *program) {
+  std::cout << "Usage: " << program << " [--headless] [--benchmark [frames]]"
+      " [--packed-vertices] [--instances n] [--no-culling] [--no-occlusion]"
+      " [--tiled-lights] [--single-pass-lights]" << std::endl;
+  std::cout << "  --headless          render offscreen without a window (EGL)" <<
+      std::endl;
+  std::cout << "  --benchmark [n]     render n frames (default 300) along a "
+      "fixed camera path and print the cpu- and gpu-times" << std::endl;
+  std::cout << "  --packed-vertices   upload the scene with 24 byte vertices "
+      "(octahedral normals, half float uv)" << std::endl;
+  std::cout << "  --instances n       place n additional copies of the monkeys"
+      << std::endl;
+  std::cout << "  --no-culling        draw every instance, also those outside "
+      "the view frustum" << std::endl;
+  std::cout << "  --no-occlusion      draw instances hidden behind large meshes"
+      << std::endl;
+  std::cout << "  --tiled-lights      shade the point lights in one pass over "
+      "screen tiles instead of light volumes ([3] toggles)"
+      << std::endl;
+  std::cout << "  --single-pass-lights  draw the light volumes with a depth "
+      "test instead of a stencil pass ([4] toggles)" << std::endl;
+}
+
 int main(int argc, char *argv[]) {
+
+  gStartTime = oncgl::Benchmark::Clock::now();
+
+  Options options;
+  options.headless = false;
+  options.benchmark_frames = 0;
+  options.vertex_format = oncgl::VERTEX_FORMAT_FLOAT;
+  options.extra_instances = 0;
+  options.frustum_culling = true;
+  options.occlusion_culling = true;
+  options.tiled_lights = false;
+  options.single_pass_lights = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[ i ], "--headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(argv[ i ], "--benchmark") == 0) {
+      options.benchmark_frames = 300;
+      if (i + 1 < argc && argv[ i + 1 ][ 0 ] != '-') {
+        options.benchmark_frames = std::atoi(argv[ ++i ]);
+      }
+    } else if (strcmp(argv[ i ], "--packed-vertices") == 0) {
+      options.vertex_format = oncgl::VERTEX_FORMAT_PACKED;
+    } else if (strcmp(argv[ i ], "--instances") == 0 && i + 1 < argc) {
+      options.extra_instances = std::atoi(argv[ ++i ]);
+    } else if (strcmp(argv[ i ], "--no-culling") == 0) {
+      options.frustum_culling = false;
+    } else if (strcmp(argv[ i ], "--no-occlusion") == 0) {
+      options.occlusion_culling = false;
+    } else if (strcmp(argv[ i ], "--tiled-lights") == 0) {
+      options.tiled_lights = true;
+    } else if (strcmp(argv[ i ], "--single-pass-lights") == 0) {
+      options.single_pass_lights = true;
+    } else {
+      PrintUsage(argv[ 0 ]);
+      return EXIT_FAILURE;
+    }
+  }
+
   try {
-    AppMain();
+    AppMain(options);
   } catch (const std::exception &e) {
     std::cerr << K_RED << "ERROR: " << e.what() << K_RESET << std::endl;
     return EXIT_FAILURE;
@@ -0,0 +1,35 @@
+#include "misc/hash.h"
+
+#include <fstream>
+
+namespace oncgl {
+
+uint64_t Fnv1a(const void *data, size_t size, uint64_t hash) {
+
+  const unsigned char *bytes = (const unsigned char *) data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[ i ];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool HashFile(const std::string &path, uint64_t *hash) {
+
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  uint64_t h = kFnvOffsetBasis;
+  char buffer[ 64 * 1024 ];
+  while (in) {
+    in.read(buffer, sizeof(buffer));
+    h = Fnv1a(buffer, in.gcount(), h);
+  }
+
+  *hash = h;
+  return true;
+}
+
+} // namespace oncgl
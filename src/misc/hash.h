@@ -0,0 +1,35 @@
+#ifndef ONCGL_MISC_HASH_H
+#define ONCGL_MISC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace oncgl {
+
+// start value of a 64 bit FNV-1a hash
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+
+/**
+ * 64 bit FNV-1a hash
+ *
+ * @param data  bytes to hash
+ * @param size  number of bytes
+ * @param hash  hash to continue, kFnvOffsetBasis to start a new one
+ * @returns the hash
+ */
+uint64_t Fnv1a(const void *data, size_t size, uint64_t hash = kFnvOffsetBasis);
+
+/**
+ * 64 bit FNV-1a hash of the content of a file
+ *
+ * @param path  file to hash
+ * @param hash  resulting hash
+ * @returns true - if the file could be read, otherwise false
+ */
+bool HashFile(const std::string &path, uint64_t *hash);
+
+} // namespace oncgl
+
+#endif // ONCGL_MISC_HASH_H
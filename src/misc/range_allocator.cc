@@ -0,0 +1,77 @@
+#include "misc/range_allocator.h"
+
+namespace oncgl {
+
+RangeAllocator::RangeAllocator(size_t capacity) :
+    capacity_(0),
+    used_(0) {
+  Grow(capacity);
+}
+
+bool RangeAllocator::Allocate(size_t size, size_t *offset) {
+
+  for (std::map<size_t, size_t>::iterator it = free_.begin();
+       it != free_.end(); ++it) {
+    if (it->second < size) {
+      continue;
+    }
+
+    *offset = it->first;
+    size_t remaining = it->second - size;
+    free_.erase(it);
+    if (remaining > 0) {
+      free_[ *offset + size ] = remaining;
+    }
+    used_ += size;
+    return true;
+  }
+  return false;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size) {
+
+  used_ -= size;
+  std::map<size_t, size_t>::iterator next = free_.lower_bound(offset);
+
+  // merge with the following free range
+  if (next != free_.end() && offset + size == next->first) {
+    size += next->second;
+    next = free_.erase(next);
+  }
+
+  // merge with the preceding free range
+  if (next != free_.begin()) {
+    std::map<size_t, size_t>::iterator prev = next;
+    --prev;
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  free_[ offset ] = size;
+}
+
+void RangeAllocator::Grow(size_t capacity) {
+
+  if (capacity <= capacity_) {
+    return;
+  }
+
+  // the new space is a freed range at the old end
+  size_t added = capacity - capacity_;
+  size_t offset = capacity_;
+  capacity_ = capacity;
+  used_ += added;
+  Free(offset, added);
+}
+
+size_t RangeAllocator::capacity() const {
+  return capacity_;
+}
+
+size_t RangeAllocator::used() const {
+  return used_;
+}
+
+} // namespace oncgl
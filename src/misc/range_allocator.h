@@ -0,0 +1,60 @@
+#ifndef ONCGL_MISC_RANGE_ALLOCATOR_H
+#define ONCGL_MISC_RANGE_ALLOCATOR_H
+
+#include <stddef.h>
+
+#include <map>
+
+namespace oncgl {
+
+/**
+ * First-fit allocator for ranges of a linear address space (e.g. a buffer)
+ * Freed ranges are merged with their free neighbours and reused. Only the
+ * bookkeeping lives here, the memory itself is managed by the caller.
+ */
+class RangeAllocator {
+ public:
+  /**
+   * @param capacity  size of the address space
+   */
+  explicit RangeAllocator(size_t capacity = 0);
+
+  /**
+   * Allocate a range
+   *
+   * @param size    size of the range, must be greater than 0
+   * @param offset  receives the start of the range
+   * @returns true - if a free range was big enough, otherwise false
+   */
+  bool Allocate(size_t size, size_t *offset);
+
+  /**
+   * Return a range, it is merged with adjacent free ranges
+   *
+   * @param offset  start of the range
+   * @param size    size the range was allocated with
+   */
+  void Free(size_t offset, size_t size);
+
+  /**
+   * Extend the address space at its end
+   *
+   * @param capacity  new size, must not be smaller than the current one
+   */
+  void Grow(size_t capacity);
+
+  size_t capacity() const;
+
+  // sum of the allocated ranges
+  size_t used() const;
+
+ private:
+  // start -> size of every free range
+  std::map<size_t, size_t> free_;
+  size_t capacity_;
+  size_t used_;
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MISC_RANGE_ALLOCATOR_H
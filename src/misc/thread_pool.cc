@@ -0,0 +1,58 @@
+#include "misc/thread_pool.h"
+
+namespace oncgl {
+
+ThreadPool::ThreadPool(unsigned int num_threads) :
+    stop_(false) {
+
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+
+  for (unsigned int i = 0; i < num_threads; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+
+  for (unsigned int i = 0; i < workers_.size(); ++i) {
+    workers_[ i ].join();
+  }
+}
+
+ThreadPool &ThreadPool::Instance() {
+  // hardware_concurrency may return 0 if it is unknown
+  static ThreadPool pool(std::thread::hardware_concurrency());
+  return pool;
+}
+
+unsigned int ThreadPool::size() const {
+  return workers_.size();
+}
+
+void ThreadPool::WorkerLoop() {
+
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+      // drain the queue before stopping
+      if (tasks_.empty()) {
+        return;
+      }
+      task = tasks_.front();
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+} // namespace oncgl
@@ -0,0 +1,84 @@
+#ifndef ONCGL_MISC_THREAD_POOL_H
+#define ONCGL_MISC_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace oncgl {
+
+/**
+ * Fixed number of worker threads that run submitted tasks in FIFO order
+ * Tasks must not touch OpenGL, the context is only current on the main thread.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param num_threads   number of worker threads, at least one is created
+   */
+  explicit ThreadPool(unsigned int num_threads);
+
+  /**
+   * Waits for all queued tasks and joins the workers
+   */
+  ~ThreadPool();
+
+  /**
+   * Process-wide pool with one worker per hardware thread
+   */
+  static ThreadPool &Instance();
+
+  /**
+   * Queue a task
+   *
+   * @param task  callable without arguments
+   * @returns future with the result (or the exception) of the task
+   */
+  template <typename Task>
+  std::future<typename std::result_of<Task()>::type> Submit(Task task);
+
+  unsigned int size() const;
+
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()> > tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_;
+
+  void WorkerLoop();
+
+  //copying disabled
+  ThreadPool(const ThreadPool &);
+
+  const ThreadPool &operator=(const ThreadPool &);
+};
+
+template <typename Task>
+std::future<typename std::result_of<Task()>::type> ThreadPool::Submit(
+    Task task) {
+
+  typedef typename std::result_of<Task()>::type Result;
+
+  // std::function needs a copyable callable, packaged_task is move-only
+  std::shared_ptr<std::packaged_task<Result()> > packaged =
+      std::make_shared<std::packaged_task<Result()> >(task);
+  std::future<Result> result = packaged->get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push([packaged]() { (*packaged)(); });
+  }
+  condition_.notify_one();
+
+  return result;
+}
+
+} // namespace oncgl
+
+#endif // ONCGL_MISC_THREAD_POOL_H
@@ -0,0 +1,65 @@
+#include "model/bounds.h"
+
+#include <cfloat>
+
+namespace oncgl {
+
+glm::vec3 Bounds::center() const {
+  return (min + max) * 0.5f;
+}
+
+glm::vec3 Bounds::extents() const {
+  return (max - min) * 0.5f;
+}
+
+bool Bounds::empty() const {
+  return min.x > max.x;
+}
+
+Bounds Bounds::Empty() {
+
+  Bounds bounds;
+  bounds.min = glm::vec3(FLT_MAX);
+  bounds.max = glm::vec3(-FLT_MAX);
+  bounds.radius = 0.0f;
+  return bounds;
+}
+
+Bounds Bounds::FromVertices(const Vertex *vertices, GLuint num_vertices) {
+
+  Bounds bounds = Empty();
+  for (GLuint i = 0; i < num_vertices; i++) {
+    bounds.min = glm::min(bounds.min, vertices[ i ].position);
+    bounds.max = glm::max(bounds.max, vertices[ i ].position);
+  }
+
+  // second pass for the sphere, the box center is good enough as its center
+  glm::vec3 center = bounds.center();
+  float radius_squared = 0.0f;
+  for (GLuint i = 0; i < num_vertices; i++) {
+    glm::vec3 offset = vertices[ i ].position - center;
+    radius_squared = glm::max(radius_squared, glm::dot(offset, offset));
+  }
+  bounds.radius = glm::sqrt(radius_squared);
+  return bounds;
+}
+
+void Bounds::Merge(const Bounds &other, const glm::mat4 &transform) {
+
+  if (other.empty()) {
+    return;
+  }
+
+  // transformed box of the box (Arvo), extents through the absolute matrix
+  glm::vec3 center(transform * glm::vec4(other.center(), 1.0f));
+  glm::mat3 absolute(glm::abs(glm::vec3(transform[ 0 ])),
+                     glm::abs(glm::vec3(transform[ 1 ])),
+                     glm::abs(glm::vec3(transform[ 2 ])));
+  glm::vec3 extents = absolute * other.extents();
+
+  min = glm::min(min, center - extents);
+  max = glm::max(max, center + extents);
+  radius = glm::length(max - min) * 0.5f;
+}
+
+} // namespace oncgl
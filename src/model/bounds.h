@@ -0,0 +1,54 @@
+#ifndef ONCGL_MODEL_BOUNDS_H
+#define ONCGL_MODEL_BOUNDS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "model/objects.h"
+
+namespace oncgl {
+
+/**
+ * Axis aligned box and bounding sphere around the box center
+ * An empty Bounds has min > max.
+ */
+struct Bounds {
+
+  glm::vec3 min;
+  glm::vec3 max;
+  // sphere around center(), tighter than half the box diagonal
+  float radius;
+
+  glm::vec3 center() const;
+
+  glm::vec3 extents() const;
+
+  bool empty() const;
+
+  /**
+   * Bounds of the given vertices
+   *
+   * @param vertices      vertices to enclose
+   * @param num_vertices  number of vertices
+   * @returns the bounds, empty if there are no vertices
+   */
+  static Bounds FromVertices(const Vertex *vertices, GLuint num_vertices);
+
+  /**
+   * Bounds that enclose nothing, the neutral element of Merge
+   */
+  static Bounds Empty();
+
+  /**
+   * Enclose another box transformed by a matrix
+   * The sphere is recomputed around the merged box.
+   *
+   * @param other     bounds to enclose
+   * @param transform transformation applied to other
+   */
+  void Merge(const Bounds &other, const glm::mat4 &transform);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_BOUNDS_H
@@ -0,0 +1,254 @@
+#include "model/geometry_arena.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+namespace {
+
+// index ranges are kept 4 byte aligned, so 16- and 32-bit indices can share
+// one buffer
+size_t AlignIndexBytes(size_t bytes) {
+  return (bytes + 3) & ~(size_t) 3;
+}
+
+} // namespace
+
+GeometryRange::GeometryRange() :
+    format_(VERTEX_FORMAT_FLOAT),
+    base_vertex_(0),
+    num_vertices_(0),
+    index_offset_(0),
+    index_bytes_(0),
+    num_indices_(0),
+    index_type_(GL_UNSIGNED_INT) {
+}
+
+GeometryRange::~GeometryRange() {
+  GeometryArena::Instance().Free(*this);
+}
+
+VertexFormat GeometryRange::format() const {
+  return format_;
+}
+
+GLint GeometryRange::base_vertex() const {
+  return base_vertex_;
+}
+
+GLuint GeometryRange::num_vertices() const {
+  return num_vertices_;
+}
+
+const GLvoid *GeometryRange::indices() const {
+  return (const GLvoid *) index_offset_;
+}
+
+GLuint GeometryRange::num_indices() const {
+  return num_indices_;
+}
+
+GLenum GeometryRange::index_type() const {
+  return index_type_;
+}
+
+GeometryArena &GeometryArena::Instance() {
+  // never destroyed, handles may outlive static destruction
+  static GeometryArena *arena = new GeometryArena();
+  return *arena;
+}
+
+GeometryArena::GeometryArena() {
+
+  for (int i = 0; i < NUM_VERTEX_FORMATS; i++) {
+    pools_[ i ].vao = 0;
+    pools_[ i ].vertex_buffer = 0;
+    pools_[ i ].index_buffer = 0;
+  }
+}
+
+GeometryHandle GeometryArena::Upload(VertexFormat format, const void *vertices,
+                                     GLuint num_vertices,
+                                     const GLuint *indices,
+                                     GLuint num_indices) {
+
+  Pool *pool = GetPool(format);
+  size_t vertex_size = VertexSize(format);
+
+  std::shared_ptr<GeometryRange> range(new GeometryRange());
+  range->format_ = format;
+  range->num_vertices_ = num_vertices;
+  range->num_indices_ = num_indices;
+  range->index_type_ = IndexType(num_vertices);
+
+  size_t index_size = range->index_type_ == GL_UNSIGNED_SHORT ?
+                      sizeof(GLushort) : sizeof(GLuint);
+  // never allocate empty ranges, every range needs a distinct offset
+  size_t vertex_count = std::max<size_t>(num_vertices, 1);
+  range->index_bytes_ = AlignIndexBytes(
+      std::max<size_t>(num_indices * index_size, 4));
+
+  // grow until the ranges fit, the offsets of existing meshes stay valid
+  while (!pool->vertices.Allocate(vertex_count, &range->base_vertex_)) {
+    size_t capacity = pool->vertices.capacity();
+    size_t grown = std::max(capacity * 2, capacity + vertex_count);
+    GrowBuffer(&pool->vertex_buffer, capacity * vertex_size,
+               grown * vertex_size);
+    pool->vertices.Grow(grown);
+    SetupVertexArray(format, *pool);
+  }
+  while (!pool->indices.Allocate(range->index_bytes_, &range->index_offset_)) {
+    size_t capacity = pool->indices.capacity();
+    size_t grown = std::max(capacity * 2, capacity + range->index_bytes_);
+    GrowBuffer(&pool->index_buffer, capacity, grown);
+    pool->indices.Grow(grown);
+    SetupVertexArray(format, *pool);
+  }
+
+  // upload through the copy target, so no VAO state is touched
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool->vertex_buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range->base_vertex_ * vertex_size,
+                  num_vertices * vertex_size, vertices);
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool->index_buffer);
+  if (range->index_type_ == GL_UNSIGNED_SHORT) {
+    std::vector<GLushort> short_indices(indices, indices + num_indices);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range->index_offset_,
+                    num_indices * sizeof(GLushort), short_indices.data());
+  } else {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range->index_offset_,
+                    num_indices * sizeof(GLuint), indices);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  return range;
+}
+
+void GeometryArena::Bind(VertexFormat format) {
+  GLState::Instance().BindVertexArray(GetPool(format)->vao);
+}
+
+GLsizei GeometryArena::VertexSize(VertexFormat format) {
+  return format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+GLenum GeometryArena::IndexType(GLuint num_vertices) {
+  return num_vertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+GeometryArena::Pool *GeometryArena::GetPool(VertexFormat format) {
+
+  Pool *pool = &pools_[ format ];
+  if (pool->vao) {
+    return pool;
+  }
+
+  size_t vertex_capacity = kInitialVertexBytes / VertexSize(format);
+  GrowBuffer(&pool->vertex_buffer, 0, vertex_capacity * VertexSize(format));
+  pool->vertices.Grow(vertex_capacity);
+  GrowBuffer(&pool->index_buffer, 0, kInitialIndexBytes);
+  pool->indices.Grow(kInitialIndexBytes);
+
+  glGenVertexArrays(1, &pool->vao);
+  SetupVertexArray(format, *pool);
+  return pool;
+}
+
+void GeometryArena::GrowBuffer(GLuint *buffer, size_t old_bytes,
+                               size_t new_bytes) {
+
+  GLuint grown;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, NULL, GL_STATIC_DRAW);
+
+  if (*buffer) {
+    glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        old_bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    // the VAO keeps the old buffer alive until it is pointed to the new one
+    glDeleteBuffers(1, buffer);
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  *buffer = grown;
+}
+
+void GeometryArena::SetupVertexArray(VertexFormat format, const Pool &pool) {
+
+  if (!pool.vao) {
+    return;
+  }
+
+  GLState::Instance().BindVertexArray(pool.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, pool.vertex_buffer);
+  SetupAttributes(format);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.index_buffer);
+  GLState::Instance().BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::SetupAttributes(VertexFormat format) {
+
+  if (format == VERTEX_FORMAT_PACKED) {
+    // vertex position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                          (GLvoid *) offsetof(PackedVertex, position));
+
+    // octahedral normal, snorm16 pair
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (GLvoid *) offsetof(PackedVertex, normal));
+
+    // vertex textures coords, half floats
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                          (GLvoid *) offsetof(PackedVertex, tex_coords));
+
+    // octahedral tangent, read as integers to keep the bitangent-sign bit
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 2, GL_SHORT, sizeof(PackedVertex),
+                           (GLvoid *) offsetof(PackedVertex, tangent));
+    return;
+  }
+
+  // vertex position
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid *) 0);
+
+  // vertex normals
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid *) offsetof(Vertex, normal));
+
+  // vertex textures coords
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid *) offsetof(Vertex, tex_coords));
+
+  // tangents
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid *) offsetof(Vertex, tangent));
+
+  // bitangents
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid *) offsetof(Vertex, bi_tangent));
+}
+
+void GeometryArena::Free(const GeometryRange &range) {
+
+  Pool *pool = &pools_[ range.format_ ];
+  pool->vertices.Free(range.base_vertex_,
+                      std::max<size_t>(range.num_vertices_, 1));
+  pool->indices.Free(range.index_offset_, range.index_bytes_);
+}
+
+} // namespace oncgl
@@ -0,0 +1,160 @@
+#ifndef ONCGL_MODEL_GEOMETRY_ARENA_H
+#define ONCGL_MODEL_GEOMETRY_ARENA_H
+
+#include <stddef.h>
+
+#include <memory>
+
+#include <GL/glew.h>
+
+#include "misc/range_allocator.h"
+#include "model/objects.h"
+
+namespace oncgl {
+
+/**
+ * Vertices and indices of one mesh inside the GeometryArena
+ * The ranges are returned to the arena together with the last reference.
+ */
+class GeometryRange {
+ public:
+  ~GeometryRange();
+
+  VertexFormat format() const;
+
+  // first vertex of the mesh, for glDrawElementsBaseVertex
+  GLint base_vertex() const;
+
+  GLuint num_vertices() const;
+
+  // byte offset of the first index in the index buffer, as passed to GL
+  const GLvoid *indices() const;
+
+  GLuint num_indices() const;
+
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  GLenum index_type() const;
+
+ private:
+  friend class GeometryArena;
+
+  VertexFormat format_;
+  size_t base_vertex_;
+  GLuint num_vertices_;
+  size_t index_offset_;
+  size_t index_bytes_;
+  GLuint num_indices_;
+  GLenum index_type_;
+
+  GeometryRange();
+
+  //copying disabled
+  GeometryRange(const GeometryRange &);
+
+  const GeometryRange &operator=(const GeometryRange &);
+};
+
+// reference counted handle to the geometry of a mesh
+typedef std::shared_ptr<const GeometryRange> GeometryHandle;
+
+/**
+ * Process-wide vertex and index storage of all meshes
+ *
+ * Every vertex format has one vertex buffer, one index buffer and one VAO.
+ * Meshes are sub-allocated from these buffers and drawn with
+ * glDrawElementsBaseVertex, so switching between meshes of the same format
+ * does not touch any buffer or VAO binding. The buffers grow by copying on the
+ * GPU when they run full; freed ranges are reused.
+ * Must only be used on the thread the OpenGL context is current on.
+ */
+class GeometryArena {
+ public:
+  static GeometryArena &Instance();
+
+  /**
+   * Copy the geometry of a mesh into the arena
+   * Meshes with up to 65536 vertices get 16-bit indices.
+   *
+   * @param format        layout of the vertices
+   * @param vertices      vertices, Vertex or PackedVertex depending on format
+   * @param num_vertices  number of vertices
+   * @param indices       indices of the triangles
+   * @param num_indices   number of indices
+   * @returns handle of the ranges, they are freed with the last handle
+   */
+  GeometryHandle Upload(VertexFormat format, const void *vertices,
+                        GLuint num_vertices, const GLuint *indices,
+                        GLuint num_indices);
+
+  /**
+   * Bind the VAO of a vertex format, required before drawing its meshes
+   *
+   * @param format  vertex format of the meshes to draw
+   */
+  void Bind(VertexFormat format);
+
+  /**
+   * Size of one vertex in the given format
+   */
+  static GLsizei VertexSize(VertexFormat format);
+
+  /**
+   * Smallest index type that can address all vertices of a mesh
+   *
+   * @param num_vertices  number of vertices of the mesh
+   * @returns GL_UNSIGNED_SHORT for up to 65536 vertices, else GL_UNSIGNED_INT
+   */
+  static GLenum IndexType(GLuint num_vertices);
+
+ private:
+  friend class GeometryRange;
+
+  // initial size of the buffers of a format, in bytes
+  static const size_t kInitialVertexBytes = 8 << 20;
+  static const size_t kInitialIndexBytes = 4 << 20;
+
+  struct Pool {
+
+    GLuint vao;
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    // in vertices
+    RangeAllocator vertices;
+    // in bytes, all ranges are multiples of 4
+    RangeAllocator indices;
+  };
+
+  Pool pools_[ NUM_VERTEX_FORMATS ];
+
+  GeometryArena();
+
+  // creates the buffers of a format on first use
+  Pool *GetPool(VertexFormat format);
+
+  /**
+   * Reallocate a buffer with a bigger size and copy the old content
+   *
+   * @param buffer      buffer to grow, replaced by the new buffer
+   * @param old_bytes   bytes to keep
+   * @param new_bytes   size of the new buffer
+   */
+  static void GrowBuffer(GLuint *buffer, size_t old_bytes, size_t new_bytes);
+
+  // attach the buffers of a pool to its VAO
+  static void SetupVertexArray(VertexFormat format, const Pool &pool);
+
+  // point the vertex attributes to the bound vertex buffer
+  static void SetupAttributes(VertexFormat format);
+
+  // called by the destructor of the last handle
+  void Free(const GeometryRange &range);
+
+  //copying disabled
+  GeometryArena(const GeometryArena &);
+
+  const GeometryArena &operator=(const GeometryArena &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_GEOMETRY_ARENA_H
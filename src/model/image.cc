@@ -0,0 +1,40 @@
+#include "model/image.h"
+
+#include <SOIL/SOIL.h>
+
+namespace oncgl {
+
+Image::Image(int width, int height, unsigned char *pixels) :
+    width_(width),
+    height_(height),
+    pixels_(pixels) {
+}
+
+Image::~Image() {
+  SOIL_free_image_data(pixels_);
+}
+
+std::shared_ptr<Image> Image::FromFile(const std::string &path) {
+
+  int width, height;
+  unsigned char *pixels = SOIL_load_image(path.c_str(), &width, &height, 0,
+                                          SOIL_LOAD_RGB);
+  if (!pixels) {
+    return std::shared_ptr<Image>();
+  }
+  return std::shared_ptr<Image>(new Image(width, height, pixels));
+}
+
+int Image::width() const {
+  return width_;
+}
+
+int Image::height() const {
+  return height_;
+}
+
+const unsigned char *Image::pixels() const {
+  return pixels_;
+}
+
+} // namespace oncgl
@@ -0,0 +1,47 @@
+#ifndef ONCGL_MODEL_IMAGE_H
+#define ONCGL_MODEL_IMAGE_H
+
+#include <memory>
+#include <string>
+
+namespace oncgl {
+
+/**
+ * Decoded RGB image in CPU memory
+ * Decoding does not need an OpenGL context, so images can be loaded on any
+ * thread and uploaded later.
+ */
+class Image {
+ public:
+  ~Image();
+
+  /**
+   * Decode an image file (everything SOIL can read) to RGB
+   *
+   * @param path  path of the image
+   * @returns the image, or NULL if it could not be read
+   */
+  static std::shared_ptr<Image> FromFile(const std::string &path);
+
+  int width() const;
+
+  int height() const;
+
+  const unsigned char *pixels() const;
+
+ private:
+  int width_;
+  int height_;
+  unsigned char *pixels_;
+
+  Image(int width, int height, unsigned char *pixels);
+
+  //copying disabled
+  Image(const Image &);
+
+  const Image &operator=(const Image &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_IMAGE_H
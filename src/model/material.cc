@@ -0,0 +1,105 @@
+#include "model/material.h"
+
+#include <string.h>
+
+#include <map>
+#include <string>
+
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+const float Material::kDefaultShininess = 16.0f;
+
+const GLchar *const Material::kShininessUniform = "material.shininess";
+
+namespace {
+
+// type of the textures of each slot and the sampler they are bound to
+const char *const kTextureTypes[ NUM_MATERIAL_TEXTURES ] = {
+    "texture_diffuse", "texture_specular", "texture_normals"
+};
+const GLchar *const kSamplerNames[ NUM_MATERIAL_TEXTURES ] = {
+    "texture_diffuse1", "texture_specular1", "texture_normals1"
+};
+
+// Materials with the same textures and shininess share an id
+uint32_t MaterialId(const GLuint (&textures)[ NUM_MATERIAL_TEXTURES ],
+                    float shininess) {
+
+  static std::map<std::vector<GLuint>, uint32_t> materials;
+
+  std::vector<GLuint> key(textures, textures + NUM_MATERIAL_TEXTURES);
+  GLuint shininess_bits;
+  memcpy(&shininess_bits, &shininess, sizeof(shininess_bits));
+  key.push_back(shininess_bits);
+
+  std::map<std::vector<GLuint>, uint32_t>::iterator it = materials.find(key);
+  if (it != materials.end()) {
+    return it->second;
+  }
+  uint32_t id = materials.size();
+  materials[ key ] = id;
+  return id;
+}
+
+} // namespace
+
+Material::Material(const std::vector<Texture> &textures, float shininess) :
+    shininess_(shininess),
+    handles_(textures) {
+
+  for (int slot = 0; slot < NUM_MATERIAL_TEXTURES; slot++) {
+    textures_[ slot ] = 0;
+  }
+  for (size_t i = 0; i < textures.size(); i++) {
+    for (int slot = 0; slot < NUM_MATERIAL_TEXTURES; slot++) {
+      if (textures_[ slot ] == 0 &&
+          textures[ i ].type == kTextureTypes[ slot ]) {
+        textures_[ slot ] = textures[ i ].id;
+      }
+    }
+  }
+  id_ = MaterialId(textures_, shininess_);
+}
+
+void Material::SetupProgram(Program *program) {
+
+  for (int slot = 0; slot < NUM_MATERIAL_TEXTURES; slot++) {
+    GLint location = program->FindUniform(kSamplerNames[ slot ]);
+    if (location != -1) {
+      glUniform1i(location, slot);
+    }
+  }
+}
+
+void Material::Bind(GLint shininess_location) const {
+
+  for (int slot = 0; slot < NUM_MATERIAL_TEXTURES; slot++) {
+    GLState::Instance().BindTexture(slot, GL_TEXTURE_2D, textures_[ slot ]);
+  }
+  if (shininess_location != -1) {
+    glUniform1f(shininess_location, shininess_);
+  }
+}
+
+void Material::Unbind() {
+
+  for (int slot = 0; slot < NUM_MATERIAL_TEXTURES; slot++) {
+    GLState::Instance().BindTexture(slot, GL_TEXTURE_2D, 0);
+  }
+}
+
+uint32_t Material::id() const {
+  return id_;
+}
+
+GLuint Material::texture(MaterialTexture slot) const {
+  return textures_[ slot ];
+}
+
+float Material::shininess() const {
+  return shininess_;
+}
+
+} // namespace oncgl
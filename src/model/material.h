@@ -0,0 +1,87 @@
+#ifndef ONCGL_MODEL_MATERIAL_H
+#define ONCGL_MODEL_MATERIAL_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "model/objects.h"
+#include "shader_program/shader_program.h"
+
+namespace oncgl {
+
+// texture slots of a material, the slot is also its texture unit
+enum MaterialTexture {
+  MATERIAL_TEXTURE_DIFFUSE,
+  MATERIAL_TEXTURE_SPECULAR,
+  MATERIAL_TEXTURE_NORMALS,
+  NUM_MATERIAL_TEXTURES
+};
+
+/**
+ * Textures and parameters of a mesh, resolved once at import
+ *
+ * Every slot has a fixed texture unit, so the sampler uniforms are set once
+ * per program (SetupProgram) and binding a material is at most one
+ * glBindTexture per slot and one glUniform1f, textures already bound on their
+ * unit are skipped by GLState. Only the first texture of each type is used, the
+ * geometry shader has one sampler per type.
+ */
+class Material {
+ public:
+  // shininess of materials that do not define one
+  static const float kDefaultShininess;
+
+  // name of the shininess uniform, -1 locations are ignored by Bind
+  static const GLchar *const kShininessUniform;
+
+  /**
+   * @param textures    loaded textures, Texture::type is the sampler prefix,
+   *                    e.g. "texture_diffuse"
+   * @param shininess   specular exponent, AI_MATKEY_SHININESS
+   */
+  Material(const std::vector<Texture> &textures, float shininess);
+
+  /**
+   * Point the sampler uniforms of a program to the texture units of the slots
+   *
+   * @param program   program to set up, in use
+   */
+  static void SetupProgram(Program *program);
+
+  /**
+   * Bind the textures to their units and set the shininess
+   * Slots without a texture get 0, so no texture of the previous material is
+   * sampled.
+   *
+   * @param shininess_location  location of kShininessUniform in the program
+   *                            in use, looked up once per program
+   */
+  void Bind(GLint shininess_location) const;
+
+  /**
+   * Unbind the units of all slots, once after the last draw
+   */
+  static void Unbind();
+
+  // materials with the same textures and parameters share an id
+  uint32_t id() const;
+
+  // 0 if the material has no texture in the slot
+  GLuint texture(MaterialTexture slot) const;
+
+  float shininess() const;
+
+ private:
+  uint32_t id_;
+  GLuint textures_[ NUM_MATERIAL_TEXTURES ];
+  float shininess_;
+  // keep the textures alive
+  std::vector<Texture> handles_;
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_MATERIAL_H
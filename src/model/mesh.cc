@@ -2,100 +2,64 @@
 
 namespace oncgl {
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices,
-           std::vector<Texture> textures) :
-    vertices_(vertices), indices_(indices), textures_(textures) {
-
-  SetupMesh();
+Mesh::Mesh(VertexFormat format, const void *vertices, GLuint num_vertices,
+           const GLuint *indices, GLuint num_indices,
+           std::shared_ptr<const Material> material, const Bounds &bounds) :
+    geometry_(GeometryArena::Instance().Upload(format, vertices, num_vertices,
+                                               indices, num_indices)),
+    material_(material),
+    bounds_(bounds) {
 }
 
-void Mesh::SetupMesh() {
-
-  glGenVertexArrays(1, &VAO_);
-  glGenBuffers(1, &VBO_);
-  glGenBuffers(1, &EBO_);
-
-  glBindVertexArray(VAO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-
-  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex),
-               &vertices_[ 0 ], GL_STATIC_DRAW);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint),
-               &indices_[ 0 ], GL_STATIC_DRAW);
-
-  // vertex position
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (GLvoid *) 0);
-
-  // vertex normals
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (GLvoid *) offsetof(Vertex, normal));
-
-  // vertex textures coords
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FLOAT, sizeof(Vertex),
-                        (GLvoid *) offsetof(Vertex, tex_coords));
-
-  // tangents
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FLOAT, sizeof(Vertex),
-                        (GLvoid *) offsetof(Vertex, tangent));
+void Mesh::Draw(Program *program) {
+  DrawElements(1);
+}
 
-  // bitangents
-  glEnableVertexAttribArray(4);
-  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FLOAT, sizeof(Vertex),
-                        (GLvoid *) offsetof(Vertex, bi_tangent));
+void Mesh::DrawInstanced(Program *program, GLsizei num_instances) {
+  DrawElements(num_instances);
+}
 
-  glBindVertexArray(0);
+void Mesh::DrawElements(GLsizei num_instances) {
+
+  // the VAO of the arena is bound by the caller
+  if (num_instances == 1) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, geometry_->num_indices(),
+                             geometry_->index_type(), geometry_->indices(),
+                             geometry_->base_vertex());
+  } else {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, geometry_->num_indices(),
+                                      geometry_->index_type(),
+                                      geometry_->indices(), num_instances,
+                                      geometry_->base_vertex());
+  }
 }
 
-void Mesh::Draw(GLuint program) {
+VertexFormat Mesh::format() const {
+  return geometry_->format();
+}
 
-  // Bind appropriate textures
-  GLuint diffuse_nr = 1;
-  GLuint specular_nr = 1;
-  GLuint normal_nr = 1;
+GLenum Mesh::index_type() const {
+  return geometry_->index_type();
+}
 
-  for (GLuint i = 0; i < this->textures_.size(); i++) {
+uint32_t Mesh::material_id() const {
+  return material_->id();
+}
 
-    glActiveTexture(
-        GL_TEXTURE0 + i); // Active proper texture unit before binding
-    // Retrieve texture number (the N in diffuse_textureN)
-    std::stringstream ss;
-    std::string number;
-    std::string name = this->textures_[ i ].type;
-    if (name == "texture_diffuse") {
-      ss << diffuse_nr++; // Transfer GLuint to streams
-    } else if (name == "texture_specular") {
-      ss << specular_nr++; // Transfer GLuint to stream
-    } else if (name == "texture_normals") {
-      ss << normal_nr++;
-    }
-    number = ss.str();
-    // Now set the sampler to the correct texture unit
-    glUniform1f(glGetUniformLocation(program, (name + number).c_str()), i);
-    // And finally bind the texture
-    glBindTexture(GL_TEXTURE_2D, this->textures_[ i ].id);
-  }
+const Material &Mesh::material() const {
+  return *material_;
+}
 
-  // Also set each mesh's shininess property to a default value (if you want
-  // you could extend this to another mesh property and possibly change this value)
-  glUniform1f(glGetUniformLocation(program, "material.shininess"), 16.0f);
+const Bounds &Mesh::bounds() const {
+  return bounds_;
+}
 
-  // Draw mesh
-  glBindVertexArray(VAO_);
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+const OccluderMesh *Mesh::occluder() const {
+  return occluder_.get();
+}
 
-  // Always good practice to set everything back to defaults once configured.
-  for (GLuint i = 0; i < textures_.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, 0);
-  }
+void Mesh::set_occluder(std::shared_ptr<const OccluderMesh> occluder) {
+  occluder_ = occluder;
 }
 
 } // namespace oncgl
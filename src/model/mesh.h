@@ -1,6 +1,9 @@
 #ifndef ONCGL_MODEL_MESH_H
 #define ONCGL_MODEL_MESH_H
 
+#include <stdint.h>
+
+#include <memory>
 #include <vector>
 #include <string>
 #include <fstream>
@@ -10,6 +13,9 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "model/bounds.h"
+#include "model/geometry_arena.h"
+#include "model/material.h"
 #include "model/objects.h"
 #include "shader_program/shader_program.h"
 
@@ -18,25 +24,76 @@ namespace oncgl {
 class Mesh {
 
  public:
-  std::vector<Vertex> vertices_;
-  std::vector<GLuint> indices_;
-  std::vector<Texture> textures_;
+  /**
+   * Upload the given vertices and indices into the GeometryArena
+   * The arrays are only read during construction, no copy is kept.
+   *
+   * @param format        layout of the vertices, Vertex or PackedVertex
+   * @param vertices      vertices of the mesh
+   * @param num_vertices  number of vertices
+   * @param indices       indices of the triangles
+   * @param num_indices   number of indices
+   * @param material      textures and parameters, shared by copies of the mesh
+   * @param bounds        bounds of the vertices, computed at import
+   */
+  Mesh(VertexFormat format, const void *vertices, GLuint num_vertices,
+       const GLuint *indices, GLuint num_indices,
+       std::shared_ptr<const Material> material, const Bounds &bounds);
 
-  Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices,
-       std::vector<Texture> textures);
+  /**
+   * Draw all vertices of the mesh with the given program, without binding
+   * its material
+   * For light volumes and screen quads, they sample the G-buffer on the units
+   * of the material slots. Textured geometry is drawn through a RenderQueue.
+   * The VAO of the mesh's vertex format must be bound, see
+   * GeometryArena::Bind.
+   *
+   * @param program   program to draw with, in use
+   */
+  void Draw(Program *program);
 
   /**
-   * Draw all vertices of the mesh with the given program
+   * Draw several instances of the mesh with one draw call
+   * Like Draw, the VAO of the mesh's vertex format must be bound.
    *
-   * @param program   id of the program to draw with
+   * @param program         program to draw with, in use
+   * @param num_instances   number of instances, gl_InstanceID in the shader
    */
-  void Draw(GLuint program);
+  void DrawInstanced(Program *program, GLsizei num_instances);
 
- private:
-  /*  Render data  */
-  GLuint VAO_, VBO_, EBO_;
+  /**
+   * Issue the draw call only, textures and VAO must be bound
+   *
+   * @param num_instances   number of instances, gl_InstanceID in the shader
+   */
+  void DrawElements(GLsizei num_instances);
+
+  VertexFormat format() const;
+
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, fixed at upload
+  GLenum index_type() const;
+
+  // meshes with the same id use the same textures
+  uint32_t material_id() const;
+
+  const Material &material() const;
 
-  void SetupMesh();
+  // in model space, relative to the node the mesh is drawn at
+  const Bounds &bounds() const;
+
+  // CPU copy of the triangles for the OcclusionBuffer, NULL if the mesh is
+  // too detailed to occlude cheaply
+  const OccluderMesh *occluder() const;
+
+  void set_occluder(std::shared_ptr<const OccluderMesh> occluder);
+
+ private:
+  // vertices and indices inside the arena, shared by copies of the mesh
+  GeometryHandle geometry_;
+  std::shared_ptr<const Material> material_;
+  Bounds bounds_;
+  // shared by copies of the mesh like the geometry
+  std::shared_ptr<const OccluderMesh> occluder_;
 };
 
 } // namespace oncgl
@@ -0,0 +1,344 @@
+#include "model/mesh_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "misc/hash.h"
+
+namespace oncgl {
+
+namespace {
+
+const char kMagic[ 8 ] = { 'O', 'N', 'C', 'G', 'L', 'M', 'C', '\0' };
+
+struct FileHeader {
+
+  char magic[ 8 ];
+  uint32_t version;
+  uint32_t vertex_size;
+  uint64_t source_hash;
+  uint32_t import_flags;
+  uint32_t num_meshes;
+  uint32_t num_nodes;
+  uint32_t reserved;
+};
+
+struct NodeHeader {
+
+  int32_t parent;
+  uint32_t num_meshes;
+  float transform[ 16 ];
+};
+
+struct MeshHeader {
+
+  uint32_t num_vertices;
+  uint32_t num_indices;
+  uint32_t num_textures;
+  float shininess;
+  float bounds_min[ 3 ];
+  float bounds_max[ 3 ];
+  float bounds_radius;
+};
+
+// Vertex and index arrays are aligned to 4 bytes inside the file
+size_t Align(size_t offset) {
+  return (offset + 3) & ~(size_t) 3;
+}
+
+void WriteString(std::ofstream &out, const std::string &str) {
+  uint32_t length = str.size();
+  out.write((const char *) &length, sizeof(length));
+  out.write(str.data(), length);
+}
+
+void WritePadding(std::ofstream &out) {
+  static const char zeros[ 4 ] = { 0, 0, 0, 0 };
+  size_t offset = out.tellp();
+  out.write(zeros, Align(offset) - offset);
+}
+
+// Reads from the mapped file, every read is checked against the end of the
+// mapping so a truncated or corrupted cache is rejected instead of crashing
+class Reader {
+ public:
+  Reader(const char *data, size_t size) :
+      data_(data), size_(size), offset_(0) { }
+
+  const void *Read(size_t size) {
+    if (size > size_ - offset_) {
+      return NULL;
+    }
+    const void *ptr = data_ + offset_;
+    offset_ += size;
+    return ptr;
+  }
+
+  bool ReadString(std::string *str) {
+    const uint32_t *length = (const uint32_t *) Read(sizeof(uint32_t));
+    if (!length) {
+      return false;
+    }
+    const char *chars = (const char *) Read(*length);
+    if (!chars) {
+      return false;
+    }
+    str->assign(chars, *length);
+    return true;
+  }
+
+  bool SkipPadding() {
+    size_t aligned = Align(offset_);
+    if (aligned > size_) {
+      return false;
+    }
+    offset_ = aligned;
+    return true;
+  }
+
+ private:
+  const char *data_;
+  size_t size_;
+  size_t offset_;
+};
+
+} // namespace
+
+MeshCache::MeshCache() :
+    mapping_(NULL),
+    mapping_size_(0) {
+}
+
+MeshCache::~MeshCache() {
+  Close();
+}
+
+std::string MeshCache::CachePath(const std::string &model_path) {
+  return model_path + ".cache";
+}
+
+bool MeshCache::Open(const std::string &model_path,
+                     unsigned int import_flags) {
+
+  Close();
+
+  uint64_t source_hash;
+  if (!HashFile(model_path, &source_hash)) {
+    return false;
+  }
+
+  std::string cache_path = CachePath(model_path);
+  int fd = open(cache_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(FileHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  mapping_ = mapping;
+  mapping_size_ = st.st_size;
+
+  Reader reader((const char *) mapping_, mapping_size_);
+
+  const FileHeader *header = (const FileHeader *) reader.Read(
+      sizeof(FileHeader));
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      header->vertex_size != sizeof(Vertex) ||
+      header->source_hash != source_hash ||
+      header->import_flags != import_flags) {
+    Close();
+    return false;
+  }
+
+  meshes_.resize(header->num_meshes);
+  for (uint32_t i = 0; i < header->num_meshes; ++i) {
+    MeshView &mesh = meshes_[ i ];
+
+    const MeshHeader *mesh_header = (const MeshHeader *) reader.Read(
+        sizeof(MeshHeader));
+    if (!mesh_header) {
+      Close();
+      return false;
+    }
+
+    mesh.bounds.min = glm::make_vec3(mesh_header->bounds_min);
+    mesh.bounds.max = glm::make_vec3(mesh_header->bounds_max);
+    mesh.bounds.radius = mesh_header->bounds_radius;
+    mesh.shininess = mesh_header->shininess;
+
+    mesh.textures.resize(mesh_header->num_textures);
+    for (uint32_t j = 0; j < mesh_header->num_textures; ++j) {
+      if (!reader.ReadString(&mesh.textures[ j ].type) ||
+          !reader.ReadString(&mesh.textures[ j ].path)) {
+        Close();
+        return false;
+      }
+    }
+
+    if (!reader.SkipPadding()) {
+      Close();
+      return false;
+    }
+
+    mesh.num_vertices = mesh_header->num_vertices;
+    mesh.vertices = (const Vertex *) reader.Read(
+        (size_t) mesh.num_vertices * sizeof(Vertex));
+    mesh.num_indices = mesh_header->num_indices;
+    mesh.indices = (const GLuint *) reader.Read(
+        (size_t) mesh.num_indices * sizeof(GLuint));
+
+    if (!mesh.vertices || !mesh.indices) {
+      Close();
+      return false;
+    }
+  }
+
+  nodes_.resize(header->num_nodes);
+  for (uint32_t i = 0; i < header->num_nodes; ++i) {
+    ModelNode &node = nodes_[ i ];
+
+    const NodeHeader *node_header = (const NodeHeader *) reader.Read(
+        sizeof(NodeHeader));
+    if (!node_header || node_header->parent >= (int32_t) i) {
+      Close();
+      return false;
+    }
+    node.parent = node_header->parent;
+    memcpy(&node.transform[ 0 ][ 0 ], node_header->transform,
+           sizeof(node_header->transform));
+
+    const GLuint *meshes = (const GLuint *) reader.Read(
+        (size_t) node_header->num_meshes * sizeof(GLuint));
+    if (!meshes) {
+      Close();
+      return false;
+    }
+    node.meshes.assign(meshes, meshes + node_header->num_meshes);
+    for (uint32_t j = 0; j < node.meshes.size(); ++j) {
+      if (node.meshes[ j ] >= meshes_.size()) {
+        Close();
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool MeshCache::Write(const std::string &model_path, unsigned int import_flags,
+                      const std::vector<MeshView> &meshes,
+                      const std::vector<ModelNode> &nodes) {
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.vertex_size = sizeof(Vertex);
+  header.import_flags = import_flags;
+  header.num_meshes = meshes.size();
+  header.num_nodes = nodes.size();
+  header.reserved = 0;
+  if (!HashFile(model_path, &header.source_hash)) {
+    return false;
+  }
+
+  std::string cache_path = CachePath(model_path);
+  std::string tmp_path = cache_path + ".tmp";
+
+  std::ofstream out(tmp_path.c_str(), std::ios::out | std::ios::binary |
+                                          std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+
+  out.write((const char *) &header, sizeof(header));
+
+  for (unsigned int i = 0; i < meshes.size(); ++i) {
+    const MeshView &mesh = meshes[ i ];
+
+    MeshHeader mesh_header;
+    mesh_header.num_vertices = mesh.num_vertices;
+    mesh_header.num_indices = mesh.num_indices;
+    mesh_header.num_textures = mesh.textures.size();
+    mesh_header.shininess = mesh.shininess;
+    memcpy(mesh_header.bounds_min, &mesh.bounds.min[ 0 ],
+           sizeof(mesh_header.bounds_min));
+    memcpy(mesh_header.bounds_max, &mesh.bounds.max[ 0 ],
+           sizeof(mesh_header.bounds_max));
+    mesh_header.bounds_radius = mesh.bounds.radius;
+    out.write((const char *) &mesh_header, sizeof(mesh_header));
+
+    for (unsigned int j = 0; j < mesh.textures.size(); ++j) {
+      WriteString(out, mesh.textures[ j ].type);
+      WriteString(out, mesh.textures[ j ].path);
+    }
+
+    WritePadding(out);
+    out.write((const char *) mesh.vertices,
+              (size_t) mesh.num_vertices * sizeof(Vertex));
+    out.write((const char *) mesh.indices,
+              (size_t) mesh.num_indices * sizeof(GLuint));
+  }
+
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    const ModelNode &node = nodes[ i ];
+
+    NodeHeader node_header;
+    node_header.parent = node.parent;
+    node_header.num_meshes = node.meshes.size();
+    memcpy(node_header.transform, &node.transform[ 0 ][ 0 ],
+           sizeof(node_header.transform));
+    out.write((const char *) &node_header, sizeof(node_header));
+    if (!node.meshes.empty()) {
+      out.write((const char *) &node.meshes[ 0 ],
+                node.meshes.size() * sizeof(GLuint));
+    }
+  }
+
+  out.close();
+  if (out.fail()) {
+    remove(tmp_path.c_str());
+    return false;
+  }
+
+  return rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+}
+
+const std::vector<MeshView> &MeshCache::meshes() const {
+  return meshes_;
+}
+
+const std::vector<ModelNode> &MeshCache::nodes() const {
+  return nodes_;
+}
+
+void MeshCache::Close() {
+
+  meshes_.clear();
+  nodes_.clear();
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = NULL;
+    mapping_size_ = 0;
+  }
+}
+
+} // namespace oncgl
@@ -0,0 +1,125 @@
+#ifndef ONCGL_MODEL_MESH_CACHE_H
+#define ONCGL_MODEL_MESH_CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "model/bounds.h"
+#include "model/objects.h"
+
+namespace oncgl {
+
+/**
+ * View on the final geometry of a single mesh
+ * The data is either owned by the importer or points into a mapped cache file.
+ */
+struct MeshView {
+
+  const Vertex *vertices;
+  GLuint num_vertices;
+  const GLuint *indices;
+  GLuint num_indices;
+  std::vector<TextureRef> textures;
+  // specular exponent of the material
+  float shininess;
+  // bounds of the vertices in model space, computed at import
+  Bounds bounds;
+};
+
+/**
+ * Node of the hierarchy of a model file
+ * Nodes are stored parents first, so the parent index is always smaller than
+ * the index of the node.
+ */
+struct ModelNode {
+
+  // index of the parent node, -1 for the root
+  int32_t parent;
+  // transformation relative to the parent
+  glm::mat4 transform;
+  // indices of the meshes drawn at this node
+  std::vector<GLuint> meshes;
+};
+
+/**
+ * Binary cache of the imported meshes of a model file
+ *
+ * The cache lives next to the model (model.obj -> model.obj.cache) and holds
+ * the vertex- and index-arrays exactly as they are uploaded to OpenGL, so a
+ * warm start maps the file and hands the arrays to glBufferData without
+ * touching Assimp. A cache is only used if its version, vertex layout, import
+ * flags and the hash of the model file match.
+ */
+class MeshCache {
+ public:
+  // bump whenever the file layout or the imported data changes
+  static const uint32_t kVersion = 5;
+
+  MeshCache();
+
+  ~MeshCache();
+
+  /**
+   * Get the path of the cache file of a model
+   *
+   * @param model_path  path of the model file
+   * @returns path of the cache file
+   */
+  static std::string CachePath(const std::string &model_path);
+
+  /**
+   * Map the cache of the given model
+   *
+   * @param model_path    path of the model file
+   * @param import_flags  assimp post-processing flags used for the import
+   * @returns true - if a valid, up-to-date cache was mapped, otherwise false
+   */
+  bool Open(const std::string &model_path, unsigned int import_flags);
+
+  /**
+   * Write the cache for the given model
+   * The file is written to a temporary file first and renamed afterwards, so
+   * readers never see a half-written cache.
+   *
+   * @param model_path    path of the model file
+   * @param import_flags  assimp post-processing flags used for the import
+   * @param meshes        final meshes of the model
+   * @param nodes         node hierarchy of the model
+   * @returns true - if the cache was written successfully, otherwise false
+   */
+  static bool Write(const std::string &model_path, unsigned int import_flags,
+                    const std::vector<MeshView> &meshes,
+                    const std::vector<ModelNode> &nodes);
+
+  /**
+   * Meshes of the mapped cache, only valid as long as the cache is open
+   */
+  const std::vector<MeshView> &meshes() const;
+
+  /**
+   * Node hierarchy of the cached model
+   */
+  const std::vector<ModelNode> &nodes() const;
+
+ private:
+  void *mapping_;
+  size_t mapping_size_;
+  std::vector<MeshView> meshes_;
+  std::vector<ModelNode> nodes_;
+
+  void Close();
+
+  //copying disabled
+  MeshCache(const MeshCache &);
+
+  const MeshCache &operator=(const MeshCache &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_MESH_CACHE_H
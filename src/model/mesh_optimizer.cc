@@ -0,0 +1,358 @@
+#include "model/mesh_optimizer.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace oncgl {
+
+namespace {
+
+const GLuint kNoVertex = ~0u;
+
+// Triangles using each vertex, as offsets into one flat array
+struct Adjacency {
+
+  std::vector<GLuint> offsets;
+  std::vector<GLuint> triangles;
+};
+
+void BuildAdjacency(const std::vector<GLuint> &indices, GLuint num_vertices,
+                    Adjacency *adjacency) {
+
+  std::vector<GLuint> counts(num_vertices, 0);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    counts[ indices[ i ]]++;
+  }
+
+  adjacency->offsets.resize(num_vertices + 1);
+  adjacency->offsets[ 0 ] = 0;
+  for (GLuint v = 0; v < num_vertices; ++v) {
+    adjacency->offsets[ v + 1 ] = adjacency->offsets[ v ] + counts[ v ];
+  }
+
+  std::vector<GLuint> fill(adjacency->offsets.begin(),
+                           adjacency->offsets.end() - 1);
+  adjacency->triangles.resize(indices.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    adjacency->triangles[ fill[ indices[ i ]]++ ] = i / 3;
+  }
+}
+
+// Next vertex to fan around: the candidate that stays longest in the cache
+// after emitting its remaining triangles, otherwise a dead-end
+GLuint NextFanVertex(const std::vector<GLuint> &candidates,
+                     const std::vector<GLuint> &live,
+                     const std::vector<unsigned int> &cache_time,
+                     unsigned int time, unsigned int cache_size,
+                     std::vector<GLuint> *dead_ends, GLuint *cursor) {
+
+  GLuint best = kNoVertex;
+  int best_priority = -1;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    GLuint v = candidates[ i ];
+    if (live[ v ] == 0) {
+      continue;
+    }
+    int priority = 0;
+    if (time - cache_time[ v ] + 2 * live[ v ] <= cache_size) {
+      priority = time - cache_time[ v ];
+    }
+    if (priority > best_priority) {
+      best_priority = priority;
+      best = v;
+    }
+  }
+  if (best != kNoVertex) {
+    return best;
+  }
+
+  // most recently touched vertex that still has triangles left
+  while (!dead_ends->empty()) {
+    GLuint v = dead_ends->back();
+    dead_ends->pop_back();
+    if (live[ v ] > 0) {
+      return v;
+    }
+  }
+
+  // otherwise the next vertex in input order
+  while (*cursor < live.size()) {
+    GLuint v = (*cursor)++;
+    if (live[ v ] > 0) {
+      return v;
+    }
+  }
+  return kNoVertex;
+}
+
+// Orders vertex ids by the position of the vertex
+struct PositionLess {
+
+  const std::vector<glm::vec3> *positions;
+
+  bool operator()(GLuint a, GLuint b) const {
+    const glm::vec3 &p = (*positions)[ a ];
+    const glm::vec3 &q = (*positions)[ b ];
+    if (p.x != q.x) {
+      return p.x < q.x;
+    }
+    if (p.y != q.y) {
+      return p.y < q.y;
+    }
+    return p.z < q.z;
+  }
+};
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const GLuint *indices, GLuint num_indices,
+                                    GLuint num_vertices,
+                                    unsigned int cache_size) {
+
+  // a vertex is cached if less than cache_size misses happened since its
+  // own miss, which is exactly a FIFO
+  std::vector<unsigned int> cache_time(num_vertices, 0);
+  std::vector<bool> referenced(num_vertices, false);
+  unsigned int time = cache_size + 1;
+  unsigned int misses = 0;
+  unsigned int num_referenced = 0;
+
+  for (GLuint i = 0; i < num_indices; ++i) {
+    GLuint v = indices[ i ];
+    if (time - cache_time[ v ] > cache_size) {
+      cache_time[ v ] = time++;
+      misses++;
+    }
+    if (!referenced[ v ]) {
+      referenced[ v ] = true;
+      num_referenced++;
+    }
+  }
+
+  VertexCacheStats stats;
+  stats.acmr = num_indices ? (float) misses / (num_indices / 3) : 0.0f;
+  stats.atvr = num_referenced ? (float) misses / num_referenced : 0.0f;
+  return stats;
+}
+
+void OptimizeVertexCache(std::vector<GLuint> *indices, GLuint num_vertices,
+                         unsigned int cache_size) {
+
+  GLuint num_triangles = indices->size() / 3;
+  if (num_triangles == 0) {
+    return;
+  }
+
+  Adjacency adjacency;
+  BuildAdjacency(*indices, num_vertices, &adjacency);
+
+  std::vector<GLuint> live(num_vertices);
+  for (GLuint v = 0; v < num_vertices; ++v) {
+    live[ v ] = adjacency.offsets[ v + 1 ] - adjacency.offsets[ v ];
+  }
+
+  std::vector<unsigned int> cache_time(num_vertices, 0);
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<GLuint> dead_ends;
+  std::vector<GLuint> candidates;
+  std::vector<GLuint> result;
+  result.reserve(indices->size());
+
+  unsigned int time = cache_size + 1;
+  GLuint cursor = 0;
+  GLuint fan = NextFanVertex(candidates, live, cache_time, time, cache_size,
+                             &dead_ends, &cursor);
+
+  while (fan != kNoVertex) {
+    candidates.clear();
+
+    for (GLuint j = adjacency.offsets[ fan ];
+         j < adjacency.offsets[ fan + 1 ]; ++j) {
+      GLuint triangle = adjacency.triangles[ j ];
+      if (emitted[ triangle ]) {
+        continue;
+      }
+      emitted[ triangle ] = true;
+
+      for (int k = 0; k < 3; ++k) {
+        GLuint v = (*indices)[ triangle * 3 + k ];
+        result.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live[ v ]--;
+        if (time - cache_time[ v ] > cache_size) {
+          cache_time[ v ] = time++;
+        }
+      }
+    }
+
+    fan = NextFanVertex(candidates, live, cache_time, time, cache_size,
+                        &dead_ends, &cursor);
+  }
+
+  indices->swap(result);
+}
+
+void OptimizeOverdraw(std::vector<GLuint> *indices, const Vertex *vertices,
+                      GLuint num_vertices, float threshold) {
+
+  GLuint num_triangles = indices->size() / 3;
+  if (num_triangles == 0) {
+    return;
+  }
+
+  // split where the cache runs cold, i.e. all three vertices miss
+  std::vector<GLuint> cluster_starts;
+  std::vector<unsigned int> cache_time(num_vertices, 0);
+  unsigned int time = kVertexCacheSize + 1;
+  for (GLuint t = 0; t < num_triangles; ++t) {
+    int misses = 0;
+    for (int k = 0; k < 3; ++k) {
+      GLuint v = (*indices)[ t * 3 + k ];
+      if (time - cache_time[ v ] > kVertexCacheSize) {
+        cache_time[ v ] = time++;
+        misses++;
+      }
+    }
+    if (t == 0 || misses == 3) {
+      cluster_starts.push_back(t);
+    }
+  }
+  cluster_starts.push_back(num_triangles);
+  size_t num_clusters = cluster_starts.size() - 1;
+  if (num_clusters < 2) {
+    return;
+  }
+
+  // area weighted centroid and normal of every cluster and of the mesh
+  std::vector<glm::vec3> centroids(num_clusters, glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(num_clusters, glm::vec3(0.0f));
+  glm::vec3 mesh_centroid(0.0f);
+  float mesh_area = 0.0f;
+
+  for (size_t c = 0; c < num_clusters; ++c) {
+    float area = 0.0f;
+    for (GLuint t = cluster_starts[ c ]; t < cluster_starts[ c + 1 ]; ++t) {
+      const glm::vec3 &a = vertices[ (*indices)[ t * 3 + 0 ]].position;
+      const glm::vec3 &b = vertices[ (*indices)[ t * 3 + 1 ]].position;
+      const glm::vec3 &d = vertices[ (*indices)[ t * 3 + 2 ]].position;
+      // length of the cross product is twice the area
+      glm::vec3 normal = glm::cross(b - a, d - a);
+      float triangle_area = glm::length(normal);
+
+      centroids[ c ] += (a + b + d) * (triangle_area / 3.0f);
+      normals[ c ] += normal;
+      area += triangle_area;
+    }
+
+    mesh_centroid += centroids[ c ];
+    mesh_area += area;
+    if (area > 0.0f) {
+      centroids[ c ] /= area;
+    }
+  }
+  if (mesh_area > 0.0f) {
+    mesh_centroid /= mesh_area;
+  }
+
+  // clusters far out along their normal occlude the rest from most directions
+  std::vector<float> keys(num_clusters);
+  std::vector<size_t> order(num_clusters);
+  for (size_t c = 0; c < num_clusters; ++c) {
+    float length = glm::length(normals[ c ]);
+    glm::vec3 normal = length > 0.0f ? normals[ c ] / length : glm::vec3(0.0f);
+    keys[ c ] = glm::dot(centroids[ c ] - mesh_centroid, normal);
+    order[ c ] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    return keys[ a ] > keys[ b ];
+  });
+
+  std::vector<GLuint> result;
+  result.reserve(indices->size());
+  for (size_t i = 0; i < num_clusters; ++i) {
+    size_t c = order[ i ];
+    result.insert(result.end(),
+                  indices->begin() + cluster_starts[ c ] * 3,
+                  indices->begin() + cluster_starts[ c + 1 ] * 3);
+  }
+
+  float acmr_before = AnalyzeVertexCache(indices->data(), indices->size(),
+                                         num_vertices).acmr;
+  float acmr_after = AnalyzeVertexCache(result.data(), result.size(),
+                                        num_vertices).acmr;
+  if (acmr_after <= acmr_before * threshold) {
+    indices->swap(result);
+  }
+}
+
+void OptimizeVertexFetch(std::vector<Vertex> *vertices,
+                         std::vector<GLuint> *indices) {
+
+  std::vector<GLuint> remap(vertices->size(), kNoVertex);
+  std::vector<Vertex> result;
+  result.reserve(vertices->size());
+
+  for (size_t i = 0; i < indices->size(); ++i) {
+    GLuint &index = (*indices)[ i ];
+    if (remap[ index ] == kNoVertex) {
+      remap[ index ] = result.size();
+      result.push_back((*vertices)[ index ]);
+    }
+    index = remap[ index ];
+  }
+
+  vertices->swap(result);
+}
+
+void FindOccluderNeighbors(OccluderMesh *mesh) {
+
+  const std::vector<glm::vec3> &positions = mesh->positions;
+  const std::vector<GLuint> &indices = mesh->indices;
+
+  // id of the first vertex at the same position
+  std::vector<GLuint> order(positions.size());
+  for (GLuint v = 0; v < order.size(); ++v) {
+    order[ v ] = v;
+  }
+  PositionLess less = { &positions };
+  std::sort(order.begin(), order.end(), less);
+  std::vector<GLuint> welded(positions.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    bool same = i > 0 && positions[ order[ i ]] == positions[ order[ i - 1 ]];
+    welded[ order[ i ]] = same ? welded[ order[ i - 1 ]] : order[ i ];
+  }
+
+  size_t num_edges = indices.size() / 3 * 3;
+  mesh->neighbors.assign(num_edges, kNoOccluderNeighbor);
+  // first edge seen for every pair of welded vertices, kNoOccluderNeighbor
+  // once it is linked
+  std::unordered_map<uint64_t, GLuint> edges;
+  for (size_t i = 0; i < num_edges; ++i) {
+    size_t triangle = i - i % 3;
+    GLuint a = welded[ indices[ i ]];
+    GLuint b = welded[ indices[ triangle + (i + 1) % 3 ]];
+    if (a == b) {
+      continue;
+    }
+    uint64_t key = static_cast<uint64_t>(std::min(a, b)) << 32 |
+        std::max(a, b);
+    std::unordered_map<uint64_t, GLuint>::iterator edge = edges.find(key);
+    if (edge == edges.end()) {
+      edges[ key ] = i;
+      continue;
+    }
+    if (edge->second == kNoOccluderNeighbor) {
+      continue;
+    }
+    GLuint other = edge->second;
+    size_t other_triangle = other - other % 3;
+    mesh->neighbors[ i ] = indices[ other_triangle + (other + 2) % 3 ];
+    mesh->neighbors[ other ] = indices[ triangle + (i + 2) % 3 ];
+    edge->second = kNoOccluderNeighbor;
+  }
+}
+
+} // namespace oncgl
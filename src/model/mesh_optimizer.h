@@ -0,0 +1,90 @@
+#ifndef ONCGL_MODEL_MESH_OPTIMIZER_H
+#define ONCGL_MODEL_MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "model/objects.h"
+
+namespace oncgl {
+
+// entries of the simulated post-transform vertex cache
+const unsigned int kVertexCacheSize = 16;
+
+/**
+ * Efficiency of an index buffer for a FIFO post-transform vertex cache
+ */
+struct VertexCacheStats {
+
+  // average cache miss ratio, vertex shader invocations per triangle
+  // (0.5 is the optimum for large grids, 3.0 the worst case)
+  float acmr;
+  // average transform to vertex ratio, vertex shader invocations per
+  // referenced vertex (1.0 is the optimum)
+  float atvr;
+};
+
+/**
+ * Simulate a FIFO vertex cache for the given triangle list
+ *
+ * @param indices       triangle list
+ * @param num_indices   number of indices
+ * @param num_vertices  number of vertices the indices refer to
+ * @param cache_size    number of cache entries
+ * @returns the cache statistics
+ */
+VertexCacheStats AnalyzeVertexCache(const GLuint *indices, GLuint num_indices,
+                                    GLuint num_vertices,
+                                    unsigned int cache_size = kVertexCacheSize);
+
+/**
+ * Reorder the triangles for the post-transform vertex cache
+ * Tipsify (Sander, Nehab, Barczak 2007): fans around the most recently used
+ * vertex that is still in the cache and restarts at a dead-end vertex.
+ *
+ * @param indices       triangle list, reordered in place
+ * @param num_vertices  number of vertices the indices refer to
+ * @param cache_size    number of cache entries
+ */
+void OptimizeVertexCache(std::vector<GLuint> *indices, GLuint num_vertices,
+                         unsigned int cache_size = kVertexCacheSize);
+
+/**
+ * Reorder clusters of triangles so outward facing parts are drawn first
+ * The clusters are the runs of the vertex cache order that start with a cold
+ * cache, so moving them around costs (almost) no vertex cache efficiency. The
+ * new order is only kept if the ACMR grows by less than the threshold.
+ *
+ * @param indices       triangle list in vertex cache order, reordered in place
+ * @param vertices      vertices the indices refer to
+ * @param num_vertices  number of vertices
+ * @param threshold     allowed factor of ACMR increase
+ */
+void OptimizeOverdraw(std::vector<GLuint> *indices, const Vertex *vertices,
+                      GLuint num_vertices, float threshold = 1.05f);
+
+/**
+ * Reorder the vertices in the order the triangles first use them
+ * Unreferenced vertices are removed.
+ *
+ * @param vertices  vertices, reordered in place
+ * @param indices   triangle list, remapped to the new vertex order
+ */
+void OptimizeVertexFetch(std::vector<Vertex> *vertices,
+                         std::vector<GLuint> *indices);
+
+/**
+ * Find the triangles sharing an edge, so the occlusion buffer can tell the
+ * silhouette edges of an occluder from the edges inside of it
+ * Vertices at the same position count as one, meshes split their vertices
+ * along seams of normals and texture coordinates. An edge used by more than
+ * two triangles only links the first two.
+ *
+ * @param mesh  occluder, fills its neighbors
+ */
+void FindOccluderNeighbors(OccluderMesh *mesh);
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_MESH_OPTIMIZER_H
@@ -1,20 +1,74 @@
 #include "model/model.h"
 
+#include <glm/gtc/type_ptr.hpp>
+
+#include "renderer/gl_state.h"
+
 namespace oncgl {
 
+namespace {
+
+// meshes with more triangles are not kept on the CPU as occluders, drawing
+// them into the occlusion buffer would cost more than it saves
+const GLuint kMaxOccluderTriangles = 4096;
+
+} // namespace
+
+const unsigned int Model::kImportFlags = aiProcess_Triangulate |
+                                         aiProcess_FlipUVs |
+                                         aiProcess_CalcTangentSpace;
+
 Model::Model(std::string path, glm::mat4 model_matrix) :
-    path_(path),
+    Model(Load(path), model_matrix) {
+}
+
+Model::Model(const ModelData &data, glm::mat4 model_matrix) :
+    nodes_(data.nodes),
+    directory_(data.directory),
+    path_(data.path),
+    vertex_format_(data.format),
     model_matrix_(model_matrix) {
 
-  LoadModel(path_);
+  std::vector<MeshView> views = data.views();
+  for (GLuint i = 0; i < views.size(); i++) {
+    if (vertex_format_ == VERTEX_FORMAT_PACKED) {
+      AddMesh(views[ i ], &data.packed_vertices[ i ]);
+    } else {
+      AddMesh(views[ i ]);
+    }
+  }
+
+  // union of the meshes placed at their nodes, node transforms are
+  // accumulated parents first
+  bounds_ = Bounds::Empty();
+  std::vector<glm::mat4> node_transforms(nodes_.size());
+  for (GLuint i = 0; i < nodes_.size(); i++) {
+    const ModelNode &node = nodes_[ i ];
+    node_transforms[ i ] = node.parent < 0 ? node.transform :
+        node_transforms[ node.parent ] * node.transform;
+    for (GLuint j = 0; j < node.meshes.size(); j++) {
+      bounds_.Merge(meshes_[ node.meshes[ j ] ].bounds(), node_transforms[ i ]);
+    }
+  }
 }
 
 void Model::Draw(Program *program) {
 
-  // std::cout << _meshes.size() << std::endl;
+  // all meshes of a model share the VAO of its vertex format
+  GeometryArena::Instance().Bind(vertex_format_);
   for (GLuint i = 0; i < meshes_.size(); i++) {
-    meshes_[ i ].Draw(program->object());
+    meshes_[ i ].Draw(program);
   }
+  GLState::Instance().BindVertexArray(0);
+}
+
+void Model::DrawInstanced(Program *program, GLsizei num_instances) {
+
+  GeometryArena::Instance().Bind(vertex_format_);
+  for (GLuint i = 0; i < meshes_.size(); i++) {
+    meshes_[ i ].DrawInstanced(program, num_instances);
+  }
+  GLState::Instance().BindVertexArray(0);
 }
 
 void Model::set_model_matrix(glm::mat4 matrix) {
@@ -25,102 +79,189 @@ glm::mat4 Model::model_matrix() const {
   return model_matrix_;
 }
 
-void Model::LoadModel(std::string path) {
+VertexFormat Model::vertex_format() const {
+  return vertex_format_;
+}
+
+size_t Model::num_meshes() const {
+  return meshes_.size();
+}
+
+const std::vector<ModelNode> &Model::nodes() const {
+  return nodes_;
+}
+
+const Bounds &Model::bounds() const {
+  return bounds_;
+}
+
+Mesh *Model::mesh(GLuint index) {
+  return &meshes_[ index ];
+}
+
+ModelData Model::Load(const std::string &path, VertexFormat format) {
+
+  ModelData data;
+  data.path = path;
+  data.format = format;
+  // Retrieve the directory path of the filepath
+  data.directory = path.substr(0, path.find_last_of('/'));
+
+  // Warm start: take the final meshes straight from the mapped cache
+  std::shared_ptr<MeshCache> cache(new MeshCache());
+  if (cache->Open(path, kImportFlags)) {
+    data.cache = cache;
+    data.nodes = cache->nodes();
+  } else if (ImportModel(path, &data.meshes, &data.nodes)) {
+    if (!MeshCache::Write(path, kImportFlags, data.views(), data.nodes)) {
+      std::cout << K_YELLOW << "Could not write mesh cache " <<
+          MeshCache::CachePath(path) << K_RESET << std::endl;
+    }
+  }
+
+  // the cache always holds float vertices, they are compressed per load
+  if (format == VERTEX_FORMAT_PACKED) {
+    std::vector<MeshView> views = data.views();
+    data.packed_vertices.resize(views.size());
+    for (GLuint i = 0; i < views.size(); i++) {
+      PackVertices(views[ i ].vertices, views[ i ].num_vertices,
+                   &data.packed_vertices[ i ]);
+    }
+  }
+
+  return data;
+}
+
+bool Model::ImportModel(const std::string &path,
+                        std::vector<MeshData> *meshes,
+                        std::vector<ModelNode> *nodes) {
 
   // Read file via ASSIMP
   Assimp::Importer importer;
-  const aiScene *scene = importer.ReadFile(path,
-                                           aiProcess_Triangulate |
-                                           aiProcess_FlipUVs |
-                                           aiProcess_CalcTangentSpace);
+  const aiScene *scene = importer.ReadFile(path, kImportFlags);
   // Check for errors
   if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
     std::cout << K_RED << "ERROR::ASSIMP:: " << importer.GetErrorString() <<
         K_RESET << std::endl;
-    return;
+    return false;
   }
 
-  // Retrieve the directory path of the filepath
-  directory_ = path.substr(0, path.find_last_of('/'));
+  // Every mesh is imported once, the nodes refer to them by index
+  for (GLuint i = 0; i < scene->mNumMeshes; i++) {
+    meshes->push_back(ProcessMesh(scene->mMeshes[ i ], scene));
+  }
+  OptimizeMeshes(path, meshes);
 
   // Process ASSIMP's root node recursively
-  ProcessNode(scene->mRootNode, scene);
-  // std::cout << _meshes.size() << std::endl;
+  ProcessNode(scene->mRootNode, -1, nodes);
+  return true;
 }
 
-void Model::ProcessNode(aiNode *node, const aiScene *scene) {
+void Model::OptimizeMeshes(const std::string &path,
+                           std::vector<MeshData> *meshes) {
+
+  // totals over all meshes, weighted by triangles and vertices
+  double misses_before = 0.0, misses_after = 0.0;
+  double triangles = 0.0, vertices = 0.0;
+
+  for (GLuint i = 0; i < meshes->size(); i++) {
+    MeshData &mesh = (*meshes)[ i ];
+    VertexCacheStats before = AnalyzeVertexCache(
+        mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
 
-  // Process each mesh located at the current node
-  for (GLuint i = 0; i < node->mNumMeshes; i++) {
-    // The node object only contains indices to index the actual objects in the scene.
-    // The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-    aiMesh *mesh = scene->mMeshes[ node->mMeshes[ i ]];
-    meshes_.push_back(ProcessMesh(mesh, scene));
+    OptimizeVertexCache(&mesh.indices, mesh.vertices.size());
+    OptimizeOverdraw(&mesh.indices, mesh.vertices.data(),
+                     mesh.vertices.size());
+    OptimizeVertexFetch(&mesh.vertices, &mesh.indices);
+    mesh.bounds = Bounds::FromVertices(mesh.vertices.data(),
+                                       mesh.vertices.size());
+
+    VertexCacheStats after = AnalyzeVertexCache(
+        mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+    double num_triangles = mesh.indices.size() / 3;
+    misses_before += before.acmr * num_triangles;
+    misses_after += after.acmr * num_triangles;
+    triangles += num_triangles;
+    vertices += mesh.vertices.size();
+  }
+
+  if (triangles == 0.0) {
+    return;
   }
-  // After we've processed all of the meshes (if any) we then recursively process each of the children nodes
+
+  std::cout << "Optimized " << path << ": ACMR " <<
+      misses_before / triangles << " -> " << misses_after / triangles <<
+      ", ATVR " << misses_before / vertices << " -> " <<
+      misses_after / vertices << std::endl;
+}
+
+void Model::ProcessNode(const aiNode *node, int32_t parent,
+                        std::vector<ModelNode> *nodes) {
+
+  int32_t index = nodes->size();
+  nodes->push_back(ModelNode());
+  ModelNode &model_node = nodes->back();
+  model_node.parent = parent;
+  // assimp matrices are row major, glm matrices column major
+  model_node.transform = glm::transpose(
+      glm::make_mat4(&node->mTransformation.a1));
+  // The node object only contains indices to index the actual objects in the scene.
+  model_node.meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+  // After we've processed the current node we then recursively process each of the children nodes
   for (GLuint i = 0; i < node->mNumChildren; i++) {
-    ProcessNode(node->mChildren[ i ], scene);
+    ProcessNode(node->mChildren[ i ], index, nodes);
   }
 }
 
-Mesh Model::ProcessMesh(aiMesh *mesh, const aiScene *scene) {
+MeshData Model::ProcessMesh(aiMesh *mesh, const aiScene *scene) {
   // Data to fill
-  std::vector<Vertex> vertices;
-  std::vector<GLuint> indices;
-  std::vector<Texture> textures;
+  MeshData data;
+  data.vertices.resize(mesh->mNumVertices);
 
   // Walk through each of the mesh's vertices
+  // assimp uses its own vector class that doesn't directly convert to glm's
+  // vector classes so we copy the components.
+  const aiVector3D *tex_coords = mesh->mTextureCoords[ 0 ];
   for (GLuint i = 0; i < mesh->mNumVertices; i++) {
-    Vertex vertex;
-    // We declare a placeholder vector since assimp uses its own vector class that doesn't directly
-    // convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-    glm::vec3 vector;
-    // Positions
-    vector.x = mesh->mVertices[ i ].x;
-    vector.y = mesh->mVertices[ i ].y;
-    vector.z = mesh->mVertices[ i ].z;
-    vertex.position = vector;
-    // Normals
-    vector.x = mesh->mNormals[ i ].x;
-    vector.y = mesh->mNormals[ i ].y;
-    vector.z = mesh->mNormals[ i ].z;
-    vertex.normal = vector;
+    Vertex &vertex = data.vertices[ i ];
+
+    const aiVector3D &position = mesh->mVertices[ i ];
+    vertex.position = glm::vec3(position.x, position.y, position.z);
+
+    const aiVector3D &normal = mesh->mNormals[ i ];
+    vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+
     // Texture Coordinates
-    // Does the mesh contain texture coordinates?
-    if (mesh->mTextureCoords[ 0 ]) {
-      glm::vec2 vec;
-      // A vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-      // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-      vec.x = mesh->mTextureCoords[ 0 ][ i ].x;
-      vec.y = mesh->mTextureCoords[ 0 ][ i ].y;
-      vertex.tex_coords = vec;
-
-      glm::vec3 tang;
-      tang.x = mesh->mTangents[ i ].x;
-      tang.y = mesh->mTangents[ i ].y;
-      tang.z = mesh->mTangents[ i ].z;
-      vertex.tangent = tang;
-
-      glm::vec3 bi_tang;
-      bi_tang.x = mesh->mBitangents[ i ].x;
-      bi_tang.y = mesh->mBitangents[ i ].y;
-      bi_tang.z = mesh->mBitangents[ i ].z;
-      vertex.bi_tangent = bi_tang;
+    // A vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+    // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+    if (tex_coords) {
+      vertex.tex_coords = glm::vec2(tex_coords[ i ].x, tex_coords[ i ].y);
+
+      const aiVector3D &tangent = mesh->mTangents[ i ];
+      vertex.tangent = glm::vec3(tangent.x, tangent.y, tangent.z);
+
+      const aiVector3D &bi_tangent = mesh->mBitangents[ i ];
+      vertex.bi_tangent = glm::vec3(bi_tangent.x, bi_tangent.y, bi_tangent.z);
     } else {
       vertex.tex_coords = glm::vec2(0.0f, 0.0f);
+      vertex.tangent = glm::vec3(0.0f);
+      vertex.bi_tangent = glm::vec3(0.0f);
     }
-
-    vertices.push_back(vertex);
   }
+
   // Now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+  // Faces are triangles after aiProcess_Triangulate
+  data.indices.reserve(mesh->mNumFaces * 3);
   for (GLuint i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[ i ];
+    const aiFace &face = mesh->mFaces[ i ];
     // Retrieve all indices of the face and store them in the indices vector
-    for (GLuint j = 0; j < face.mNumIndices; j++) {
-      indices.push_back(face.mIndices[ j ]);
-    }
+    data.indices.insert(data.indices.end(), face.mIndices,
+                        face.mIndices + face.mNumIndices);
   }
+
   // Process materials
   aiMaterial *material = scene->mMaterials[ mesh->mMaterialIndex ];
   // We assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -131,85 +272,119 @@ Mesh Model::ProcessMesh(aiMesh *mesh, const aiScene *scene) {
   // Normal: texture_normalN
 
   // 1. Diffuse maps
-  std::vector<Texture>
+  std::vector<TextureRef>
       diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE,
                                          "texture_diffuse");
-  textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+  data.textures.insert(data.textures.end(), diffuseMaps.begin(),
+                       diffuseMaps.end());
   // 2. Specular maps
-  std::vector<Texture>
+  std::vector<TextureRef>
       specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR,
                                           "texture_specular");
-  textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+  data.textures.insert(data.textures.end(), specularMaps.begin(),
+                       specularMaps.end());
 
   // 3. normals for bump maps
-  std::vector<Texture>
+  std::vector<TextureRef>
       normalMaps = LoadMaterialTextures(material, aiTextureType_HEIGHT,
                                         "texture_normals");
-  textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+  data.textures.insert(data.textures.end(), normalMaps.begin(),
+                       normalMaps.end());
+
+  // 4. scalar parameters
+  float shininess = 0.0f;
+  if (material->Get(AI_MATKEY_SHININESS, shininess) != aiReturn_SUCCESS ||
+      shininess <= 0.0f) {
+    shininess = Material::kDefaultShininess;
+  }
+  data.shininess = shininess;
 
-  // Return a mesh object created from the extracted mesh data
-  return Mesh(vertices, indices, textures);
+  return data;
 }
 
-// Checks all material textures of a given type and loads the textures if they're not loaded yet.
-// The required info is returned as a Texture struct.
-std::vector<Texture> Model::LoadMaterialTextures(aiMaterial *mat,
-                                                 aiTextureType type,
-                                                 std::string type_name) {
+// Collects the texture files of a given type of the material
+std::vector<TextureRef> Model::LoadMaterialTextures(aiMaterial *mat,
+                                                    aiTextureType type,
+                                                    std::string type_name) {
 
-  std::vector<Texture> textures;
+  std::vector<TextureRef> textures;
   for (GLuint i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
     mat->GetTexture(type, i, &str);
-    // Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-    GLboolean skip = false;
-    for (GLuint j = 0; j < textures_loaded_.size(); j++) {
-      if (textures_loaded_[ j ].path == str) {
-        textures.push_back(textures_loaded_[ j ]);
-        // A texture with the same filepath has already been loaded,
-        // continue to next one. (optimization)
-        skip = true;
-        break;
-      }
-    }
-    if (!skip) {   // If texture hasn't been loaded already, load it
-      Texture texture;
-      texture.id = TextureFromFile(str.C_Str(), directory_);
-      texture.type = type_name;
-      texture.path = str;
-      textures.push_back(texture);
-      // Store it as texture loaded for entire model, to ensure we won't
-      // unnecesery load duplicate textures.
-      textures_loaded_.push_back(texture);
-    }
+
+    TextureRef texture;
+    texture.type = type_name;
+    texture.path = str.C_Str();
+    textures.push_back(texture);
   }
   return textures;
 }
 
-GLint Model::TextureFromFile(const char *path, std::string directory) {
-  //Generate texture ID and load texture data
-  std::string filename = std::string(path);
-  filename = directory + '/' + filename;
-  GLuint textureID;
-  glGenTextures(1, &textureID);
-  int width, height;
-  unsigned char *image = SOIL_load_image(filename.c_str(), &width, &height, 0,
-                                         SOIL_LOAD_RGB);
-  // Assign texture to ID
-  glBindTexture(GL_TEXTURE_2D, textureID);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, image);
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  // Parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  SOIL_free_image_data(image);
-  return textureID;
+void Model::AddMesh(const MeshView &mesh,
+                    const std::vector<PackedVertex> *packed) {
+
+  std::vector<Texture> textures;
+  for (GLuint i = 0; i < mesh.textures.size(); i++) {
+    const TextureRef &ref = mesh.textures[ i ];
+    // models sharing an image file share the texture
+    Texture texture;
+    texture.handle = TextureCache::Instance().Acquire(
+        directory_ + '/' + ref.path);
+    texture.id = texture.handle->id();
+    texture.type = ref.type;
+    texture.path = ref.path;
+    textures.push_back(texture);
+  }
+
+  std::shared_ptr<const Material> material =
+      std::make_shared<Material>(textures, mesh.shininess);
+
+  if (packed) {
+    meshes_.push_back(Mesh(VERTEX_FORMAT_PACKED, packed->data(),
+                           mesh.num_vertices, mesh.indices, mesh.num_indices,
+                           material, mesh.bounds));
+  } else {
+    meshes_.push_back(Mesh(VERTEX_FORMAT_FLOAT, mesh.vertices,
+                           mesh.num_vertices, mesh.indices, mesh.num_indices,
+                           material, mesh.bounds));
+  }
+
+  if (mesh.num_indices > 0 && mesh.num_indices / 3 <= kMaxOccluderTriangles) {
+    std::shared_ptr<OccluderMesh> occluder = std::make_shared<OccluderMesh>();
+    occluder->positions.resize(mesh.num_vertices);
+    for (GLuint i = 0; i < mesh.num_vertices; i++) {
+      occluder->positions[ i ] = mesh.vertices[ i ].position;
+    }
+    occluder->indices.assign(mesh.indices, mesh.indices + mesh.num_indices);
+    FindOccluderNeighbors(occluder.get());
+    meshes_.back().set_occluder(occluder);
+  }
+}
+
+MeshView MeshData::view() const {
+
+  MeshView view;
+  view.vertices = vertices.data();
+  view.num_vertices = vertices.size();
+  view.indices = indices.data();
+  view.num_indices = indices.size();
+  view.textures = textures;
+  view.shininess = shininess;
+  view.bounds = bounds;
+  return view;
+}
+
+std::vector<MeshView> ModelData::views() const {
+
+  if (cache) {
+    return cache->meshes();
+  }
+
+  std::vector<MeshView> result;
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    result.push_back(meshes[ i ].view());
+  }
+  return result;
 }
 
 } // namespace oncgl
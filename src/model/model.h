@@ -6,59 +6,204 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <SOIL/SOIL.h>
-
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "shader_program/shader_program.h"
 #include "model/mesh.h"
+#include "model/mesh_cache.h"
+#include "model/mesh_optimizer.h"
+#include "model/texture_cache.h"
+#include "model/vertex_packing.h"
 
 #include "misc/constants.h"
 
 namespace oncgl {
 
+/**
+ * Geometry of a mesh as it comes out of the importer
+ */
+struct MeshData {
+
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+  std::vector<TextureRef> textures;
+  // specular exponent of the material
+  float shininess;
+  Bounds bounds;
+
+  MeshView view() const;
+};
+
+/**
+ * Everything of a model that can be loaded without an OpenGL context
+ * Created by Model::Load on any thread and uploaded by the Model constructor
+ * on the thread that owns the context.
+ */
+struct ModelData {
+
+  std::string path;
+  std::string directory;
+
+  // meshes of a fresh import, empty if the mesh cache was used
+  std::vector<MeshData> meshes;
+  // node hierarchy, of the import or copied from the cache
+  std::vector<ModelNode> nodes;
+  // mapped mesh cache, NULL after a fresh import
+  std::shared_ptr<MeshCache> cache;
+
+  // layout the meshes are uploaded with
+  VertexFormat format;
+  // compressed vertices per mesh, only filled for VERTEX_FORMAT_PACKED
+  std::vector<std::vector<PackedVertex> > packed_vertices;
+
+  /**
+   * Meshes of the model, either of the import or of the cache
+   * The views are only valid as long as this ModelData is alive.
+   */
+  std::vector<MeshView> views() const;
+};
+
 class Model {
 
  public:
+  /**
+   * Load and upload a model on the calling thread
+   *
+   * @param path          path of the model file
+   * @param model_matrix  transformation of the model
+   */
   Model(std::string path, glm::mat4 model_matrix = glm::mat4(1.0f));
 
   /**
-   * Draw the Model with the given program
+   * Upload a model that was loaded with Model::Load
+   * Must be called on the thread the OpenGL context is current on.
+   *
+   * @param data          loaded model
+   * @param model_matrix  transformation of the model
+   */
+  Model(const ModelData &data, glm::mat4 model_matrix = glm::mat4(1.0f));
+
+  /**
+   * Load all meshes of a model into CPU memory
+   * Uses the mesh cache of the model if it is up-to-date, otherwise the model
+   * is imported with assimp and the cache is (re-)written.
+   * Does not touch OpenGL, so it can run on any thread.
+   *
+   * @param path    path of the model file
+   * @param format  vertex layout to upload the meshes with, the vertices are
+   *                compressed here so the upload does not pay for it
+   * @returns the loaded model, without meshes if the import failed
+   */
+  static ModelData Load(const std::string &path,
+                        VertexFormat format = VERTEX_FORMAT_FLOAT);
+
+  /**
+   * Draw the Model with the given program, without the materials of its
+   * meshes, see Mesh::Draw
    *
    * @param program   Program to draw the model with
    */
   void Draw(Program *program);
 
+  /**
+   * Draw several instances of the Model, one draw call per mesh
+   * The program reads the per-instance data with gl_InstanceID.
+   *
+   * @param program         Program to draw the model with
+   * @param num_instances   number of instances
+   */
+  void DrawInstanced(Program *program, GLsizei num_instances);
+
   void set_model_matrix(glm::mat4 matrix);
 
   glm::mat4 model_matrix() const;
 
+  VertexFormat vertex_format() const;
+
+  size_t num_meshes() const;
+
+  /**
+   * Node hierarchy of the model file, parents first
+   * Draw and DrawInstanced ignore it, Scene places the meshes at their nodes.
+   */
+  const std::vector<ModelNode> &nodes() const;
+
+  /**
+   * Bounds of all meshes at their nodes, in model space
+   */
+  const Bounds &bounds() const;
+
+  Mesh *mesh(GLuint index);
+
  private:
+  // post-processing steps of the import, part of the key of the mesh cache
+  static const unsigned int kImportFlags;
+
   std::vector<Mesh> meshes_;
+  std::vector<ModelNode> nodes_;
   std::string directory_;
   std::string path_;
-  std::vector<Texture> textures_loaded_;
+  VertexFormat vertex_format_;
+  Bounds bounds_;
 
   glm::mat4 model_matrix_;
 
-  void LoadModel(std::string path);
+  /**
+   * Import the model with assimp
+   *
+   * @param path    path of the model file
+   * @param meshes  receives the imported meshes
+   * @param nodes   receives the node hierarchy
+   * @returns true - if the import succeeded, otherwise false
+   */
+  static bool ImportModel(const std::string &path,
+                          std::vector<MeshData> *meshes,
+                          std::vector<ModelNode> *nodes);
+
+  /**
+   * Reorder triangles and vertices of the imported meshes for the vertex
+   * cache, overdraw and vertex fetch and print the cache efficiency
+   *
+   * @param path    path of the model file, for the report
+   * @param meshes  imported meshes, optimized in place
+   */
+  static void OptimizeMeshes(const std::string &path,
+                             std::vector<MeshData> *meshes);
 
-  void ProcessNode(aiNode *node, const aiScene *scene);
+  /**
+   * Append a node and its children to the hierarchy, parents first
+   *
+   * @param node    assimp node to add
+   * @param parent  index of the parent node, -1 for the root
+   * @param nodes   hierarchy to append to
+   */
+  static void ProcessNode(const aiNode *node, int32_t parent,
+                          std::vector<ModelNode> *nodes);
 
-  Mesh ProcessMesh(aiMesh *mesh, const aiScene *scene);
+  static MeshData ProcessMesh(aiMesh *mesh, const aiScene *scene);
 
-  std::vector<Texture> LoadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                            std::string type_name);
+  static std::vector<TextureRef> LoadMaterialTextures(aiMaterial *mat,
+                                                      aiTextureType type,
+                                                      std::string type_name);
 
-  GLint TextureFromFile(const char *path, std::string directory);
+  /**
+   * Upload a mesh and get its textures from the texture cache
+   *
+   * @param mesh    geometry and textures of the mesh
+   * @param packed  compressed vertices of the mesh, NULL to upload the float
+   *                vertices of the view
+   */
+  void AddMesh(const MeshView &mesh,
+               const std::vector<PackedVertex> *packed = NULL);
 };
 
 } // namespace oncgl
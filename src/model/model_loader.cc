@@ -0,0 +1,77 @@
+#include "model/model_loader.h"
+
+namespace oncgl {
+
+namespace {
+
+// Reports an import as done when it leaves the worker, even if it threw
+class NotifyOnExit {
+ public:
+  NotifyOnExit(std::mutex *mutex, std::condition_variable *condition,
+               std::deque<size_t> *done, size_t index) :
+      mutex_(mutex), condition_(condition), done_(done), index_(index) { }
+
+  ~NotifyOnExit() {
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      done_->push_back(index_);
+    }
+    condition_->notify_one();
+  }
+
+ private:
+  std::mutex *mutex_;
+  std::condition_variable *condition_;
+  std::deque<size_t> *done_;
+  size_t index_;
+};
+
+} // namespace
+
+ModelLoader::ModelLoader(ThreadPool *pool) :
+    pool_(pool),
+    completion_(new Completion()) {
+}
+
+void ModelLoader::Add(const std::string &path, VertexFormat format) {
+
+  size_t index = imports_.size();
+  std::shared_ptr<Completion> completion = completion_;
+
+  imports_.push_back(pool_->Submit([path, format, index, completion]() {
+    NotifyOnExit notify(&completion->mutex, &completion->condition,
+                        &completion->done, index);
+    return Model::Load(path, format);
+  }));
+}
+
+std::vector<Model> ModelLoader::Finish() {
+
+  std::vector<std::unique_ptr<Model> > uploaded(imports_.size());
+
+  for (size_t uploads = 0; uploads < imports_.size(); ++uploads) {
+    size_t index;
+    {
+      std::unique_lock<std::mutex> lock(completion_->mutex);
+      completion_->condition.wait(lock, [this]() {
+        return !completion_->done.empty();
+      });
+      index = completion_->done.front();
+      completion_->done.pop_front();
+    }
+
+    // rethrows if the import failed
+    ModelData data = imports_[ index ].get();
+    uploaded[ index ].reset(new Model(data));
+  }
+
+  std::vector<Model> models;
+  for (size_t i = 0; i < uploaded.size(); ++i) {
+    models.push_back(*uploaded[ i ]);
+  }
+
+  imports_.clear();
+  return models;
+}
+
+} // namespace oncgl
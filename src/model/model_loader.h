@@ -0,0 +1,68 @@
+#ifndef ONCGL_MODEL_MODEL_LOADER_H
+#define ONCGL_MODEL_MODEL_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "model/model.h"
+#include "misc/thread_pool.h"
+
+namespace oncgl {
+
+/**
+ * Loads several models concurrently
+ *
+ * The CPU part of every model (Model::Load) runs on the thread pool as soon as
+ * the model is added. Finish uploads the models on the calling thread in the
+ * order their imports complete, so a small model never waits for a big one.
+ */
+class ModelLoader {
+ public:
+  /**
+   * @param pool  pool to run the imports on
+   */
+  explicit ModelLoader(ThreadPool *pool = &ThreadPool::Instance());
+
+  /**
+   * Start loading a model in the background
+   *
+   * @param path    path of the model file
+   * @param format  vertex layout to upload the model with
+   */
+  void Add(const std::string &path, VertexFormat format = VERTEX_FORMAT_FLOAT);
+
+  /**
+   * Wait for all added models and upload them
+   * Must be called on the thread the OpenGL context is current on.
+   *
+   * @returns the models in the order they were added
+   */
+  std::vector<Model> Finish();
+
+ private:
+  // indices of the imports that are done, filled by the workers
+  struct Completion {
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<size_t> done;
+  };
+
+  ThreadPool *pool_;
+  std::shared_ptr<Completion> completion_;
+  std::vector<std::future<ModelData> > imports_;
+
+  //copying disabled
+  ModelLoader(const ModelLoader &);
+
+  const ModelLoader &operator=(const ModelLoader &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_MODEL_LOADER_H
@@ -2,11 +2,12 @@
 #define ONCGL_MODEL_OBJECT_H
 
 #include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
-#include <assimp/Importer.hpp>
+#include "model/texture_cache.h"
 
 namespace oncgl {
 
@@ -20,11 +21,61 @@ struct Vertex {
   glm::vec3 bi_tangent;
 };
 
+/**
+ * Compressed vertex, 24 instead of 56 bytes
+ * normal and tangent are octahedral encoded snorm16 pairs, the bitangent is
+ * rebuilt from the sign in the lowest tangent bit, texture coords are halfs.
+ * See vertex_packing.h
+ */
+struct PackedVertex {
+
+  glm::vec3 position;
+  GLuint normal;
+  GLuint tangent;
+  GLuint tex_coords;
+};
+
+// Layout of the vertices in the vertex buffer of a mesh
+enum VertexFormat {
+  VERTEX_FORMAT_FLOAT,
+  VERTEX_FORMAT_PACKED,
+  NUM_VERTEX_FORMATS
+};
+
 struct Texture {
 
   GLuint id;
   std::string type;
-  aiString path;
+  std::string path;
+  // keeps the texture alive
+  TextureHandle handle;
+};
+
+/**
+ * Texture of a mesh before it is loaded
+ * path is relative to the directory of the model
+ */
+struct TextureRef {
+
+  std::string type;
+  std::string path;
+};
+
+// edge of an occluder triangle without a neighbour
+const GLuint kNoOccluderNeighbor = ~0u;
+
+/**
+ * Positions and triangles of a mesh kept on the CPU to be drawn into the
+ * software occlusion buffer, see OcclusionBuffer
+ */
+struct OccluderMesh {
+
+  std::vector<glm::vec3> positions;
+  std::vector<GLuint> indices;
+  // per edge (indices[ i ], next index of its triangle) the vertex opposite
+  // of it in the other triangle sharing the edge, or kNoOccluderNeighbor.
+  // See FindOccluderNeighbors, if empty every edge counts as open.
+  std::vector<GLuint> neighbors;
 };
 
 } // namespace oncgl
@@ -0,0 +1,95 @@
+#include "model/texture_cache.h"
+
+#include <climits>
+#include <cstdlib>
+
+#include "misc/hash.h"
+#include "model/texture_streamer.h"
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+CachedTexture::CachedTexture(GLuint id, uint64_t key) :
+    id_(id),
+    key_(key) {
+}
+
+CachedTexture::~CachedTexture() {
+  TextureCache::Instance().Remove(key_);
+  TextureStreamer::Instance().Cancel(id_);
+  GLState::Instance().DeleteTextures(1, &id_);
+}
+
+GLuint CachedTexture::id() const {
+  return id_;
+}
+
+TextureCache::TextureCache() :
+    key_by_content_(false) {
+}
+
+TextureCache &TextureCache::Instance() {
+  // never destroyed, handles may outlive static destruction
+  static TextureCache *cache = new TextureCache();
+  return *cache;
+}
+
+TextureHandle TextureCache::Acquire(const std::string &path) {
+
+  uint64_t key = Key(path);
+
+  std::unordered_map<uint64_t, std::weak_ptr<const CachedTexture> >::iterator
+      it = textures_.find(key);
+  if (it != textures_.end()) {
+    TextureHandle texture = it->second.lock();
+    if (texture) {
+      return texture;
+    }
+  }
+
+  TextureHandle texture(
+      new CachedTexture(TextureStreamer::Instance().Request(path), key));
+  textures_[ key ] = texture;
+  return texture;
+}
+
+void TextureCache::set_key_by_content(bool key_by_content) {
+  key_by_content_ = key_by_content;
+}
+
+size_t TextureCache::size() const {
+  return textures_.size();
+}
+
+uint64_t TextureCache::Key(const std::string &path) const {
+
+  uint64_t key;
+  if (key_by_content_ && HashFile(path, &key)) {
+    return key;
+  }
+
+  std::string canonical_path = CanonicalPath(path);
+  return Fnv1a(canonical_path.data(), canonical_path.size());
+}
+
+std::string TextureCache::CanonicalPath(const std::string &path) {
+
+  char resolved[ PATH_MAX ];
+  if (realpath(path.c_str(), resolved)) {
+    return resolved;
+  }
+  // missing file, it still gets (and keeps) its placeholder
+  return path;
+}
+
+void TextureCache::Remove(uint64_t key) {
+
+  std::unordered_map<uint64_t, std::weak_ptr<const CachedTexture> >::iterator
+      it = textures_.find(key);
+  // the entry may already belong to a newer texture with the same key
+  if (it != textures_.end() && it->second.expired()) {
+    textures_.erase(it);
+  }
+}
+
+} // namespace oncgl
@@ -0,0 +1,92 @@
+#ifndef ONCGL_MODEL_TEXTURE_CACHE_H
+#define ONCGL_MODEL_TEXTURE_CACHE_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+namespace oncgl {
+
+/**
+ * Texture owned by the TextureCache
+ * The OpenGL texture is deleted together with the last reference.
+ */
+class CachedTexture {
+ public:
+  ~CachedTexture();
+
+  GLuint id() const;
+
+ private:
+  friend class TextureCache;
+
+  GLuint id_;
+  uint64_t key_;
+
+  CachedTexture(GLuint id, uint64_t key);
+
+  //copying disabled
+  CachedTexture(const CachedTexture &);
+
+  const CachedTexture &operator=(const CachedTexture &);
+};
+
+// reference counted handle to a cached texture
+typedef std::shared_ptr<const CachedTexture> TextureHandle;
+
+/**
+ * Process-wide cache of the textures of all models
+ *
+ * Textures are keyed by a hash of their canonical path (symlinks, "." and ".."
+ * resolved), so every image file is decoded and uploaded once no matter how
+ * many models use it. Optionally the key is the hash of the file content,
+ * which also merges identical images stored under different names.
+ * Must only be used on the thread the OpenGL context is current on.
+ */
+class TextureCache {
+ public:
+  static TextureCache &Instance();
+
+  /**
+   * Get the texture of an image file
+   * Textures that are not cached yet are streamed in by the TextureStreamer.
+   *
+   * @param path  path of the image file
+   * @returns handle of the texture, the texture lives as long as the handle
+   */
+  TextureHandle Acquire(const std::string &path);
+
+  /**
+   * Key textures by the hash of the file content instead of the path
+   * Costs reading every requested file once on the calling thread.
+   */
+  void set_key_by_content(bool key_by_content);
+
+  /**
+   * Number of textures alive
+   */
+  size_t size() const;
+
+ private:
+  friend class CachedTexture;
+
+  bool key_by_content_;
+  std::unordered_map<uint64_t, std::weak_ptr<const CachedTexture> > textures_;
+
+  TextureCache();
+
+  uint64_t Key(const std::string &path) const;
+
+  static std::string CanonicalPath(const std::string &path);
+
+  // called by the destructor of the last handle
+  void Remove(uint64_t key);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_TEXTURE_CACHE_H
@@ -0,0 +1,177 @@
+#include "model/texture_streamer.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "misc/constants.h"
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+// mid-grey, so unlit and lit surfaces still look plausible while loading
+const unsigned char TextureStreamer::kPlaceholder[ 3 ] = { 128, 128, 128 };
+
+TextureStreamer::TextureStreamer(ThreadPool *pool) :
+    pool_(pool),
+    queue_(new Queue()),
+    pending_(0),
+    next_request_(0),
+    next_buffer_(0) {
+
+  // the pixel buffers are created on the first upload, there might be no
+  // context yet
+  for (unsigned int i = 0; i < kNumPixelBuffers; ++i) {
+    pixel_buffers_[ i ] = 0;
+    fences_[ i ] = 0;
+  }
+}
+
+TextureStreamer &TextureStreamer::Instance() {
+  // never destroyed, the context is gone at exit anyway
+  static TextureStreamer *streamer = new TextureStreamer();
+  return *streamer;
+}
+
+GLuint TextureStreamer::Request(const std::string &path) {
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE,
+               kPlaceholder);
+
+  // Parameters
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
+
+  pending_++;
+  uint64_t request = next_request_++;
+  requests_[ texture ] = request;
+
+  std::shared_ptr<Queue> queue = queue_;
+  pool_->Submit([queue, texture, request, path]() {
+    Decoded decoded;
+    decoded.texture = texture;
+    decoded.request = request;
+    decoded.path = path;
+    decoded.image = Image::FromFile(path);
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->decoded.push_back(decoded);
+  });
+
+  return texture;
+}
+
+void TextureStreamer::Cancel(GLuint texture) {
+  requests_.erase(texture);
+}
+
+void TextureStreamer::Update(size_t budget_bytes) {
+
+  if (pending_ == 0) {
+    return;
+  }
+
+  if (pixel_buffers_[ 0 ] == 0) {
+    glGenBuffers(kNumPixelBuffers, pixel_buffers_);
+  }
+
+  size_t uploaded_bytes = 0;
+  while (uploaded_bytes < budget_bytes) {
+    Decoded decoded;
+    {
+      std::lock_guard<std::mutex> lock(queue_->mutex);
+      if (queue_->decoded.empty()) {
+        break;
+      }
+      decoded = queue_->decoded.front();
+    }
+
+    std::unordered_map<GLuint, uint64_t>::iterator request =
+        requests_.find(decoded.texture);
+    bool current = request != requests_.end() &&
+        request->second == decoded.request;
+    if (!current) {
+      // the texture was released while it was loading, its name may already
+      // belong to a newer texture
+    } else if (decoded.image) {
+      if (!Upload(decoded)) {
+        // ring is full, try again next frame
+        break;
+      }
+      uploaded_bytes += (size_t) decoded.image->width() *
+          decoded.image->height() * 3;
+    } else {
+      // keep the placeholder
+      std::cout << K_RED << "ERROR: Failed to load texture " << decoded.path <<
+          K_RESET << std::endl;
+    }
+
+    if (current) {
+      requests_.erase(request);
+    }
+    {
+      std::lock_guard<std::mutex> lock(queue_->mutex);
+      queue_->decoded.pop_front();
+    }
+    pending_--;
+  }
+}
+
+bool TextureStreamer::Upload(const Decoded &decoded) {
+
+  GLsync &fence = fences_[ next_buffer_ ];
+  if (fence) {
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      return false;
+    }
+    glDeleteSync(fence);
+    fence = 0;
+  }
+
+  const Image &image = *decoded.image;
+  GLsizeiptr size = (GLsizeiptr) image.width() * image.height() * 3;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers_[ next_buffer_ ]);
+  // orphan the old storage, the PBO is sized for the current image
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                  GL_MAP_WRITE_BIT |
+                                  GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (!mapped) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return false;
+  }
+  memcpy(mapped, image.pixels(), size);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  // the upload reads from the bound PBO, pixels is an offset into it
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, decoded.texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width(), image.height(), 0,
+               GL_RGB, GL_UNSIGNED_BYTE, (GLvoid *) 0);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  next_buffer_ = (next_buffer_ + 1) % kNumPixelBuffers;
+  return true;
+}
+
+bool TextureStreamer::Idle() const {
+  return pending_ == 0;
+}
+
+unsigned int TextureStreamer::pending() const {
+  return pending_;
+}
+
+} // namespace oncgl
@@ -0,0 +1,128 @@
+#ifndef ONCGL_MODEL_TEXTURE_STREAMER_H
+#define ONCGL_MODEL_TEXTURE_STREAMER_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "model/image.h"
+#include "misc/thread_pool.h"
+
+namespace oncgl {
+
+/**
+ * Loads textures in the background
+ *
+ * Request hands out a texture that is usable right away and shows a 1x1
+ * placeholder. The image is decoded on the thread pool, Update copies decoded
+ * images into a ring of pixel buffer objects and replaces the placeholders.
+ * A PBO is only reused once the GPU is done with it, so the render thread never
+ * waits for the driver.
+ */
+class TextureStreamer {
+ public:
+  // number of pixel buffer objects in the ring
+  static const unsigned int kNumPixelBuffers = 4;
+
+  /**
+   * @param pool  pool to decode the images on
+   */
+  explicit TextureStreamer(ThreadPool *pool = &ThreadPool::Instance());
+
+  /**
+   * Process-wide streamer
+   */
+  static TextureStreamer &Instance();
+
+  /**
+   * Create a texture for the given image file and start decoding it
+   * Must be called on the thread the OpenGL context is current on.
+   *
+   * @param path  path of the image file
+   * @returns texture id, shows the placeholder until the image is resident
+   */
+  GLuint Request(const std::string &path);
+
+  /**
+   * Drop the pending upload of a texture, call before deleting it
+   * OpenGL reuses deleted names, so a released texture can not be told apart
+   * from a newer one by its id alone.
+   *
+   * @param texture   texture returned by Request
+   */
+  void Cancel(GLuint texture);
+
+  /**
+   * Upload decoded images, call once per frame on the context thread
+   *
+   * @param budget_bytes  stop uploading after this many bytes
+   */
+  void Update(size_t budget_bytes = 16 * 1024 * 1024);
+
+  /**
+   * @returns true - if every requested texture is resident
+   */
+  bool Idle() const;
+
+  /**
+   * Number of requested textures that are not resident yet
+   */
+  unsigned int pending() const;
+
+ private:
+  // decoded image waiting for its upload
+  struct Decoded {
+
+    GLuint texture;
+    // serial of the request, stale if it no longer matches requests_
+    uint64_t request;
+    std::string path;
+    std::shared_ptr<Image> image;
+  };
+
+  // filled by the workers, drained by Update
+  struct Queue {
+
+    std::mutex mutex;
+    std::deque<Decoded> decoded;
+  };
+
+  ThreadPool *pool_;
+  std::shared_ptr<Queue> queue_;
+  unsigned int pending_;
+
+  // serial of the pending request of every texture still loading, only used
+  // on the context thread
+  std::unordered_map<GLuint, uint64_t> requests_;
+  uint64_t next_request_;
+
+  // ring of pixel buffer objects and the fences of their last upload
+  GLuint pixel_buffers_[ kNumPixelBuffers ];
+  GLsync fences_[ kNumPixelBuffers ];
+  unsigned int next_buffer_;
+
+  static const unsigned char kPlaceholder[ 3 ];
+
+  /**
+   * Upload an image through the next PBO of the ring
+   *
+   * @returns false - if the PBO is still in use by the GPU
+   */
+  bool Upload(const Decoded &decoded);
+
+  //copying disabled
+  TextureStreamer(const TextureStreamer &);
+
+  const TextureStreamer &operator=(const TextureStreamer &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_TEXTURE_STREAMER_H
@@ -0,0 +1,72 @@
+#include "model/vertex_packing.h"
+
+#include <glm/packing.hpp>
+
+namespace oncgl {
+
+namespace {
+
+// component wise sign, without 0
+glm::vec2 SignNotZero(glm::vec2 v) {
+  return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+glm::vec3 NormalizeOr(glm::vec3 v, glm::vec3 fallback) {
+  float length = glm::length(v);
+  return length > 0.0f ? v / length : fallback;
+}
+
+} // namespace
+
+glm::vec2 OctEncode(glm::vec3 direction) {
+
+  glm::vec3 n = direction / (glm::abs(direction.x) + glm::abs(direction.y) +
+                             glm::abs(direction.z));
+  glm::vec2 oct(n.x, n.y);
+  if (n.z < 0.0f) {
+    // fold the lower hemisphere over the diagonals
+    oct = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(oct);
+  }
+  return oct;
+}
+
+glm::vec3 OctDecode(glm::vec2 oct) {
+
+  glm::vec3 n(oct.x, oct.y, 1.0f - glm::abs(oct.x) - glm::abs(oct.y));
+  if (n.z < 0.0f) {
+    glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+        SignNotZero(glm::vec2(n.x, n.y));
+    n.x = folded.x;
+    n.y = folded.y;
+  }
+  return glm::normalize(n);
+}
+
+PackedVertex PackVertex(const Vertex &vertex) {
+
+  glm::vec3 normal = NormalizeOr(vertex.normal, glm::vec3(0.0f, 0.0f, 1.0f));
+  glm::vec3 tangent = NormalizeOr(vertex.tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+
+  PackedVertex packed;
+  packed.position = vertex.position;
+  packed.normal = glm::packSnorm2x16(OctEncode(normal));
+  packed.tex_coords = glm::packHalf2x16(vertex.tex_coords);
+
+  // the bitangent is rebuilt as sign * cross(normal, tangent)
+  bool flipped = glm::dot(glm::cross(normal, tangent), vertex.bi_tangent) < 0.0f;
+  packed.tangent = (glm::packSnorm2x16(OctEncode(tangent)) & ~1u) |
+      (flipped ? 1u : 0u);
+
+  return packed;
+}
+
+void PackVertices(const Vertex *vertices, GLuint num_vertices,
+                  std::vector<PackedVertex> *packed) {
+
+  packed->resize(num_vertices);
+  for (GLuint i = 0; i < num_vertices; ++i) {
+    (*packed)[ i ] = PackVertex(vertices[ i ]);
+  }
+}
+
+} // namespace oncgl
@@ -0,0 +1,51 @@
+#ifndef ONCGL_MODEL_VERTEX_PACKING_H
+#define ONCGL_MODEL_VERTEX_PACKING_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "model/objects.h"
+
+namespace oncgl {
+
+/**
+ * Octahedral encoding of a direction
+ * Maps the unit sphere onto the [-1, 1] square.
+ *
+ * @param direction   normalized direction
+ * @returns position on the square
+ */
+glm::vec2 OctEncode(glm::vec3 direction);
+
+/**
+ * Inverse of OctEncode
+ *
+ * @param oct   position on the square
+ * @returns normalized direction
+ */
+glm::vec3 OctDecode(glm::vec2 oct);
+
+/**
+ * Compress a vertex to the packed layout
+ * The lowest bit of the first tangent component holds the handedness of the
+ * tangent frame (1 = bitangent points along -cross(normal, tangent)).
+ *
+ * @param vertex  vertex to compress
+ * @returns packed vertex
+ */
+PackedVertex PackVertex(const Vertex &vertex);
+
+/**
+ * Compress an array of vertices
+ *
+ * @param vertices      vertices to compress
+ * @param num_vertices  number of vertices
+ * @param packed        receives the packed vertices
+ */
+void PackVertices(const Vertex *vertices, GLuint num_vertices,
+                  std::vector<PackedVertex> *packed);
+
+} // namespace oncgl
+
+#endif // ONCGL_MODEL_VERTEX_PACKING_H
@@ -1,19 +1,139 @@
 #include "renderer/renderer.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace oncgl {
 
+const size_t DeferredRenderer::kMaxStencilVolumes;
+
+namespace {
+
+// width of the occlusion buffer in pixels, the height follows the window
+const int kOcclusionBufferWidth = 320;
+
+// texture unit of the point light buffer, after the G-buffer and the
+// material textures and below the units of the scene
+const GLint kLightBufferTextureUnit = 13;
+
+// texture units of the cluster lists of the tiled light pass
+const GLint kLightClusterTextureUnit = 11;
+const GLint kLightIndexTextureUnit = 12;
+
+// texture unit of the lights of the instanced light volumes
+const GLint kLightSelectionTextureUnit = 10;
+
+/**
+ * Bound a world space sphere in front of the camera on the screen
+ * The rectangle bounds the view space box of the sphere, the part in front of
+ * the near plane, like the tiles of TiledLightCuller.
+ *
+ * @param sphere      center and radius
+ * @param view        view matrix of the camera
+ * @param projection  symmetric perspective projection of the camera
+ * @param width       width of the screen in pixels
+ * @param height      height of the screen in pixels
+ * @param rect        receives min x, min y, max x and max y in pixels, the
+ *                    max exclusive
+ * @returns false - if the sphere is behind the near plane or off screen
+ */
+bool ProjectSphereRect(const glm::vec4 &sphere, const glm::mat4 &view,
+                       const glm::mat4 &projection, int width, int height,
+                       int rect[ 4 ]) {
+
+  glm::vec3 center(view * glm::vec4(glm::vec3(sphere), 1.0f));
+  float radius = sphere.w;
+  float near_plane = projection[ 3 ][ 2 ] / (projection[ 2 ][ 2 ] - 1.0f);
+
+  // distances along the view direction
+  float far_distance = radius - center.z;
+  if (far_distance < near_plane) {
+    return false;
+  }
+  float inverse_near = 1.0f / std::max(-center.z - radius, near_plane);
+  float inverse_far = 1.0f / far_distance;
+
+  // an edge left of the view axis is farthest out when nearest, one right of
+  // it when farthest
+  float min_x = center.x - radius;
+  float max_x = center.x + radius;
+  float min_y = center.y - radius;
+  float max_y = center.y + radius;
+  float ndc[ 4 ] = {
+      projection[ 0 ][ 0 ] * min_x * (min_x < 0.0f ? inverse_near
+                                                   : inverse_far),
+      projection[ 1 ][ 1 ] * min_y * (min_y < 0.0f ? inverse_near
+                                                   : inverse_far),
+      projection[ 0 ][ 0 ] * max_x * (max_x > 0.0f ? inverse_near
+                                                   : inverse_far),
+      projection[ 1 ][ 1 ] * max_y * (max_y > 0.0f ? inverse_near
+                                                   : inverse_far)
+  };
+  const int size[ 2 ] = { width, height };
+  for (int i = 0; i < 4; ++i) {
+    float pixel = (std::min(std::max(ndc[ i ], -1.0f), 1.0f) * 0.5f + 0.5f) *
+        size[ i % 2 ];
+    rect[ i ] = static_cast<int>(i < 2 ? std::floor(pixel)
+                                       : std::ceil(pixel));
+  }
+  return rect[ 0 ] < rect[ 2 ] && rect[ 1 ] < rect[ 3 ];
+}
+
+// grow the rectangle a to also cover b
+void UniteRects(int a[ 4 ], const int b[ 4 ]) {
+
+  a[ 0 ] = std::min(a[ 0 ], b[ 0 ]);
+  a[ 1 ] = std::min(a[ 1 ], b[ 1 ]);
+  a[ 2 ] = std::max(a[ 2 ], b[ 2 ]);
+  a[ 3 ] = std::max(a[ 3 ], b[ 3 ]);
+}
+
+} // namespace
+
 DeferredRenderer::DeferredRenderer(float window_width, float window_height) :
-    Renderer(window_width, window_height) {
+    Renderer(window_width, window_height),
+    frame_constant_buffer_(kFrameConstantsBinding, sizeof(FrameConstants)),
+    tiled_lights_(static_cast<int>(window_width),
+                  static_cast<int>(window_height)),
+    empty_vertex_array_(0),
+    output_framebuffer_(0),
+    frustum_culling_(true),
+    occlusion_culling_(true),
+    occlusion_buffer_(kOcclusionBufferWidth,
+                      static_cast<int>(kOcclusionBufferWidth * window_height
+                                       / window_width)) {
+
+  // import the light volumes while the shaders compile
+  ModelLoader loader;
+  loader.Add(RESOURCE_DIRS_PREFIX + "../objects/shadingObjects/pointLight.obj");
+  loader.Add(
+      RESOURCE_DIRS_PREFIX + "../objects/shadingObjects/dirLight_quad.obj");
 
   std::cout << "compile geometry-shaders" << std::endl;
-  geometryShaderProgram_ = LoadShaders(
+  geometryShaderPrograms_[ VERTEX_FORMAT_FLOAT ] = LoadShaders(
       RESOURCE_DIRS_PREFIX + "../shaders/geometry/geometry_pass.vert",
       RESOURCE_DIRS_PREFIX + "../shaders/geometry/geometry_pass.frag");
+  geometryShaderPrograms_[ VERTEX_FORMAT_PACKED ] = LoadShaders(
+      RESOURCE_DIRS_PREFIX + "../shaders/geometry/geometry_pass.vert",
+      RESOURCE_DIRS_PREFIX + "../shaders/geometry/geometry_pass.frag",
+      "#define PACKED_VERTICES\n");
 
   std::cout << "compile pointlight-shaders" << std::endl;
   pointLightShaderProgram_ = LoadShaders(
       RESOURCE_DIRS_PREFIX + "../shaders/light/light_pass.vert",
-      RESOURCE_DIRS_PREFIX + "../shaders/light/pointlight_pass.frag");
+      RESOURCE_DIRS_PREFIX + "../shaders/light/pointlight_pass.frag",
+      "#define POINT_LIGHT\n");
+
+  std::cout << "compile tiled pointlight-shaders" << std::endl;
+  tiledLightShaderProgram_ = LoadShaders(
+      RESOURCE_DIRS_PREFIX + "../shaders/light/light_pass.vert",
+      RESOURCE_DIRS_PREFIX + "../shaders/light/pointlight_pass.frag",
+      "#define TILED_LIGHTS\n"
+      "#define LIGHT_TILE_SIZE " +
+      std::to_string(TiledLightCuller::kTileSize) + "\n"
+      "#define LIGHT_TILES_X " + std::to_string(tiled_lights_.tiles_x()) + "\n"
+      "#define LIGHT_DEPTH_SLICES " +
+      std::to_string(tiled_lights_.depth_slices()) + "\n");
 
   std::cout << "compile dirlight-shaders" << std::endl;
   directionalLightShaderProgram_ = LoadShaders(
@@ -27,10 +147,71 @@ DeferredRenderer::DeferredRenderer(float window_width, float window_height) :
 
   std::cout << K_GREEN << "compiled all shaders" << K_RESET << std::endl;
 
-  pointLightModel_ = new Model(
-      RESOURCE_DIRS_PREFIX + "../objects/shadingObjects/pointLight.obj");
-  directionalLightModel_ = new Model(
-      RESOURCE_DIRS_PREFIX + "../objects/shadingObjects/dirLight_quad.obj");
+  // everything that stays the same for the lifetime of the programs is set
+  // once here, the rest comes from the FrameConstants block
+  Program *programs[] = {
+      geometryShaderPrograms_[ VERTEX_FORMAT_FLOAT ],
+      geometryShaderPrograms_[ VERTEX_FORMAT_PACKED ],
+      pointLightShaderProgram_, directionalLightShaderProgram_,
+      stencilShaderProgram_, tiledLightShaderProgram_
+  };
+  for (size_t i = 0; i < sizeof(programs) / sizeof(programs[ 0 ]); i++) {
+    programs[ i ]->BindUniformBlock("FrameConstants", kFrameConstantsBinding);
+  }
+
+  // the material textures have fixed units
+  for (int i = 0; i < NUM_VERTEX_FORMATS; i++) {
+    geometryShaderPrograms_[ i ]->Use();
+    Material::SetupProgram(geometryShaderPrograms_[ i ]);
+    geometryShaderPrograms_[ i ]->StopUsing();
+  }
+
+  Program *light_programs[] = {
+      pointLightShaderProgram_, directionalLightShaderProgram_,
+      tiledLightShaderProgram_
+  };
+  for (size_t i = 0; i < 3; i++) {
+    Program *program = light_programs[ i ];
+    program->Use();
+    program->setUniform("gPositionMap",
+                        FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_POSITION);
+    program->setUniform("gColorMap",
+                        FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_DIFFUSE);
+    program->setUniform("gNormalMap",
+                        FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_NORMAL);
+    program->StopUsing();
+  }
+
+  Program *volume_programs[] = {
+      pointLightShaderProgram_, stencilShaderProgram_
+  };
+  for (size_t i = 0; i < 2; i++) {
+    volume_programs[ i ]->Use();
+    volume_programs[ i ]->setUniform("pointLights", kLightBufferTextureUnit);
+    volume_programs[ i ]->setUniform("lightSelection",
+                                     kLightSelectionTextureUnit);
+    volume_programs[ i ]->StopUsing();
+  }
+  tiledLightShaderProgram_->Use();
+  tiledLightShaderProgram_->setUniform("pointLights", kLightBufferTextureUnit);
+  tiledLightShaderProgram_->setUniform("lightClusters",
+                                      kLightClusterTextureUnit);
+  tiledLightShaderProgram_->setUniform("lightIndices", kLightIndexTextureUnit);
+  tiledLightShaderProgram_->StopUsing();
+  glGenVertexArrays(1, &empty_vertex_array_);
+
+  // the quad of the directional light covers the screen from every view
+  directionalLightShaderProgram_->Use();
+  directionalLightShaderProgram_->setUniform(
+      "model",
+      glm::scale(glm::mat4(1.0f), glm::vec3(100.0f, 100.0f, 100.0f)) *
+      glm::rotate(glm::mat4(1.0f), glm::radians<float>(90.0),
+                  glm::vec3(1.0f, 0.0f, 0.0f)));
+  directionalLightShaderProgram_->StopUsing();
+
+  std::vector<Model> light_models = loader.Finish();
+  pointLightModel_ = new Model(light_models[ 0 ]);
+  directionalLightModel_ = new Model(light_models[ 1 ]);
 
   frameBufferObject_ = new FrameBuffer();
   if(!frameBufferObject_->Init(window_width, window_height)) {
@@ -44,171 +225,369 @@ void DeferredRenderer::Init(int window_width, int window_height) {
   frameBufferObject_->StartFrame();
 }
 
-void DeferredRenderer::RenderGeometryPass(std::vector<Model> models,
-                                          Camera camera) {
+void DeferredRenderer::BeginFrame(const Camera &camera,
+                                  const DirectionalLight &directional_light) {
+
+  gpu_timer_.BeginFrame();
+
+  // the camera matrices are computed once per frame instead of per pass
+  frame_constants_.view = camera.view();
+  frame_constants_.projection = camera.projection();
+  frame_constants_.view_projection =
+      frame_constants_.projection * frame_constants_.view;
+  frame_constants_.eye_position = glm::vec4(camera.position(), 1.0f);
+  frame_constants_.screen_size =
+      glm::vec4(window_width_, window_height_, 0.0f, 0.0f);
+  frame_constants_.dir_light_direction =
+      glm::vec4(directional_light.direction,
+                directional_light.ambient_intensity);
+  frame_constants_.dir_light_color =
+      glm::vec4(directional_light.color, directional_light.diffuse_intensity);
+
+  frame_constant_buffer_.Update(&frame_constants_);
+}
 
-  geometryShaderProgram_->Use();
+void DeferredRenderer::set_point_lights(
+    const std::vector<PointLight> &point_lights) {
+  // nothing to upload if no light changed
+  if (!light_culler_.set_lights(point_lights)) {
+    return;
+  }
+  light_buffer_.Upload(point_lights, light_culler_.spheres());
+  tiled_lights_.set_spheres(light_culler_.spheres());
+}
+
+void DeferredRenderer::CullPointLights(std::vector<uint32_t> *visible) {
+
+  light_culler_.Cull(frame_constants_.view_projection,
+                     frame_constants_.projection, window_height_,
+                     frustum_culling_ && occlusion_culling_ ?
+                         &occlusion_buffer_ : NULL,
+                     visible);
+}
+
+void DeferredRenderer::RenderGeometryPass(Scene *scene, Camera camera) {
+
+  GLState &state = GLState::Instance();
+
+  // culling runs on the CPU before the pass is timed, the GPU idles meanwhile
+  scene->Update();
+  Frustum frustum = Frustum::FromMatrix(frame_constants_.view_projection);
+  if (frustum_culling_ && occlusion_culling_) {
+    occlusion_buffer_.Begin(frame_constants_.view_projection);
+    scene->Cull(&frustum, &occlusion_buffer_);
+  } else {
+    scene->Cull(frustum_culling_ ? &frustum : NULL);
+  }
+
+  gpu_timer_.Begin(GPU_TIMER_GEOMETRY);
 
   frameBufferObject_->BindForGeometryPass();
 
   // Only the geometry pass updates the depth buffer
-  glDepthMask(GL_TRUE);
+  state.DepthMask(GL_TRUE);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glEnable(GL_DEPTH_TEST);
-
-  geometryShaderProgram_->setUniform("projection", camera.projection());
-  geometryShaderProgram_->setUniform("view", camera.view());
-  geometryShaderProgram_->setUniform("model", glm::mat4(1.0f));
-
-  for (GLuint i = 0; i < models.size(); i++) {
-    models[ i ].Draw(geometryShaderProgram_);
+  state.Enable(GL_DEPTH_TEST);
+
+  // per-frame uniforms, set once per program instead of once per draw
+  for (int i = 0; i < NUM_VERTEX_FORMATS; i++) {
+    VertexFormat format = (VertexFormat) i;
+    if (!scene->HasInstances(format)) {
+      continue;
+    }
+
+    Program *program = geometryShaderPrograms_[ format ];
+    program->Use();
+    scene->BindTransforms(program);
+    program->StopUsing();
   }
 
-  geometryShaderProgram_->StopUsing();
+  // one packet per mesh and asset, drawn sorted by state
+  scene->Enqueue(&geometryQueue_, RENDER_PASS_GEOMETRY,
+                 geometryShaderPrograms_, camera.position(),
+                 camera.far_plane());
+  geometryQueue_.Submit();
+  scene->UnbindTransforms();
 
   // When we get here the depth buffer is already populated and the stencil pass
   // depends on it, but it does not write to it.
-  glDepthMask(GL_FALSE);
+  state.DepthMask(GL_FALSE);
+
+  gpu_timer_.End();
 }
 
-void DeferredRenderer::RenderStencilPass(PointLight point_light,
-                                         Camera camera) {
+void DeferredRenderer::RenderStencilPass(
+    const std::vector<uint32_t> &light_indices) {
+
+  GLState &state = GLState::Instance();
+
+  light_buffer_.Select(light_indices);
 
+  gpu_timer_.Begin(GPU_TIMER_STENCIL);
   stencilShaderProgram_->Use();
 
   frameBufferObject_->BindForStencilPass();
 
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_CULL_FACE);
+  state.Enable(GL_DEPTH_TEST);
+  state.Disable(GL_CULL_FACE);
+  // one clear for all volumes, each adds one where it holds the geometry;
+  // the count of a pixel ends in [0, kMaxStencilVolumes], so the wrapping
+  // operations below only wrap in between
   glClear(GL_STENCIL_BUFFER_BIT);
 
   // We need the stencil test to be enabled but we want it
   // to succeed always. Only the depth test matters.
-  glStencilFunc(GL_ALWAYS, 0, 0);
+  state.StencilFunc(GL_ALWAYS, 0, 0);
 
-  glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
-  glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+  state.StencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+  state.StencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
 
-  glm::mat4 model =
-      glm::translate(glm::mat4(1.0f), point_light.position) *
-      glm::scale(glm::mat4(1.0f), glm::vec3(point_light.CalcBoundingSphere())) *
-      glm::mat4(1.0f);
-
-  stencilShaderProgram_->setUniform("model", model);
-  stencilShaderProgram_->setUniform("projection", camera.projection());
-  stencilShaderProgram_->setUniform("view", camera.view());
-
-  pointLightModel_->Draw(stencilShaderProgram_);
+  if (!light_indices.empty()) {
+    light_buffer_.Bind(kLightBufferTextureUnit);
+    light_buffer_.BindSelection(kLightSelectionTextureUnit);
+    pointLightModel_->DrawInstanced(stencilShaderProgram_,
+                                    light_indices.size());
+  }
 
   stencilShaderProgram_->StopUsing();
+  gpu_timer_.End();
 }
 
-void DeferredRenderer::RenderPointLightPass(PointLight point_light,
-                                            Camera camera) {
+void DeferredRenderer::RenderPointLightPass() {
 
+  GLState &state = GLState::Instance();
+
+  gpu_timer_.Begin(GPU_TIMER_POINT_LIGHT);
   pointLightShaderProgram_->Use();
 
   frameBufferObject_->BindForLightPass();
 
-  glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+  state.StencilFunc(GL_NOTEQUAL, 0, 0xFF);
 
-  glDisable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendEquation(GL_FUNC_ADD);
-  glBlendFunc(GL_ONE, GL_ONE);
+  state.Disable(GL_DEPTH_TEST);
+  state.Enable(GL_BLEND);
+  state.BlendEquation(GL_FUNC_ADD);
+  state.BlendFunc(GL_ONE, GL_ONE);
 
-  glEnable(GL_CULL_FACE);
-  glCullFace(GL_FRONT);
+  state.Enable(GL_CULL_FACE);
+  state.CullFace(GL_FRONT);
 
-  pointLightShaderProgram_->setUniform("screenSize",
-                                       glm::vec3(window_width_, window_height_,
-                                                 0.0f));
+  if (light_buffer_.num_selected() > 0) {
+    pointLightShaderProgram_->setUniform("lightSelectionOffset", 0);
+    light_buffer_.Bind(kLightBufferTextureUnit);
+    light_buffer_.BindSelection(kLightSelectionTextureUnit);
+    pointLightModel_->DrawInstanced(pointLightShaderProgram_,
+                                    light_buffer_.num_selected());
+    light_buffer_.UnbindSelection(kLightSelectionTextureUnit);
+    light_buffer_.Unbind(kLightBufferTextureUnit);
+  }
 
-  pointLightShaderProgram_->setUniform("projection", camera.projection());
-  pointLightShaderProgram_->setUniform("view", camera.view());
+  state.CullFace(GL_BACK);
+  state.Disable(GL_BLEND);
 
-  glm::mat4 model =
-      glm::translate(glm::mat4(1.0f), point_light.position) *
-      glm::scale(glm::mat4(1.0f), glm::vec3(point_light.CalcBoundingSphere())) *
-      glm::mat4(1.0f);
+  pointLightShaderProgram_->StopUsing();
+  gpu_timer_.End();
+}
 
-  pointLightShaderProgram_->setUniform("model", model);
+void DeferredRenderer::RenderLightVolumePass(
+    const std::vector<uint32_t> &light_indices) {
+
+  GLState &state = GLState::Instance();
+
+  // lights the camera is outside of first, then the ones around it, drawn
+  // with one instanced call each
+  const std::vector<glm::vec4> &spheres = light_culler_.spheres();
+  const glm::vec3 eye(frame_constants_.eye_position);
+  const int width = static_cast<int>(window_width_);
+  const int height = static_cast<int>(window_height_);
+  std::vector<uint32_t> around;
+  std::vector<uint32_t> selection;
+  selection.reserve(light_indices.size());
+  int outside_rect[ 4 ] = { width, height, 0, 0 };
+  for (size_t i = 0; i < light_indices.size(); ++i) {
+    const glm::vec4 &sphere = spheres[ light_indices[ i ]];
+    glm::vec3 offset = glm::vec3(sphere) - eye;
+    if (glm::dot(offset, offset) <= sphere.w * sphere.w) {
+      around.push_back(light_indices[ i ]);
+      continue;
+    }
+    int rect[ 4 ];
+    if (ProjectSphereRect(sphere, frame_constants_.view,
+                          frame_constants_.projection, width, height, rect)) {
+      selection.push_back(light_indices[ i ]);
+      UniteRects(outside_rect, rect);
+    }
+  }
+  const GLsizei num_outside = selection.size();
+  selection.insert(selection.end(), around.begin(), around.end());
+  if (selection.empty()) {
+    return;
+  }
+  light_buffer_.Select(selection);
 
-  pointLightShaderProgram_->setUniform("pointLight", point_light);
-  pointLightShaderProgram_->setUniform("eyePos", camera.position());
+  gpu_timer_.Begin(GPU_TIMER_POINT_LIGHT);
+  pointLightShaderProgram_->Use();
 
-  pointLightShaderProgram_
-      ->setUniform("gPositionMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_POSITION);
-  pointLightShaderProgram_
-      ->setUniform("gColorMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_DIFFUSE);
-  pointLightShaderProgram_
-      ->setUniform("gNormalMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_NORMAL);
-  pointLightModel_->Draw(pointLightShaderProgram_);
+  frameBufferObject_->BindForLightPass();
 
-  glCullFace(GL_BACK);
-  glDisable(GL_BLEND);
+  state.Enable(GL_BLEND);
+  state.BlendEquation(GL_FUNC_ADD);
+  state.BlendFunc(GL_ONE, GL_ONE);
+
+  // only the back faces, clamped instead of clipped by the far plane
+  state.Enable(GL_CULL_FACE);
+  state.CullFace(GL_FRONT);
+  state.Enable(GL_DEPTH_CLAMP);
+  state.Enable(GL_SCISSOR_TEST);
+
+  light_buffer_.Bind(kLightBufferTextureUnit);
+  light_buffer_.BindSelection(kLightSelectionTextureUnit);
+
+  if (num_outside > 0) {
+    // a back face behind the geometry means the geometry may be inside, the
+    // shader rejects the geometry in front of the volume
+    state.Enable(GL_DEPTH_TEST);
+    state.DepthFunc(GL_GREATER);
+    // the back faces of a light never leave its rectangle, only the union
+    // of all of them can cut off fragments
+    state.Scissor(outside_rect[ 0 ], outside_rect[ 1 ],
+                  outside_rect[ 2 ] - outside_rect[ 0 ],
+                  outside_rect[ 3 ] - outside_rect[ 1 ]);
+    pointLightShaderProgram_->setUniform("lightSelectionOffset", 0);
+    pointLightModel_->DrawInstanced(pointLightShaderProgram_, num_outside);
+  }
+  if (!around.empty()) {
+    // the camera is inside, the back faces cover the whole screen
+    state.Disable(GL_DEPTH_TEST);
+    state.Scissor(0, 0, width, height);
+    pointLightShaderProgram_->setUniform("lightSelectionOffset",
+                                         num_outside);
+    pointLightModel_->DrawInstanced(pointLightShaderProgram_, around.size());
+  }
+
+  light_buffer_.UnbindSelection(kLightSelectionTextureUnit);
+  light_buffer_.Unbind(kLightBufferTextureUnit);
+  state.DepthFunc(GL_LESS);
+  state.Disable(GL_SCISSOR_TEST);
+  state.Disable(GL_DEPTH_CLAMP);
+  state.CullFace(GL_BACK);
+  state.Disable(GL_BLEND);
 
   pointLightShaderProgram_->StopUsing();
+  gpu_timer_.End();
 }
 
-void DeferredRenderer::RenderDirectionalLightPass(
-    DirectionalLight directional_light, Camera camera) {
+void DeferredRenderer::RenderTiledLightPass(
+    const std::vector<uint32_t> &light_indices) {
 
-  directionalLightShaderProgram_->Use();
+  GLState &state = GLState::Instance();
+
+  tiled_lights_.Cull(light_indices, frame_constants_.view,
+                     frame_constants_.projection,
+                     frustum_culling_ && occlusion_culling_ ?
+                         &occlusion_buffer_ : NULL);
+  tiled_lights_.Upload();
+
+  gpu_timer_.Begin(GPU_TIMER_POINT_LIGHT);
+  tiledLightShaderProgram_->Use();
+  glm::vec2 slice_scale_bias = tiled_lights_.slice_scale_bias();
+  tiledLightShaderProgram_->setUniform("lightSliceScaleBias",
+                                       slice_scale_bias.x, slice_scale_bias.y);
 
   frameBufferObject_->BindForLightPass();
 
-  glDisable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendEquation(GL_FUNC_ADD);
-  glBlendFunc(GL_ONE, GL_ONE);
+  state.Disable(GL_DEPTH_TEST);
+  state.Enable(GL_BLEND);
+  state.BlendEquation(GL_FUNC_ADD);
+  state.BlendFunc(GL_ONE, GL_ONE);
 
-  directionalLightShaderProgram_->setUniform("screenSize",
-                                             glm::vec3(window_width_,
-                                                       window_height_, 0.0f));
+  light_buffer_.Bind(kLightBufferTextureUnit);
+  tiled_lights_.Bind(kLightClusterTextureUnit, kLightIndexTextureUnit);
+  state.BindVertexArray(empty_vertex_array_);
 
-  directionalLightShaderProgram_->setUniform("projection", camera.projection());
-  directionalLightShaderProgram_->setUniform("view", camera.view());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
 
+  state.BindVertexArray(0);
+  tiled_lights_.Unbind(kLightClusterTextureUnit, kLightIndexTextureUnit);
+  light_buffer_.Unbind(kLightBufferTextureUnit);
+  state.Disable(GL_BLEND);
 
-  glm::mat4 model =
-      glm::scale(glm::mat4(1.0f), glm::vec3(100.0f, 100.0f, 100.0f)) *
-      glm::rotate(glm::mat4(1.0f), glm::radians<float>(90.0),
-                  glm::vec3(1.0f, 0.0f, 0.0f)) *
-      glm::mat4(1.0);
+  tiledLightShaderProgram_->StopUsing();
+  gpu_timer_.End();
+}
 
-  directionalLightShaderProgram_->setUniform("model", model);
+void DeferredRenderer::RenderDirectionalLightPass() {
 
-  directionalLightShaderProgram_->setUniform("dirLight", directional_light);
-  directionalLightShaderProgram_->setUniform("eyePos", camera.position());
-  directionalLightShaderProgram_
-      ->setUniform("gPositionMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_POSITION);
-  directionalLightShaderProgram_
-      ->setUniform("gColorMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_DIFFUSE);
-  directionalLightShaderProgram_
-      ->setUniform("gNormalMap", FrameBuffer::FRAMEBUFFER_TEXTURE_TYPE_NORMAL);
+  GLState &state = GLState::Instance();
+
+  gpu_timer_.Begin(GPU_TIMER_DIRECTIONAL_LIGHT);
+  directionalLightShaderProgram_->Use();
+
+  frameBufferObject_->BindForLightPass();
+
+  state.Disable(GL_DEPTH_TEST);
+  state.Enable(GL_BLEND);
+  state.BlendEquation(GL_FUNC_ADD);
+  state.BlendFunc(GL_ONE, GL_ONE);
 
   directionalLightModel_->Draw(directionalLightShaderProgram_);
 
-  glDisable(GL_BLEND);
+  state.Disable(GL_BLEND);
 
   directionalLightShaderProgram_->StopUsing();
+  gpu_timer_.End();
 }
 
 void DeferredRenderer::RenderFinalPass() {
 
-  frameBufferObject_->BindForFinalPass();
+  gpu_timer_.Begin(GPU_TIMER_FINAL);
+  frameBufferObject_->BindForFinalPass(output_framebuffer_);
   glBlitFramebuffer(0, 0, window_width_, window_height_,
                     0, 0, window_width_, window_height_,
                     GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  gpu_timer_.End();
+}
+
+void DeferredRenderer::set_output_framebuffer(GLuint framebuffer) {
+  output_framebuffer_ = framebuffer;
+}
+
+void DeferredRenderer::set_frustum_culling(bool enabled) {
+  frustum_culling_ = enabled;
+}
+
+void DeferredRenderer::set_occlusion_culling(bool enabled) {
+  occlusion_culling_ = enabled;
+}
+
+const OcclusionBuffer &DeferredRenderer::occlusion_buffer() const {
+  return occlusion_buffer_;
+}
+
+const RenderQueue::Stats &DeferredRenderer::geometry_stats() const {
+  return geometryQueue_.stats();
+}
+
+GpuTimer *DeferredRenderer::gpu_timer() {
+  return &gpu_timer_;
+}
+
+LightCuller *DeferredRenderer::light_culler() {
+  return &light_culler_;
+}
+
+const TiledLightCuller &DeferredRenderer::tiled_lights() const {
+  return tiled_lights_;
 }
 
 Program *Renderer::LoadShaders(std::string vertex_shader,
-                               std::string fragment_shader) {
+                               std::string fragment_shader,
+                               std::string defines) {
   std::vector<Shader> shaders;
-  shaders.push_back(Shader::ShaderFromFile(vertex_shader, GL_VERTEX_SHADER));
-  shaders
-      .push_back(Shader::ShaderFromFile(fragment_shader, GL_FRAGMENT_SHADER));
+  shaders.push_back(Shader::ShaderFromFile(vertex_shader, GL_VERTEX_SHADER,
+                                           defines));
+  shaders.push_back(Shader::ShaderFromFile(fragment_shader, GL_FRAGMENT_SHADER,
+                                           defines));
   return new Program(shaders);
 }
 
@@ -37,7 +37,7 @@ FontRenderer::FontRenderer(std::string font_path, unsigned int font_size,
     // Generate texture
     GLuint texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
@@ -82,7 +82,7 @@ void FontRenderer::Init(float width, float height) {
   glGenVertexArrays(1, &VAO_);
   glGenBuffers(1, &VBO_);
 
-  glBindVertexArray(VAO_);
+  GLState::Instance().BindVertexArray(VAO_);
   glBindBuffer(GL_ARRAY_BUFFER, VBO_);
 
   glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
@@ -91,24 +91,24 @@ void FontRenderer::Init(float width, float height) {
   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
 
   glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  GLState::Instance().BindVertexArray(0);
 }
 
 void FontRenderer::RenderText(std::string text, GLfloat x, GLfloat y,
                               GLfloat scale, glm::vec3 color) {
 
-  bool isCullEnabled = glIsEnabled(GL_CULL_FACE);
+  bool isCullEnabled = GLState::Instance().IsEnabled(GL_CULL_FACE);
 
-  glDisable(GL_CULL_FACE);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GLState::Instance().Disable(GL_CULL_FACE);
+  GLState::Instance().Enable(GL_BLEND);
+  GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   fontShaderProgram_->Use();
   fontShaderProgram_->setUniform("textColor", color);
   fontShaderProgram_->setUniform("projection", projection_);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindVertexArray(VAO_);
+  GLState::Instance().ActiveTexture(0);
+  GLState::Instance().BindVertexArray(VAO_);
 
   // Iterate through all characters
   std::string::const_iterator c;
@@ -132,7 +132,7 @@ void FontRenderer::RenderText(std::string text, GLfloat x, GLfloat y,
       { xpos + w, ypos + h, 1.0, 0.0 }
     };
     // Render glyph texture over quad
-    glBindTexture(GL_TEXTURE_2D, ch.texture_id);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D, ch.texture_id);
     // Update content of VBO memory
     glBindBuffer(GL_ARRAY_BUFFER, VBO_);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
@@ -145,12 +145,12 @@ void FontRenderer::RenderText(std::string text, GLfloat x, GLfloat y,
     x += (ch.advance >> 6) *
         scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
   }
-  glBindVertexArray(0);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  GLState::Instance().BindVertexArray(0);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
 
   if (isCullEnabled) {
-    glEnable(GL_CULL_FACE);
+    GLState::Instance().Enable(GL_CULL_FACE);
   }
 
-  glDisable(GL_BLEND);
+  GLState::Instance().Disable(GL_BLEND);
 }
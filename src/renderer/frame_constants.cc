@@ -0,0 +1,37 @@
+#include "renderer/frame_constants.h"
+
+namespace oncgl {
+
+UniformBuffer::UniformBuffer(GLuint binding, GLsizeiptr size) :
+    buffer_(0),
+    binding_(binding),
+    size_(size) {
+
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, size_, NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+}
+
+UniformBuffer::~UniformBuffer() {
+
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+  }
+}
+
+void UniformBuffer::Update(const void *data) {
+
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, size_, NULL, GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, size_, data);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+}
+
+GLuint UniformBuffer::binding() const {
+  return binding_;
+}
+
+} // namespace oncgl
@@ -0,0 +1,71 @@
+#ifndef ONCGL_RENDERER_FRAME_CONSTANTS_H
+#define ONCGL_RENDERER_FRAME_CONSTANTS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace oncgl {
+
+/**
+ * Values shared by all passes of a frame
+ * Mirrors the std140 uniform block FrameConstants of the shaders, so every
+ * member is a vec4 or a mat4 and no padding is needed.
+ */
+struct FrameConstants {
+
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 view_projection;
+  // xyz, w unused
+  glm::vec4 eye_position;
+  // width and height of the framebuffer in pixels, zw unused
+  glm::vec4 screen_size;
+  // the directional light: xyz direction, w ambient intensity
+  glm::vec4 dir_light_direction;
+  // rgb color, w diffuse intensity
+  glm::vec4 dir_light_color;
+};
+
+static_assert(sizeof(FrameConstants) == 3 * 64 + 4 * 16,
+              "FrameConstants must match the std140 layout");
+
+// binding point of the FrameConstants block in every program
+const GLuint kFrameConstantsBinding = 0;
+
+/**
+ * Uniform buffer object holding one block of data
+ */
+class UniformBuffer {
+ public:
+  /**
+   * @param binding   uniform block binding point the buffer is bound to
+   * @param size      size of the block in bytes
+   */
+  UniformBuffer(GLuint binding, GLsizeiptr size);
+
+  ~UniformBuffer();
+
+  /**
+   * Replace the content of the buffer and bind it to its binding point
+   * The old storage is orphaned, so draws still reading it do not stall.
+   *
+   * @param data  new content, size bytes as given to the constructor
+   */
+  void Update(const void *data);
+
+  GLuint binding() const;
+
+ private:
+  GLuint buffer_;
+  GLuint binding_;
+  GLsizeiptr size_;
+
+  //copying disabled
+  UniformBuffer(const UniformBuffer &);
+
+  const UniformBuffer &operator=(const UniformBuffer &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_RENDERER_FRAME_CONSTANTS_H
@@ -0,0 +1,402 @@
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+const GLint GLState::kMaxTextureUnits;
+
+namespace {
+
+// no GL name or enum has this value, the state is not known
+const GLuint kUnknown = 0xffffffffu;
+
+} // namespace
+
+GLState::GLState() {
+
+  stats_.issued = 0;
+  stats_.elided = 0;
+  Invalidate();
+}
+
+GLState &GLState::Instance() {
+
+  static GLState state;
+  return state;
+}
+
+bool GLState::Changes(bool differs) {
+
+  if (differs) {
+    stats_.issued++;
+  } else {
+    stats_.elided++;
+  }
+  return differs;
+}
+
+int GLState::CapabilityIndex(GLenum capability) {
+
+  switch (capability) {
+    case GL_DEPTH_TEST:
+      return CAPABILITY_DEPTH_TEST;
+    case GL_BLEND:
+      return CAPABILITY_BLEND;
+    case GL_CULL_FACE:
+      return CAPABILITY_CULL_FACE;
+    case GL_STENCIL_TEST:
+      return CAPABILITY_STENCIL_TEST;
+    case GL_SCISSOR_TEST:
+      return CAPABILITY_SCISSOR_TEST;
+    case GL_DEPTH_CLAMP:
+      return CAPABILITY_DEPTH_CLAMP;
+    default:
+      return -1;
+  }
+}
+
+int GLState::TextureTargetIndex(GLenum target) {
+
+  switch (target) {
+    case GL_TEXTURE_2D:
+      return TEXTURE_TARGET_2D;
+    case GL_TEXTURE_BUFFER:
+      return TEXTURE_TARGET_BUFFER;
+    default:
+      return -1;
+  }
+}
+
+void GLState::SetCapability(GLenum capability, bool enabled) {
+
+  int index = CapabilityIndex(capability);
+  if (index != -1) {
+    if (!Changes(capabilities_[ index ] != (enabled ? 1 : 0))) {
+      return;
+    }
+    capabilities_[ index ] = enabled ? 1 : 0;
+  } else {
+    stats_.issued++;
+  }
+
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void GLState::Enable(GLenum capability) {
+  SetCapability(capability, true);
+}
+
+void GLState::Disable(GLenum capability) {
+  SetCapability(capability, false);
+}
+
+bool GLState::IsEnabled(GLenum capability) const {
+
+  int index = CapabilityIndex(capability);
+  if (index != -1 && capabilities_[ index ] != -1) {
+    return capabilities_[ index ] == 1;
+  }
+  return glIsEnabled(capability) == GL_TRUE;
+}
+
+void GLState::DepthMask(GLboolean enabled) {
+
+  int value = enabled ? 1 : 0;
+  if (Changes(depth_mask_ != value)) {
+    depth_mask_ = value;
+    glDepthMask(enabled);
+  }
+}
+
+void GLState::DepthFunc(GLenum function) {
+
+  if (Changes(depth_function_ != function)) {
+    depth_function_ = function;
+    glDepthFunc(function);
+  }
+}
+
+void GLState::BlendEquation(GLenum mode) {
+
+  if (Changes(blend_equation_ != mode)) {
+    blend_equation_ = mode;
+    glBlendEquation(mode);
+  }
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination) {
+
+  if (Changes(blend_source_ != source ||
+              blend_destination_ != destination)) {
+    blend_source_ = source;
+    blend_destination_ = destination;
+    glBlendFunc(source, destination);
+  }
+}
+
+void GLState::CullFace(GLenum face) {
+
+  if (Changes(cull_face_ != face)) {
+    cull_face_ = face;
+    glCullFace(face);
+  }
+}
+
+void GLState::Scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+
+  if (Changes(scissor_[ 0 ] != x || scissor_[ 1 ] != y ||
+              scissor_[ 2 ] != width || scissor_[ 3 ] != height)) {
+    scissor_[ 0 ] = x;
+    scissor_[ 1 ] = y;
+    scissor_[ 2 ] = width;
+    scissor_[ 3 ] = height;
+    glScissor(x, y, width, height);
+  }
+}
+
+void GLState::StencilFunc(GLenum function, GLint reference, GLuint mask) {
+
+  if (Changes(stencil_function_ != function ||
+              stencil_reference_ != reference || stencil_mask_ != mask)) {
+    stencil_function_ = function;
+    stencil_reference_ = reference;
+    stencil_mask_ = mask;
+    glStencilFunc(function, reference, mask);
+  }
+}
+
+void GLState::StencilOpSeparate(GLenum face, GLenum stencil_fail,
+                                GLenum depth_fail, GLenum depth_pass) {
+
+  bool differs = false;
+  for (int i = 0; i < 2; i++) {
+    if ((i == 0 && face == GL_BACK) || (i == 1 && face == GL_FRONT)) {
+      continue;
+    }
+    const StencilOp &op = stencil_ops_[ i ];
+    differs = differs || op.stencil_fail != stencil_fail ||
+        op.depth_fail != depth_fail || op.depth_pass != depth_pass;
+  }
+  if (!Changes(differs)) {
+    return;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    if ((i == 0 && face == GL_BACK) || (i == 1 && face == GL_FRONT)) {
+      continue;
+    }
+    stencil_ops_[ i ].stencil_fail = stencil_fail;
+    stencil_ops_[ i ].depth_fail = depth_fail;
+    stencil_ops_[ i ].depth_pass = depth_pass;
+  }
+  glStencilOpSeparate(face, stencil_fail, depth_fail, depth_pass);
+}
+
+void GLState::UseProgram(GLuint program) {
+
+  if (Changes(program_ != program)) {
+    program_ = program;
+    glUseProgram(program);
+  }
+}
+
+GLuint GLState::program() const {
+  return program_;
+}
+
+void GLState::BindVertexArray(GLuint vertex_array) {
+
+  if (Changes(vertex_array_ != vertex_array)) {
+    vertex_array_ = vertex_array;
+    glBindVertexArray(vertex_array);
+  }
+}
+
+void GLState::ActiveTexture(GLint unit) {
+
+  if (Changes(active_texture_ != unit)) {
+    active_texture_ = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void GLState::BindTexture(GLint unit, GLenum target, GLuint texture) {
+
+  int index = TextureTargetIndex(target);
+  if (index == -1 || unit < 0 || unit >= kMaxTextureUnits) {
+    ActiveTexture(unit);
+    stats_.issued++;
+    glBindTexture(target, texture);
+    return;
+  }
+
+  if (!Changes(textures_[ unit ][ index ] != texture)) {
+    return;
+  }
+  textures_[ unit ][ index ] = texture;
+  // the unit switch is counted on its own
+  ActiveTexture(unit);
+  glBindTexture(target, texture);
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture) {
+
+  if (active_texture_ == static_cast<GLint>(kUnknown)) {
+    ActiveTexture(0);
+  }
+  BindTexture(active_texture_, target, texture);
+}
+
+void GLState::DeleteTextures(GLsizei count, const GLuint *textures) {
+
+  for (GLsizei i = 0; i < count; i++) {
+    for (GLint unit = 0; unit < kMaxTextureUnits; unit++) {
+      for (int target = 0; target < NUM_TEXTURE_TARGETS; target++) {
+        if (textures_[ unit ][ target ] == textures[ i ]) {
+          textures_[ unit ][ target ] = 0;
+        }
+      }
+    }
+  }
+  glDeleteTextures(count, textures);
+}
+
+void GLState::DeleteProgram(GLuint program) {
+
+  if (program_ == program) {
+    program_ = 0;
+  }
+  glDeleteProgram(program);
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer) {
+
+  bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if (!Changes((draw && draw_framebuffer_ != framebuffer) ||
+               (read && read_framebuffer_ != framebuffer))) {
+    return;
+  }
+  if (draw) {
+    draw_framebuffer_ = framebuffer;
+  }
+  if (read) {
+    read_framebuffer_ = framebuffer;
+  }
+  glBindFramebuffer(target, framebuffer);
+}
+
+void GLState::DeleteFramebuffers(GLsizei count, const GLuint *framebuffers) {
+
+  for (GLsizei i = 0; i < count; i++) {
+    if (draw_framebuffer_ == framebuffers[ i ]) {
+      draw_framebuffer_ = 0;
+    }
+    if (read_framebuffer_ == framebuffers[ i ]) {
+      read_framebuffer_ = 0;
+    }
+    draw_buffers_.erase(framebuffers[ i ]);
+    read_buffers_.erase(framebuffers[ i ]);
+  }
+  glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState::DrawBuffers(GLsizei count, const GLenum *buffers) {
+
+  std::vector<GLenum> value(buffers, buffers + count);
+  if (draw_framebuffer_ == kUnknown) {
+    stats_.issued++;
+  } else {
+    std::map<GLuint, std::vector<GLenum> >::iterator it =
+        draw_buffers_.find(draw_framebuffer_);
+    if (!Changes(it == draw_buffers_.end() || it->second != value)) {
+      return;
+    }
+    draw_buffers_[ draw_framebuffer_ ] = value;
+  }
+  glDrawBuffers(count, buffers);
+}
+
+void GLState::DrawBuffer(GLenum buffer) {
+
+  // the same state as glDrawBuffers with one buffer
+  if (draw_framebuffer_ != kUnknown) {
+    std::vector<GLenum> value(1, buffer);
+    std::map<GLuint, std::vector<GLenum> >::iterator it =
+        draw_buffers_.find(draw_framebuffer_);
+    if (!Changes(it == draw_buffers_.end() || it->second != value)) {
+      return;
+    }
+    draw_buffers_[ draw_framebuffer_ ] = value;
+  } else {
+    stats_.issued++;
+  }
+  glDrawBuffer(buffer);
+}
+
+void GLState::ReadBuffer(GLenum buffer) {
+
+  if (read_framebuffer_ != kUnknown) {
+    std::map<GLuint, GLenum>::iterator it =
+        read_buffers_.find(read_framebuffer_);
+    if (!Changes(it == read_buffers_.end() || it->second != buffer)) {
+      return;
+    }
+    read_buffers_[ read_framebuffer_ ] = buffer;
+  } else {
+    stats_.issued++;
+  }
+  glReadBuffer(buffer);
+}
+
+void GLState::Invalidate() {
+
+  for (int i = 0; i < NUM_CAPABILITIES; i++) {
+    capabilities_[ i ] = -1;
+  }
+  depth_mask_ = -1;
+  depth_function_ = kUnknown;
+  blend_equation_ = kUnknown;
+  blend_source_ = kUnknown;
+  blend_destination_ = kUnknown;
+  cull_face_ = kUnknown;
+  // a negative size is invalid, so it never matches
+  for (int i = 0; i < 4; i++) {
+    scissor_[ i ] = -1;
+  }
+  stencil_function_ = kUnknown;
+  stencil_reference_ = 0;
+  stencil_mask_ = 0;
+  for (int i = 0; i < 2; i++) {
+    stencil_ops_[ i ].stencil_fail = kUnknown;
+    stencil_ops_[ i ].depth_fail = kUnknown;
+    stencil_ops_[ i ].depth_pass = kUnknown;
+  }
+  program_ = kUnknown;
+  vertex_array_ = kUnknown;
+  active_texture_ = static_cast<GLint>(kUnknown);
+  for (GLint unit = 0; unit < kMaxTextureUnits; unit++) {
+    for (int target = 0; target < NUM_TEXTURE_TARGETS; target++) {
+      textures_[ unit ][ target ] = kUnknown;
+    }
+  }
+  draw_framebuffer_ = kUnknown;
+  read_framebuffer_ = kUnknown;
+  draw_buffers_.clear();
+  read_buffers_.clear();
+}
+
+const GLState::Stats &GLState::stats() const {
+  return stats_;
+}
+
+void GLState::ResetStats() {
+
+  stats_.issued = 0;
+  stats_.elided = 0;
+}
+
+} // namespace oncgl
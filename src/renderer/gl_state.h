@@ -0,0 +1,191 @@
+#ifndef ONCGL_RENDERER_GL_STATE_H
+#define ONCGL_RENDERER_GL_STATE_H
+
+#include <stddef.h>
+
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace oncgl {
+
+/**
+ * Shadow copy of the OpenGL state the renderer changes
+ *
+ * All state changes of the renderer go through this class, which issues a
+ * GL call only if the value differs from the last one it set. Tracked are the
+ * bound program, vertex array, textures per unit, framebuffers, draw and read
+ * buffers and the depth, blend, stencil, cull and scissor state. Other
+ * capabilities and targets are passed through and counted as issued.
+ * State changed behind its back must be reported with Invalidate. Must only
+ * be used on the thread the OpenGL context is current on.
+ */
+class GLState {
+ public:
+  // texture units with tracked bindings
+  static const GLint kMaxTextureUnits = 16;
+
+  struct Stats {
+    // state changes passed to GL
+    size_t issued;
+    // state changes dropped because nothing would change
+    size_t elided;
+  };
+
+  static GLState &Instance();
+
+  void Enable(GLenum capability);
+
+  void Disable(GLenum capability);
+
+  /**
+   * @returns the shadowed value for tracked capabilities, otherwise asks GL
+   */
+  bool IsEnabled(GLenum capability) const;
+
+  void DepthMask(GLboolean enabled);
+
+  void DepthFunc(GLenum function);
+
+  void BlendEquation(GLenum mode);
+
+  void BlendFunc(GLenum source, GLenum destination);
+
+  void CullFace(GLenum face);
+
+  void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+  // for both faces, like glStencilFunc
+  void StencilFunc(GLenum function, GLint reference, GLuint mask);
+
+  void StencilOpSeparate(GLenum face, GLenum stencil_fail, GLenum depth_fail,
+                         GLenum depth_pass);
+
+  void UseProgram(GLuint program);
+
+  GLuint program() const;
+
+  void BindVertexArray(GLuint vertex_array);
+
+  void ActiveTexture(GLint unit);
+
+  /**
+   * Bind a texture to a unit, the active unit is only switched if the
+   * binding changes
+   *
+   * @param unit      texture unit, GL_TEXTURE0 + unit
+   * @param target    e.g. GL_TEXTURE_2D or GL_TEXTURE_BUFFER
+   * @param texture   texture to bind, 0 to unbind
+   */
+  void BindTexture(GLint unit, GLenum target, GLuint texture);
+
+  /**
+   * Bind a texture to the active unit, for creating and uploading textures
+   */
+  void BindTexture(GLenum target, GLuint texture);
+
+  /**
+   * Delete textures and forget their bindings, GL unbinds them as well and
+   * may reuse the names
+   */
+  void DeleteTextures(GLsizei count, const GLuint *textures);
+
+  // the program is unbound by GL if it is in use
+  void DeleteProgram(GLuint program);
+
+  /**
+   * @param target    GL_FRAMEBUFFER binds the draw and the read framebuffer
+   */
+  void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+  void DeleteFramebuffers(GLsizei count, const GLuint *framebuffers);
+
+  // of the bound draw framebuffer, remembered per framebuffer
+  void DrawBuffers(GLsizei count, const GLenum *buffers);
+
+  void DrawBuffer(GLenum buffer);
+
+  // of the bound read framebuffer, remembered per framebuffer
+  void ReadBuffer(GLenum buffer);
+
+  /**
+   * Forget everything, the next change of every state is issued
+   * Needed after code that changes the GL state directly.
+   */
+  void Invalidate();
+
+  const Stats &stats() const;
+
+  void ResetStats();
+
+ private:
+  // tracked capabilities
+  enum Capability {
+    CAPABILITY_DEPTH_TEST,
+    CAPABILITY_BLEND,
+    CAPABILITY_CULL_FACE,
+    CAPABILITY_STENCIL_TEST,
+    CAPABILITY_SCISSOR_TEST,
+    CAPABILITY_DEPTH_CLAMP,
+    NUM_CAPABILITIES
+  };
+
+  // tracked texture targets
+  enum TextureTarget {
+    TEXTURE_TARGET_2D,
+    TEXTURE_TARGET_BUFFER,
+    NUM_TEXTURE_TARGETS
+  };
+
+  struct StencilOp {
+    GLenum stencil_fail;
+    GLenum depth_fail;
+    GLenum depth_pass;
+  };
+
+  // -1 unknown, 0 disabled, 1 enabled
+  int capabilities_[ NUM_CAPABILITIES ];
+  int depth_mask_;
+  GLenum depth_function_;
+  GLenum blend_equation_;
+  GLenum blend_source_;
+  GLenum blend_destination_;
+  GLenum cull_face_;
+  // x, y, width and height
+  GLint scissor_[ 4 ];
+  GLenum stencil_function_;
+  GLint stencil_reference_;
+  GLuint stencil_mask_;
+  // front and back
+  StencilOp stencil_ops_[ 2 ];
+  GLuint program_;
+  GLuint vertex_array_;
+  GLint active_texture_;
+  GLuint textures_[ kMaxTextureUnits ][ NUM_TEXTURE_TARGETS ];
+  GLuint draw_framebuffer_;
+  GLuint read_framebuffer_;
+  std::map<GLuint, std::vector<GLenum> > draw_buffers_;
+  std::map<GLuint, GLenum> read_buffers_;
+  Stats stats_;
+
+  GLState();
+
+  // whether a change is needed, counts it either way
+  bool Changes(bool differs);
+
+  static int CapabilityIndex(GLenum capability);
+
+  static int TextureTargetIndex(GLenum target);
+
+  void SetCapability(GLenum capability, bool enabled);
+
+  //copying disabled
+  GLState(const GLState &);
+
+  const GLState &operator=(const GLState &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_RENDERER_GL_STATE_H
@@ -0,0 +1,124 @@
+#include "renderer/gpu_timer.h"
+
+#include <assert.h>
+
+namespace oncgl {
+
+const int GpuTimer::kFrameLatency;
+
+namespace {
+
+const char *const kPassNames[ NUM_GPU_TIMER_PASSES ] = {
+    "geometry", "stencil", "point", "dir", "final", "text"
+};
+
+} // namespace
+
+GpuTimer::GpuTimer() :
+    current_(0),
+    running_(false),
+    dropped_frames_(0) {
+
+  for (int i = 0; i < kFrameLatency; i++) {
+    frames_[ i ].used = 0;
+  }
+  for (int i = 0; i < NUM_GPU_TIMER_PASSES; i++) {
+    ms_[ i ] = 0.0;
+    counts_[ i ] = 0;
+  }
+}
+
+GpuTimer::~GpuTimer() {
+
+  for (int i = 0; i < kFrameLatency; i++) {
+    if (!frames_[ i ].queries.empty()) {
+      glDeleteQueries(frames_[ i ].queries.size(),
+                      frames_[ i ].queries.data());
+    }
+  }
+}
+
+void GpuTimer::BeginFrame() {
+
+  assert(!running_);
+  current_ = (current_ + 1) % kFrameLatency;
+  Collect(&frames_[ current_ ]);
+  frames_[ current_ ].used = 0;
+}
+
+void GpuTimer::Begin(GpuTimerPass pass) {
+
+  assert(!running_);
+  Frame &frame = frames_[ current_ ];
+  if (frame.used == frame.queries.size()) {
+    GLuint query;
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+    frame.passes.push_back(pass);
+  }
+  frame.passes[ frame.used ] = pass;
+  glBeginQuery(GL_TIME_ELAPSED, frame.queries[ frame.used ]);
+  frame.used++;
+  running_ = true;
+}
+
+void GpuTimer::End() {
+
+  assert(running_);
+  glEndQuery(GL_TIME_ELAPSED);
+  running_ = false;
+}
+
+void GpuTimer::Collect(Frame *frame) {
+
+  if (frame->used == 0) {
+    return;
+  }
+
+  // queries finish in order, if the last one is done all are
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(frame->queries[ frame->used - 1 ],
+                     GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    dropped_frames_++;
+    return;
+  }
+
+  for (int i = 0; i < NUM_GPU_TIMER_PASSES; i++) {
+    ms_[ i ] = 0.0;
+    counts_[ i ] = 0;
+  }
+  for (size_t i = 0; i < frame->used; i++) {
+    GLuint64 elapsed_ns = 0;
+    glGetQueryObjectui64v(frame->queries[ i ], GL_QUERY_RESULT, &elapsed_ns);
+    ms_[ frame->passes[ i ]] += elapsed_ns / 1e6;
+    counts_[ frame->passes[ i ]]++;
+  }
+}
+
+double GpuTimer::ms(GpuTimerPass pass) const {
+  return ms_[ pass ];
+}
+
+unsigned int GpuTimer::count(GpuTimerPass pass) const {
+  return counts_[ pass ];
+}
+
+double GpuTimer::total_ms() const {
+
+  double total = 0.0;
+  for (int i = 0; i < NUM_GPU_TIMER_PASSES; i++) {
+    total += ms_[ i ];
+  }
+  return total;
+}
+
+size_t GpuTimer::dropped_frames() const {
+  return dropped_frames_;
+}
+
+const char *GpuTimer::name(GpuTimerPass pass) {
+  return kPassNames[ pass ];
+}
+
+} // namespace oncgl
@@ -0,0 +1,101 @@
+#ifndef ONCGL_RENDERER_GPU_TIMER_H
+#define ONCGL_RENDERER_GPU_TIMER_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace oncgl {
+
+// passes measured by GpuTimer
+enum GpuTimerPass {
+  GPU_TIMER_GEOMETRY,
+  GPU_TIMER_STENCIL,
+  GPU_TIMER_POINT_LIGHT,
+  GPU_TIMER_DIRECTIONAL_LIGHT,
+  GPU_TIMER_FINAL,
+  GPU_TIMER_TEXT,
+  NUM_GPU_TIMER_PASSES
+};
+
+/**
+ * GPU time of the render passes, measured with GL_TIME_ELAPSED queries
+ *
+ * The queries of a frame are read kFrameLatency frames later, when the GPU
+ * has long finished them, so reading never waits. A frame whose queries are
+ * still not available by then is dropped instead of waited for. Passes that
+ * run several times per frame are summed.
+ * Elapsed-time queries cannot be nested, only one pass is measured at a time.
+ */
+class GpuTimer {
+ public:
+  // frames between issuing the queries of a frame and reading them
+  static const int kFrameLatency = 4;
+
+  GpuTimer();
+
+  ~GpuTimer();
+
+  /**
+   * Start a new frame and collect the results of the frame kFrameLatency
+   * frames ago, must be called once per frame before the first Begin
+   */
+  void BeginFrame();
+
+  /**
+   * Start measuring a pass, the time until End is added to it
+   *
+   * @param pass  pass the following commands belong to
+   */
+  void Begin(GpuTimerPass pass);
+
+  void End();
+
+  /**
+   * @returns GPU time of the pass in milliseconds in the last collected frame
+   */
+  double ms(GpuTimerPass pass) const;
+
+  /**
+   * @returns how often the pass ran in the last collected frame
+   */
+  unsigned int count(GpuTimerPass pass) const;
+
+  // sum of all passes of the last collected frame
+  double total_ms() const;
+
+  // frames whose results were not available in time
+  size_t dropped_frames() const;
+
+  // short name of a pass, for display
+  static const char *name(GpuTimerPass pass);
+
+ private:
+  // queries issued in one frame, reused kFrameLatency frames later
+  struct Frame {
+    std::vector<GLuint> queries;
+    std::vector<GpuTimerPass> passes;
+    // queries issued, the first ones of queries
+    size_t used;
+  };
+
+  Frame frames_[ kFrameLatency ];
+  int current_;
+  bool running_;
+  double ms_[ NUM_GPU_TIMER_PASSES ];
+  unsigned int counts_[ NUM_GPU_TIMER_PASSES ];
+  size_t dropped_frames_;
+
+  void Collect(Frame *frame);
+
+  //copying disabled
+  GpuTimer(const GpuTimer &);
+
+  const GpuTimer &operator=(const GpuTimer &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_RENDERER_GPU_TIMER_H
@@ -0,0 +1,134 @@
+#include "renderer/render_queue.h"
+
+#include <algorithm>
+
+#include "model/geometry_arena.h"
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+RenderQueue::RenderQueue() {
+  stats_.draws = 0;
+  stats_.program_changes = 0;
+  stats_.material_changes = 0;
+  stats_.vertex_array_changes = 0;
+}
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int program,
+                              uint32_t material, unsigned int vertex_array,
+                              float depth) {
+
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+  uint64_t quantized_depth = (uint64_t) (depth * 0xFFFFFF);
+
+  return ((uint64_t) (pass & 0xF) << 60) |
+      ((uint64_t) (program & 0xFF) << 52) |
+      ((uint64_t) (material & 0xFFFFFF) << 28) |
+      ((uint64_t) (vertex_array & 0xF) << 24) |
+      quantized_depth;
+}
+
+void RenderQueue::Push(const DrawPacket &packet) {
+
+  SortEntry entry = { packet.key, (uint32_t) packets_.size() };
+  entries_.push_back(entry);
+  packets_.push_back(packet);
+}
+
+void RenderQueue::Sort() {
+
+  scratch_.resize(entries_.size());
+
+  for (int shift = 0; shift < 64; shift += 8) {
+    size_t counts[ 256 ] = { 0 };
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      counts[ (entries_[ i ].key >> shift) & 0xFF ]++;
+    }
+
+    // all keys share this byte, the pass would not move anything
+    if (counts[ (entries_[ 0 ].key >> shift) & 0xFF ] == entries_.size()) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (int bucket = 0; bucket < 256; ++bucket) {
+      size_t count = counts[ bucket ];
+      counts[ bucket ] = offset;
+      offset += count;
+    }
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      scratch_[ counts[ (entries_[ i ].key >> shift) & 0xFF ]++ ] =
+          entries_[ i ];
+    }
+    entries_.swap(scratch_);
+  }
+}
+
+void RenderQueue::Submit() {
+
+  stats_.draws = entries_.size();
+  stats_.program_changes = 0;
+  stats_.material_changes = 0;
+  stats_.vertex_array_changes = 0;
+
+  if (entries_.empty()) {
+    return;
+  }
+
+  Sort();
+
+  Program *program = NULL;
+  GLint shininess_location = -1;
+  bool material_bound = false;
+  uint32_t material = 0;
+  int format = -1;
+
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const DrawPacket &packet = packets_[ entries_[ i ].packet ];
+
+    if (packet.program != program) {
+      program = packet.program;
+      program->Use();
+      // the shininess uniform belongs to the program
+      shininess_location = program->FindUniform(Material::kShininessUniform);
+      material_bound = false;
+      stats_.program_changes++;
+    }
+
+    if (packet.format != format) {
+      format = packet.format;
+      GeometryArena::Instance().Bind(packet.format);
+      stats_.vertex_array_changes++;
+    }
+
+    // Material::Bind sets every slot, a material without textures unbinds
+    // the ones of the previous material
+    if (!material_bound || packet.mesh->material_id() != material) {
+      material_bound = true;
+      material = packet.mesh->material_id();
+      packet.mesh->material().Bind(shininess_location);
+      stats_.material_changes++;
+    }
+
+    program->setUniform("instanceOffset", packet.instance_offset);
+    packet.mesh->DrawElements(packet.num_instances);
+  }
+
+  GLState::Instance().BindVertexArray(0);
+  Material::Unbind();
+  program->StopUsing();
+
+  packets_.clear();
+  entries_.clear();
+}
+
+size_t RenderQueue::size() const {
+  return packets_.size();
+}
+
+const RenderQueue::Stats &RenderQueue::stats() const {
+  return stats_;
+}
+
+} // namespace oncgl
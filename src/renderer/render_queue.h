@@ -0,0 +1,104 @@
+#ifndef ONCGL_RENDERER_RENDER_QUEUE_H
+#define ONCGL_RENDERER_RENDER_QUEUE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "model/mesh.h"
+#include "model/objects.h"
+#include "shader_program/shader_program.h"
+
+namespace oncgl {
+
+// pass field of the sort keys
+enum RenderPass {
+  RENDER_PASS_GEOMETRY = 0
+};
+
+/**
+ * One draw call of a mesh, with everything needed to submit it
+ */
+struct DrawPacket {
+
+  // sort key, see RenderQueue::MakeKey
+  uint64_t key;
+  Program *program;
+  Mesh *mesh;
+  VertexFormat format;
+  // first entry of the draw in the instance node buffer of the scene
+  GLint instance_offset;
+  GLsizei num_instances;
+};
+
+/**
+ * Collects the draws of a frame, sorts them by state and submits them
+ *
+ * The 64 bit key orders the packets by (high to low bits)
+ *   pass (4) | program (8) | material (24) | vertex array (4) | depth (24)
+ * so after sorting, packets sharing a state are adjacent and the submission
+ * only touches the state that differs from the previous packet. Depth sorts
+ * front to back within a state, for early-z.
+ */
+class RenderQueue {
+ public:
+  // counters of the last Submit
+  struct Stats {
+
+    unsigned int draws;
+    unsigned int program_changes;
+    unsigned int material_changes;
+    unsigned int vertex_array_changes;
+  };
+
+  RenderQueue();
+
+  /**
+   * Build a sort key, every field is truncated to its width
+   *
+   * @param pass          pass the draw belongs to
+   * @param program       index of the program
+   * @param material      id of the texture set (Mesh::material_id)
+   * @param vertex_array  vertex format, selects the VAO of the arena
+   * @param depth         view distance in [0, 1], 0 is nearest
+   * @returns the key
+   */
+  static uint64_t MakeKey(unsigned int pass, unsigned int program,
+                          uint32_t material, unsigned int vertex_array,
+                          float depth);
+
+  void Push(const DrawPacket &packet);
+
+  /**
+   * Sort the packets by key and draw them, the queue is empty afterwards
+   * The per-frame uniforms of the programs must already be set. The material
+   * texture units are unbound afterwards.
+   */
+  void Submit();
+
+  size_t size() const;
+
+  const Stats &stats() const;
+
+ private:
+  // what the radix sort moves around, the packets stay in place
+  struct SortEntry {
+
+    uint64_t key;
+    uint32_t packet;
+  };
+
+  std::vector<DrawPacket> packets_;
+  std::vector<SortEntry> entries_;
+  std::vector<SortEntry> scratch_;
+  Stats stats_;
+
+  // LSD radix sort of entries_, 8 bits per pass
+  void Sort();
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_RENDERER_RENDER_QUEUE_H
@@ -6,7 +6,16 @@
 
 #include "shader_program/shader_program.h"
 #include "model/model.h"
+#include "model/model_loader.h"
+#include "renderer/frame_constants.h"
+#include "renderer/gl_state.h"
+#include "renderer/gpu_timer.h"
+#include "renderer/render_queue.h"
+#include "scene/scene.h"
 #include "misc/constants.h"
+#include "light/light_buffer.h"
+#include "light/light_culler.h"
+#include "light/tiled_light_culler.h"
 #include "light/lights.h"
 #include "camera/camera.h"
 #include "framebuffer/framebuffer.h"
@@ -34,12 +43,16 @@ class Renderer {
   float window_width_;
   float window_height_;
 
-  Program *LoadShaders(std::string vertex_shader, std::string fragment_shader);
+  Program *LoadShaders(std::string vertex_shader, std::string fragment_shader,
+                       std::string defines = "");
 };
 
 class DeferredRenderer : Renderer {
 
  public:
+  // volumes one stencil pass can count around a pixel, the stencil buffer has
+  // 8 bits
+  static const size_t kMaxStencilVolumes = 255;
 
   DeferredRenderer(float window_width, float window_height);
 
@@ -54,37 +67,92 @@ class DeferredRenderer : Renderer {
   void Init(int window_width, int window_height);
 
   /**
-   * Render the geometrypass with the given models from cameras point of view
+   * Upload the per-frame constants, read by every pass through the
+   * FrameConstants uniform block
+   * Must be called once per frame before the first pass.
    *
-   * @param models  models to draw
+   * @param camera              camera to draw from
+   * @param directional_light   the directional light of the frame
+   */
+  void BeginFrame(const Camera &camera,
+                  const DirectionalLight &directional_light);
+
+  /**
+   * Update the point lights, the light passes select them by their index
+   * Only uploaded if a light changed, bounding radii are only recomputed for
+   * lights whose radius can have changed.
+   *
+   * @param point_lights  all point lights of the scene
+   */
+  void set_point_lights(const std::vector<PointLight> &point_lights);
+
+  /**
+   * Collect the point lights that can light a pixel of the frame
+   * Tests the light volumes against the view frustum, drops volumes smaller
+   * than a pixel and, with occlusion culling, the ones behind the occluders
+   * of the last geometry pass. Call after RenderGeometryPass.
+   *
+   * @param visible   receives the indices of the visible lights
+   */
+  void CullPointLights(std::vector<uint32_t> *visible);
+
+  /**
+   * Render the geometrypass with all instances of the scene from cameras point
+   * of view
+   *
+   * @param scene   scene to draw
    * @param camera  camera to draw from
    */
-  void RenderGeometryPass(std::vector<Model> models, Camera camera);
+  void RenderGeometryPass(Scene *scene, Camera camera);
 
   /**
-   * Render the stencilpass
+   * Render the stencilpass of the given point lights, their volumes are drawn
+   * in one instanced draw call
+   * The stencil buffer counts the volumes around every pixel, it is only
+   * cleared once for all lights. More lights need several stencil and point
+   * light passes, the count of more volumes would wrap to 0.
    *
-   * @param point_light   model of the pointlight
-   * @param camera        camera to draw from
+   * @param light_indices   lights to shade, see set_point_lights, at most
+   *                        kMaxStencilVolumes
+   */
+  void RenderStencilPass(const std::vector<uint32_t> &light_indices);
+
+  /**
+   * Render the pointlightpass of the lights of the last stencil pass, in one
+   * instanced draw call
+   * Pixels inside no volume are rejected by the stencil test, pixels outside
+   * the volume of an instance by the shader.
    */
-  void RenderStencilPass(PointLight point_light, Camera camera);
+  void RenderPointLightPass();
 
   /**
-   * Render the pointlightpass
+   * Shade the given point lights without a stencil pass, in at most two
+   * instanced draw calls of their volumes
+   * Lights the camera is outside of draw their back faces with the depth test
+   * GL_GREATER, so only geometry in front of the back faces is shaded. Lights
+   * around the camera draw their back faces without depth test. The first
+   * draw is limited by a scissor rectangle around the projected spheres.
    *
-   * @param point_light   model of the pointlight
-   * @param camera        camera to draw from
+   * @param light_indices   lights to shade, see set_point_lights
    */
-  void RenderPointLightPass(PointLight point_light, Camera camera);
+  void RenderLightVolumePass(const std::vector<uint32_t> &light_indices);
 
   /**
-   * Render the directionallightpass
+   * Shade the given point lights in one full screen pass instead of a stencil
+   * and a point light pass per light
+   * The lights are binned into clusters, screen tiles split into depth slices,
+   * on the worker threads and each pixel loops over the lights of its
+   * cluster. Uses the occlusion buffer of the geometry pass for the depth of
+   * the tiles.
    *
-   * @param directional_light   model of the directionallight
-   * @param camera              camera to draw from
+   * @param light_indices   lights to shade, see set_point_lights
+   */
+  void RenderTiledLightPass(const std::vector<uint32_t> &light_indices);
+
+  /**
+   * Render the directionallightpass with the light given to BeginFrame
    */
-  void RenderDirectionalLightPass(DirectionalLight directional_light,
-                                  Camera camera);
+  void RenderDirectionalLightPass();
 
   /**
    * Render the final pass
@@ -92,14 +160,82 @@ class DeferredRenderer : Renderer {
    */
   void RenderFinalPass();
 
+  /**
+   * Set the framebuffer the final pass copies to
+   *
+   * @param framebuffer   target framebuffer, 0 (default) is the backbuffer
+   */
+  void set_output_framebuffer(GLuint framebuffer);
+
+  /**
+   * Skip instances outside the view frustum in the geometry pass (default)
+   *
+   * @param enabled   false draws every instance, for comparison
+   */
+  void set_frustum_culling(bool enabled);
+
+  /**
+   * Draw large meshes into a CPU depth buffer and skip the instances hidden
+   * behind them in the geometry pass (default), needs frustum culling
+   *
+   * @param enabled   false draws every instance inside the frustum
+   */
+  void set_occlusion_culling(bool enabled);
+
+  /**
+   * Occluders of the last geometry pass, e.g. to test light volumes against
+   * Holds no occluders if occlusion culling is disabled.
+   */
+  const OcclusionBuffer &occlusion_buffer() const;
+
+  /**
+   * Counters of the last geometry pass
+   */
+  const RenderQueue::Stats &geometry_stats() const;
+
+  /**
+   * GPU time of the passes, each pass measures itself
+   * The frame is advanced by BeginFrame. Work outside the renderer, like the
+   * text, can be measured with GPU_TIMER_TEXT.
+   */
+  GpuTimer *gpu_timer();
+
+  /**
+   * Bounding spheres of the point lights and the counters of the last
+   * CullPointLights
+   */
+  LightCuller *light_culler();
+
+  /**
+   * Light lists of the last tiled light pass, can also be bound by forward
+   * passes
+   */
+  const TiledLightCuller &tiled_lights() const;
+
  private:
-  Program *geometryShaderProgram_;
+  // one geometry program per vertex format, indexed by VertexFormat
+  Program *geometryShaderPrograms_[ NUM_VERTEX_FORMATS ];
+  RenderQueue geometryQueue_;
   Program *pointLightShaderProgram_;
   Program *directionalLightShaderProgram_;
   Program *stencilShaderProgram_;
+  Program *tiledLightShaderProgram_;
+
+  FrameConstants frame_constants_;
+  UniformBuffer frame_constant_buffer_;
+  LightBuffer light_buffer_;
+  LightCuller light_culler_;
+  TiledLightCuller tiled_lights_;
+  // the tiled light pass draws without vertex data, but needs a vertex array
+  GLuint empty_vertex_array_;
 
   // FrameBuffer
   FrameBuffer *frameBufferObject_;
+  GLuint output_framebuffer_;
+  bool frustum_culling_;
+  bool occlusion_culling_;
+  OcclusionBuffer occlusion_buffer_;
+  GpuTimer gpu_timer_;
 
   Model *pointLightModel_;
   Model *directionalLightModel_;
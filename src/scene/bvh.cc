@@ -0,0 +1,654 @@
+#include "scene/bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <utility>
+
+namespace oncgl {
+
+const Bvh::ProxyId Bvh::kNoProxy;
+
+namespace {
+
+// bins per axis of the SAH build
+const int kNumBins = 12;
+
+float Area(const glm::vec3 &min, const glm::vec3 &max) {
+  glm::vec3 d = max - min;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// entry distance of a ray into a box (slab test)
+bool RayBox(const glm::vec3 &origin, const glm::vec3 &inverse,
+            const glm::vec3 &min, const glm::vec3 &max, float *entry) {
+  glm::vec3 t0 = (min - origin) * inverse;
+  glm::vec3 t1 = (max - origin) * inverse;
+  glm::vec3 t_near = glm::min(t0, t1);
+  glm::vec3 t_far = glm::max(t0, t1);
+  *entry = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+  return *entry <= glm::min(glm::min(t_far.x, t_far.y), t_far.z);
+}
+
+struct Bin {
+
+  glm::vec3 min;
+  glm::vec3 max;
+  size_t count;
+};
+
+} // namespace
+
+// kept together so the build streams through memory instead of the nodes
+struct Bvh::BuildItem {
+
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::vec3 centroid;
+  uint32_t value;
+};
+
+Bvh::Bvh(float margin) :
+    root_(kNoProxy),
+    free_list_(kNoProxy),
+    num_leaves_(0),
+    margin_(margin),
+    refit_order_valid_(false) {
+}
+
+void Bvh::Build(const std::vector<Bounds> &bounds,
+                std::vector<ProxyId> *proxies) {
+
+  Clear();
+  proxies->assign(bounds.size(), kNoProxy);
+
+  std::vector<BuildItem> items;
+  items.reserve(bounds.size());
+  for (size_t i = 0; i < bounds.size(); i++) {
+    if (bounds[ i ].empty()) {
+      continue;
+    }
+    BuildItem item;
+    item.min = bounds[ i ].min - glm::vec3(margin_);
+    item.max = bounds[ i ].max + glm::vec3(margin_);
+    item.centroid = (item.min + item.max) * 0.5f;
+    item.value = i;
+    items.push_back(item);
+  }
+
+  num_leaves_ = items.size();
+  if (!items.empty()) {
+    nodes_.reserve(items.size() * 2 - 1);
+    root_ = BuildRange(&items[ 0 ], items.size(), proxies);
+    nodes_[ root_ ].parent = kNoProxy;
+  }
+}
+
+Bvh::ProxyId Bvh::Insert(const Bounds &bounds, uint32_t value) {
+
+  int32_t leaf = AllocateNode();
+  Node &node = nodes_[ leaf ];
+  node.min = bounds.min - glm::vec3(margin_);
+  node.max = bounds.max + glm::vec3(margin_);
+  node.value = value;
+  InsertLeaf(leaf);
+  num_leaves_++;
+  return leaf;
+}
+
+void Bvh::Remove(ProxyId proxy) {
+
+  RemoveLeaf(proxy);
+  FreeNode(proxy);
+  num_leaves_--;
+}
+
+bool Bvh::Move(ProxyId proxy, const Bounds &bounds) {
+
+  Node &leaf = nodes_[ proxy ];
+  if (glm::all(glm::lessThanEqual(leaf.min, bounds.min)) &&
+      glm::all(glm::greaterThanEqual(leaf.max, bounds.max))) {
+    return false;
+  }
+
+  glm::vec3 min = bounds.min - glm::vec3(margin_);
+  glm::vec3 max = bounds.max + glm::vec3(margin_);
+  bool overlaps = glm::all(glm::lessThanEqual(leaf.min, max)) &&
+                  glm::all(glm::lessThanEqual(min, leaf.max));
+
+  if (overlaps) {
+    // small move: refit the ancestors, the rotations repair the tree
+    leaf.min = min;
+    leaf.max = max;
+    RefitAncestors(leaf.parent);
+  } else {
+    // jump: the old place in the tree says nothing about the new one
+    RemoveLeaf(proxy);
+    nodes_[ proxy ].min = min;
+    nodes_[ proxy ].max = max;
+    InsertLeaf(proxy);
+  }
+  return true;
+}
+
+void Bvh::Refit(const std::vector<ProxyId> &proxies,
+                const std::vector<Bounds> &bounds) {
+
+  // a parent is higher than its children, fitting the marked nodes by
+  // increasing height fits every node after its children
+  refit_marks_.resize(nodes_.size(), 0);
+  for (size_t i = 0; i < proxies.size(); i++) {
+    Node &leaf = nodes_[ proxies[ i ]];
+    const Bounds &box = bounds[ leaf.value ];
+    if (glm::all(glm::lessThanEqual(leaf.min, box.min)) &&
+        glm::all(glm::greaterThanEqual(leaf.max, box.max))) {
+      continue;
+    }
+    leaf.min = box.min - glm::vec3(margin_);
+    leaf.max = box.max + glm::vec3(margin_);
+
+    // stop at the first ancestor a previous leaf already marked
+    for (int32_t node = leaf.parent; node != kNoProxy && !refit_marks_[ node ];
+         node = nodes_[ node ].parent) {
+      refit_marks_[ node ] = 1;
+      size_t height = nodes_[ node ].height;
+      if (refit_levels_.size() <= height) {
+        refit_levels_.resize(height + 1);
+      }
+      refit_levels_[ height ].push_back(node);
+    }
+  }
+
+  for (size_t height = 0; height < refit_levels_.size(); height++) {
+    std::vector<int32_t> &level = refit_levels_[ height ];
+    for (size_t i = 0; i < level.size(); i++) {
+      FitNode(level[ i ]);
+      refit_marks_[ level[ i ]] = 0;
+    }
+    level.clear();
+  }
+}
+
+void Bvh::RefitAll(const std::vector<Bounds> &bounds) {
+
+  if (root_ == kNoProxy) {
+    return;
+  }
+
+  // parents come before their children in pre-order, so walking it backwards
+  // fits every node after its children; the order is kept until the tree is
+  // restructured
+  if (!refit_order_valid_) {
+    refit_order_.clear();
+    refit_order_.reserve(nodes_.size());
+    std::vector<int32_t> stack(1, root_);
+    while (!stack.empty()) {
+      int32_t index = stack.back();
+      stack.pop_back();
+      refit_order_.push_back(index);
+      if (!nodes_[ index ].leaf()) {
+        stack.push_back(nodes_[ index ].children[ 0 ]);
+        stack.push_back(nodes_[ index ].children[ 1 ]);
+      }
+    }
+    refit_order_valid_ = true;
+  }
+
+  for (size_t i = refit_order_.size(); i-- > 0;) {
+    Node &node = nodes_[ refit_order_[ i ]];
+    if (node.leaf()) {
+      node.min = bounds[ node.value ].min - glm::vec3(margin_);
+      node.max = bounds[ node.value ].max + glm::vec3(margin_);
+    } else {
+      FitNode(refit_order_[ i ]);
+    }
+  }
+}
+
+void Bvh::Clear() {
+
+  nodes_.clear();
+  root_ = kNoProxy;
+  free_list_ = kNoProxy;
+  num_leaves_ = 0;
+  refit_order_valid_ = false;
+}
+
+void Bvh::QueryFrustum(const Frustum &frustum,
+                       std::vector<uint32_t> *values) const {
+
+  if (root_ == kNoProxy) {
+    return;
+  }
+
+  // every entry carries the planes its box still intersects, boxes inside a
+  // plane are inside for all their children too
+  const unsigned int all_planes = (1 << Frustum::NUM_PLANES) - 1;
+  std::vector<std::pair<int32_t, unsigned int> > stack;
+  stack.push_back(std::make_pair(root_, all_planes));
+  query_leaves_.clear();
+
+  while (!stack.empty()) {
+    int32_t index = stack.back().first;
+    unsigned int planes = stack.back().second;
+    stack.pop_back();
+
+    // leaves crossing a plane go to the SIMD test below
+    if (nodes_[ index ].leaf() && planes != 0) {
+      query_leaves_.push_back(index);
+      continue;
+    }
+
+    const Node &node = nodes_[ index ];
+    glm::vec3 center = (node.min + node.max) * 0.5f;
+    glm::vec3 extents = (node.max - node.min) * 0.5f;
+
+    bool outside = false;
+    for (int p = 0; p < Frustum::NUM_PLANES && !outside; p++) {
+      if (!(planes & (1 << p))) {
+        continue;
+      }
+      const glm::vec4 &plane = frustum.planes[ p ];
+      float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+      float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+      if (distance + radius < 0.0f) {
+        outside = true;
+      } else if (distance - radius >= 0.0f) {
+        planes &= ~(1 << p);
+      }
+    }
+
+    if (outside) {
+      continue;
+    }
+    if (planes == 0) {
+      CollectLeaves(index, values);
+    } else {
+      stack.push_back(std::make_pair(node.children[ 0 ], planes));
+      stack.push_back(std::make_pair(node.children[ 1 ], planes));
+    }
+  }
+
+  // the leaves are tested against all planes, four at a time
+  size_t count = query_leaves_.size();
+  query_boxes_.Resize(count);
+  for (size_t i = 0; i < count; i++) {
+    const Node &node = nodes_[ query_leaves_[ i ] ];
+    query_boxes_.Set(i, (node.min + node.max) * 0.5f,
+                     (node.max - node.min) * 0.5f);
+  }
+  query_visible_.resize(count);
+  if (CullBoxes(frustum, query_boxes_, 0, count, query_visible_.data()) == 0) {
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (query_visible_[ i ]) {
+      values->push_back(nodes_[ query_leaves_[ i ] ].value);
+    }
+  }
+}
+
+bool Bvh::Raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+                  float max_distance, uint32_t *value, float *distance) const {
+
+  if (root_ == kNoProxy) {
+    return false;
+  }
+
+  // the division by zero gives infinities that compare correctly
+  glm::vec3 inverse = 1.0f / direction;
+  float closest = max_distance;
+  bool hit = false;
+
+  float root_entry;
+  if (!RayBox(origin, inverse, nodes_[ root_ ].min, nodes_[ root_ ].max,
+              &root_entry)) {
+    return false;
+  }
+
+  std::vector<std::pair<int32_t, float> > stack;
+  stack.push_back(std::make_pair(root_, root_entry));
+  while (!stack.empty()) {
+    int32_t index = stack.back().first;
+    float entry = stack.back().second;
+    stack.pop_back();
+    if (entry > closest) {
+      continue;
+    }
+
+    const Node &node = nodes_[ index ];
+    if (node.leaf()) {
+      closest = entry;
+      *value = node.value;
+      hit = true;
+      continue;
+    }
+
+    // push the farther child first so the nearer one is visited first
+    float entries[ 2 ];
+    bool hits[ 2 ];
+    for (int i = 0; i < 2; i++) {
+      const Node &child = nodes_[ node.children[ i ]];
+      hits[ i ] = RayBox(origin, inverse, child.min, child.max,
+                         &entries[ i ]) && entries[ i ] <= closest;
+    }
+    int first = entries[ 0 ] <= entries[ 1 ] ? 0 : 1;
+    if (hits[ 1 - first ]) {
+      stack.push_back(std::make_pair(node.children[ 1 - first ],
+                                     entries[ 1 - first ]));
+    }
+    if (hits[ first ]) {
+      stack.push_back(std::make_pair(node.children[ first ],
+                                     entries[ first ]));
+    }
+  }
+
+  if (hit) {
+    *distance = closest;
+  }
+  return hit;
+}
+
+size_t Bvh::size() const {
+  return num_leaves_;
+}
+
+int Bvh::height() const {
+  return root_ == kNoProxy ? 0 : nodes_[ root_ ].height;
+}
+
+int32_t Bvh::AllocateNode() {
+
+  int32_t index;
+  if (free_list_ != kNoProxy) {
+    index = free_list_;
+    free_list_ = nodes_[ index ].parent;
+  } else {
+    index = nodes_.size();
+    nodes_.push_back(Node());
+  }
+
+  Node &node = nodes_[ index ];
+  node.parent = kNoProxy;
+  node.children[ 0 ] = kNoProxy;
+  node.children[ 1 ] = kNoProxy;
+  node.height = 0;
+  node.value = 0;
+  return index;
+}
+
+void Bvh::FreeNode(int32_t node) {
+
+  nodes_[ node ].parent = free_list_;
+  nodes_[ node ].height = -1;
+  free_list_ = node;
+}
+
+void Bvh::InsertLeaf(int32_t leaf) {
+
+  refit_order_valid_ = false;
+  if (root_ == kNoProxy) {
+    root_ = leaf;
+    nodes_[ leaf ].parent = kNoProxy;
+    return;
+  }
+
+  // walk down while going deeper is cheaper than becoming a sibling here;
+  // every step pays for enlarging the boxes above it (inherited cost)
+  glm::vec3 min = nodes_[ leaf ].min;
+  glm::vec3 max = nodes_[ leaf ].max;
+  int32_t index = root_;
+  while (!nodes_[ index ].leaf()) {
+    const Node &node = nodes_[ index ];
+    float area = Area(node.min, node.max);
+    float combined = Area(glm::min(node.min, min), glm::max(node.max, max));
+    float cost = 2.0f * combined;
+    float inherited = 2.0f * (combined - area);
+
+    float child_costs[ 2 ];
+    for (int i = 0; i < 2; i++) {
+      const Node &child = nodes_[ node.children[ i ]];
+      float enlarged = Area(glm::min(child.min, min), glm::max(child.max, max));
+      child_costs[ i ] = enlarged + inherited;
+      if (!child.leaf()) {
+        child_costs[ i ] -= Area(child.min, child.max);
+      }
+    }
+
+    if (cost < child_costs[ 0 ] && cost < child_costs[ 1 ]) {
+      break;
+    }
+    index = child_costs[ 0 ] < child_costs[ 1 ] ? node.children[ 0 ] :
+            node.children[ 1 ];
+  }
+
+  int32_t sibling = index;
+  int32_t old_parent = nodes_[ sibling ].parent;
+  int32_t new_parent = AllocateNode();
+
+  Node &parent = nodes_[ new_parent ];
+  parent.parent = old_parent;
+  parent.children[ 0 ] = sibling;
+  parent.children[ 1 ] = leaf;
+  nodes_[ sibling ].parent = new_parent;
+  nodes_[ leaf ].parent = new_parent;
+
+  if (old_parent == kNoProxy) {
+    root_ = new_parent;
+  } else {
+    Node &grand_parent = nodes_[ old_parent ];
+    grand_parent.children[ grand_parent.children[ 0 ] == sibling ? 0 : 1 ] =
+        new_parent;
+  }
+
+  RefitAncestors(new_parent);
+}
+
+void Bvh::RemoveLeaf(int32_t leaf) {
+
+  refit_order_valid_ = false;
+  if (leaf == root_) {
+    root_ = kNoProxy;
+    return;
+  }
+
+  int32_t parent = nodes_[ leaf ].parent;
+  int32_t grand_parent = nodes_[ parent ].parent;
+  int32_t sibling = nodes_[ parent ].children[ 0 ] == leaf ?
+                    nodes_[ parent ].children[ 1 ] :
+                    nodes_[ parent ].children[ 0 ];
+
+  nodes_[ sibling ].parent = grand_parent;
+  if (grand_parent == kNoProxy) {
+    root_ = sibling;
+  } else {
+    Node &node = nodes_[ grand_parent ];
+    node.children[ node.children[ 0 ] == parent ? 0 : 1 ] = sibling;
+  }
+  FreeNode(parent);
+  nodes_[ leaf ].parent = kNoProxy;
+
+  RefitAncestors(grand_parent);
+}
+
+void Bvh::RefitAncestors(int32_t node) {
+
+  while (node != kNoProxy) {
+    FitNode(node);
+    Rotate(node);
+    node = nodes_[ node ].parent;
+  }
+}
+
+void Bvh::FitNode(int32_t index) {
+
+  Node &node = nodes_[ index ];
+  const Node &child0 = nodes_[ node.children[ 0 ]];
+  const Node &child1 = nodes_[ node.children[ 1 ]];
+  node.min = glm::min(child0.min, child1.min);
+  node.max = glm::max(child0.max, child1.max);
+  node.height = 1 + std::max(child0.height, child1.height);
+}
+
+void Bvh::Rotate(int32_t index) {
+
+  // candidates: swap child c with grandchild g below the other child o;
+  // o then holds c and the sibling of g, its area is what changes
+  float best_gain = 0.0f;
+  int best_child = -1, best_grand_child = -1;
+
+  for (int c = 0; c < 2; c++) {
+    const Node &node = nodes_[ index ];
+    const Node &child = nodes_[ node.children[ c ]];
+    const Node &other = nodes_[ node.children[ 1 - c ]];
+    if (other.leaf()) {
+      continue;
+    }
+    float area = Area(other.min, other.max);
+    for (int g = 0; g < 2; g++) {
+      const Node &kept = nodes_[ other.children[ 1 - g ]];
+      float rotated = Area(glm::min(child.min, kept.min),
+                           glm::max(child.max, kept.max));
+      if (area - rotated > best_gain) {
+        best_gain = area - rotated;
+        best_child = c;
+        best_grand_child = g;
+      }
+    }
+  }
+
+  if (best_child < 0) {
+    return;
+  }
+
+  Node &node = nodes_[ index ];
+  int32_t child = node.children[ best_child ];
+  int32_t other = node.children[ 1 - best_child ];
+  int32_t grand_child = nodes_[ other ].children[ best_grand_child ];
+
+  refit_order_valid_ = false;
+  node.children[ best_child ] = grand_child;
+  nodes_[ grand_child ].parent = index;
+  nodes_[ other ].children[ best_grand_child ] = child;
+  nodes_[ child ].parent = other;
+
+  FitNode(other);
+  FitNode(index);
+}
+
+int32_t Bvh::BuildRange(BuildItem *items, size_t count,
+                        std::vector<ProxyId> *proxies) {
+
+  // nodes are allocated depth first, so subtrees are close in memory
+  int32_t index = AllocateNode();
+  if (count == 1) {
+    Node &leaf = nodes_[ index ];
+    leaf.min = items[ 0 ].min;
+    leaf.max = items[ 0 ].max;
+    leaf.value = items[ 0 ].value;
+    (*proxies)[ items[ 0 ].value ] = index;
+    return index;
+  }
+
+  glm::vec3 centroid_min(FLT_MAX), centroid_max(-FLT_MAX);
+  for (size_t i = 0; i < count; i++) {
+    centroid_min = glm::min(centroid_min, items[ i ].centroid);
+    centroid_max = glm::max(centroid_max, items[ i ].centroid);
+  }
+
+  // cheapest split over the bins of all three axes
+  float best_cost = FLT_MAX;
+  int best_axis = -1, best_split = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    float extent = centroid_max[ axis ] - centroid_min[ axis ];
+    if (extent <= 0.0f) {
+      continue;
+    }
+
+    Bin bins[ kNumBins ];
+    for (int b = 0; b < kNumBins; b++) {
+      bins[ b ].min = glm::vec3(FLT_MAX);
+      bins[ b ].max = glm::vec3(-FLT_MAX);
+      bins[ b ].count = 0;
+    }
+    float scale = kNumBins / extent;
+    for (size_t i = 0; i < count; i++) {
+      const BuildItem &item = items[ i ];
+      int b = std::min(kNumBins - 1, (int) ((item.centroid[ axis ] -
+                                              centroid_min[ axis ]) * scale));
+      bins[ b ].min = glm::min(bins[ b ].min, item.min);
+      bins[ b ].max = glm::max(bins[ b ].max, item.max);
+      bins[ b ].count++;
+    }
+
+    // sweep from the right, then evaluate every split from the left
+    float right_costs[ kNumBins ];
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    size_t right_count = 0;
+    for (int b = kNumBins - 1; b > 0; b--) {
+      min = glm::min(min, bins[ b ].min);
+      max = glm::max(max, bins[ b ].max);
+      right_count += bins[ b ].count;
+      right_costs[ b ] = right_count ? Area(min, max) * right_count : 0.0f;
+    }
+    min = glm::vec3(FLT_MAX);
+    max = glm::vec3(-FLT_MAX);
+    size_t left_count = 0;
+    for (int b = 0; b < kNumBins - 1; b++) {
+      min = glm::min(min, bins[ b ].min);
+      max = glm::max(max, bins[ b ].max);
+      left_count += bins[ b ].count;
+      if (left_count == 0 || left_count == count) {
+        continue;
+      }
+      float cost = Area(min, max) * left_count + right_costs[ b + 1 ];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = b + 1;
+      }
+    }
+  }
+
+  // all centroids in one point: any split is as good as another
+  size_t middle = count / 2;
+  if (best_axis >= 0) {
+    float scale = kNumBins / (centroid_max[ best_axis ] -
+                              centroid_min[ best_axis ]);
+    float origin = centroid_min[ best_axis ];
+    int axis = best_axis, split = best_split;
+    BuildItem *end = std::partition(items, items + count,
+                                    [=](const BuildItem &item) {
+      int b = std::min(kNumBins - 1,
+                       (int) ((item.centroid[ axis ] - origin) * scale));
+      return b < split;
+    });
+    middle = end - items;
+  }
+
+  int32_t left = BuildRange(items, middle, proxies);
+  int32_t right = BuildRange(items + middle, count - middle, proxies);
+  Node &node = nodes_[ index ];
+  node.children[ 0 ] = left;
+  node.children[ 1 ] = right;
+  nodes_[ left ].parent = index;
+  nodes_[ right ].parent = index;
+  FitNode(index);
+  return index;
+}
+
+void Bvh::CollectLeaves(int32_t node, std::vector<uint32_t> *values) const {
+
+  std::vector<int32_t> stack(1, node);
+  while (!stack.empty()) {
+    const Node &current = nodes_[ stack.back() ];
+    stack.pop_back();
+    if (current.leaf()) {
+      values->push_back(current.value);
+    } else {
+      stack.push_back(current.children[ 0 ]);
+      stack.push_back(current.children[ 1 ]);
+    }
+  }
+}
+
+} // namespace oncgl
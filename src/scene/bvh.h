@@ -0,0 +1,192 @@
+#ifndef ONCGL_SCENE_BVH_H
+#define ONCGL_SCENE_BVH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera/frustum.h"
+#include "model/bounds.h"
+#include "scene/culling.h"
+
+namespace oncgl {
+
+/**
+ * Dynamic bounding volume hierarchy of axis aligned boxes
+ *
+ * Every leaf holds one box (a proxy) and a user value, queries return the
+ * values of the leaves they hit. Static content is built top-down with the
+ * surface area heuristic (Build). Moving content updates its leaf with Move:
+ * leaves are enlarged by a margin, so small moves change nothing, and the
+ * boxes of the ancestors are refitted with tree rotations that keep the total
+ * surface area low. Proxy ids stay valid until the proxy is removed.
+ */
+class Bvh {
+ public:
+  typedef int32_t ProxyId;
+
+  static const ProxyId kNoProxy = -1;
+
+  /**
+   * @param margin  distance leaves are enlarged by, 0 for static content
+   */
+  explicit Bvh(float margin = 0.0f);
+
+  /**
+   * Replace the content with the given boxes, built with the binned surface
+   * area heuristic
+   *
+   * @param bounds    boxes of the leaves, empty boxes are skipped
+   * @param proxies   receives the proxy of every box, kNoProxy for empty ones;
+   *                  the value of a leaf is the index of its box
+   */
+  void Build(const std::vector<Bounds> &bounds, std::vector<ProxyId> *proxies);
+
+  /**
+   * Add a leaf
+   *
+   * @param bounds  box of the leaf
+   * @param value   value returned by queries
+   * @returns id of the new proxy
+   */
+  ProxyId Insert(const Bounds &bounds, uint32_t value);
+
+  void Remove(ProxyId proxy);
+
+  /**
+   * Move a leaf
+   *
+   * @param proxy   leaf to move
+   * @param bounds  new box of the leaf
+   * @returns true - if the tree changed, false if the box still fits the
+   *          enlarged box of the leaf
+   */
+  bool Move(ProxyId proxy, const Bounds &bounds);
+
+  /**
+   * Move many leaves and refit their ancestors bottom-up, each once
+   * Leaves still inside their enlarged box change nothing, so the cost grows
+   * with the part of the tree that really changed. Cheaper than Move when
+   * many leaves moved, but the tree is not restructured, so its quality
+   * degrades if the leaves move far.
+   *
+   * @param proxies leaves to move
+   * @param bounds  new box for every leaf, indexed by the value of the leaf
+   */
+  void Refit(const std::vector<ProxyId> &proxies,
+             const std::vector<Bounds> &bounds);
+
+  /**
+   * Set the boxes of all leaves and refit the tree bottom-up in one pass
+   * Cheaper than Refit when almost every leaf moved, the node order of the
+   * pass is kept until the tree is restructured.
+   *
+   * @param bounds  new box for every leaf, indexed by the value of the leaf
+   */
+  void RefitAll(const std::vector<Bounds> &bounds);
+
+  void Clear();
+
+  /**
+   * Values of all leaves intersecting a frustum, subtrees completely inside
+   * are taken without testing their leaves. The leaves of subtrees crossing
+   * a plane are tested together with CullBoxes.
+   */
+  void QueryFrustum(const Frustum &frustum, std::vector<uint32_t> *values) const;
+
+  /**
+   * Find the closest leaf hit by a ray
+   *
+   * @param origin        start of the ray
+   * @param direction     direction of the ray, normalized
+   * @param max_distance  length of the ray
+   * @param value         receives the value of the hit leaf
+   * @param distance      receives the distance to the box of the hit leaf
+   * @returns true - if a leaf was hit, otherwise false
+   */
+  bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+               float max_distance, uint32_t *value, float *distance) const;
+
+  // number of leaves
+  size_t size() const;
+
+  // longest path from the root to a leaf, 0 for a single leaf
+  int height() const;
+
+ private:
+  struct Node {
+
+    glm::vec3 min;
+    glm::vec3 max;
+    // next free node while the node is unused
+    int32_t parent;
+    // both kNoProxy for leaves
+    int32_t children[ 2 ];
+    int32_t height;
+    uint32_t value;
+
+    bool leaf() const { return children[ 0 ] == kNoProxy; }
+  };
+
+  // leaf of the SAH build, defined in the .cc
+  struct BuildItem;
+
+  std::vector<Node> nodes_;
+  int32_t root_;
+  int32_t free_list_;
+  size_t num_leaves_;
+  float margin_;
+
+  // scratch of Refit: marks the nodes to fit, and the marked nodes by height
+  std::vector<uint8_t> refit_marks_;
+  std::vector<std::vector<int32_t> > refit_levels_;
+  // pre-order of all nodes for RefitAll, invalid after restructuring
+  std::vector<int32_t> refit_order_;
+  bool refit_order_valid_;
+
+  // scratch of QueryFrustum: leaves still crossing a plane, tested in batch
+  mutable BoxArray query_boxes_;
+  mutable std::vector<int32_t> query_leaves_;
+  mutable std::vector<uint8_t> query_visible_;
+
+  int32_t AllocateNode();
+
+  void FreeNode(int32_t node);
+
+  // place a detached leaf next to the sibling that adds the least area
+  void InsertLeaf(int32_t leaf);
+
+  // detach a leaf, its parent is freed
+  void RemoveLeaf(int32_t leaf);
+
+  // fit boxes and heights from node up to the root, rotating on the way
+  void RefitAncestors(int32_t node);
+
+  void FitNode(int32_t node);
+
+  /**
+   * Swap a child of node with a grandchild if that shrinks the surface of
+   * the grandchild's parent (Kopta et al.), the box of node stays the same
+   */
+  void Rotate(int32_t node);
+
+  /**
+   * Build a subtree over leaves with the binned surface area heuristic
+   *
+   * @param items   boxes of the subtree, reordered
+   * @param count   number of boxes
+   * @param proxies receives the leaf of every box
+   * @returns root of the subtree
+   */
+  int32_t BuildRange(BuildItem *items, size_t count,
+                     std::vector<ProxyId> *proxies);
+
+  void CollectLeaves(int32_t node, std::vector<uint32_t> *values) const;
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_SCENE_BVH_H
@@ -0,0 +1,103 @@
+#include "scene/culling.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace oncgl {
+
+namespace {
+
+size_t PaddedSize(size_t count) {
+  return (count + 3) & ~(size_t) 3;
+}
+
+} // namespace
+
+void BoxArray::Resize(size_t count) {
+
+  size_t padded = PaddedSize(count);
+  center_x.resize(padded, 0.0f);
+  center_y.resize(padded, 0.0f);
+  center_z.resize(padded, 0.0f);
+  extent_x.resize(padded, 0.0f);
+  extent_y.resize(padded, 0.0f);
+  extent_z.resize(padded, 0.0f);
+  count_ = count;
+}
+
+size_t BoxArray::size() const {
+  return center_x.empty() ? 0 : count_;
+}
+
+void BoxArray::Set(size_t index, const glm::vec3 &center,
+                   const glm::vec3 &extents) {
+
+  center_x[ index ] = center.x;
+  center_y[ index ] = center.y;
+  center_z[ index ] = center.z;
+  extent_x[ index ] = extents.x;
+  extent_y[ index ] = extents.y;
+  extent_z[ index ] = extents.z;
+}
+
+size_t CullBoxes(const Frustum &frustum, const BoxArray &boxes, size_t begin,
+                 size_t end, uint8_t *visible) {
+
+  size_t num_visible = 0;
+
+#ifdef __SSE__
+  // a box is outside if it is completely behind one plane:
+  // dot(n, center) + d + dot(abs(n), extents) < 0
+  for (size_t i = begin; i < end; i += 4) {
+    __m128 cx = _mm_loadu_ps(&boxes.center_x[ i ]);
+    __m128 cy = _mm_loadu_ps(&boxes.center_y[ i ]);
+    __m128 cz = _mm_loadu_ps(&boxes.center_z[ i ]);
+    __m128 ex = _mm_loadu_ps(&boxes.extent_x[ i ]);
+    __m128 ey = _mm_loadu_ps(&boxes.extent_y[ i ]);
+    __m128 ez = _mm_loadu_ps(&boxes.extent_z[ i ]);
+    __m128 outside = _mm_setzero_ps();
+
+    for (int p = 0; p < Frustum::NUM_PLANES; p++) {
+      const glm::vec4 &plane = frustum.planes[ p ];
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)),
+                     _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)),
+                     _mm_set1_ps(plane.w)));
+      __m128 radius = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(glm::abs(plane.x))),
+                     _mm_mul_ps(ey, _mm_set1_ps(glm::abs(plane.y)))),
+          _mm_mul_ps(ez, _mm_set1_ps(glm::abs(plane.z))));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius),
+                                                _mm_setzero_ps()));
+    }
+
+    int mask = _mm_movemask_ps(outside);
+    for (size_t j = 0; j < 4 && i + j < end; j++) {
+      visible[ i + j ] = (mask >> j) & 1 ? 0 : 1;
+      num_visible += visible[ i + j ];
+    }
+  }
+#else
+  for (size_t i = begin; i < end; i++) {
+    bool inside = true;
+    for (int p = 0; p < Frustum::NUM_PLANES && inside; p++) {
+      const glm::vec4 &plane = frustum.planes[ p ];
+      float distance = plane.x * boxes.center_x[ i ] +
+          plane.y * boxes.center_y[ i ] + plane.z * boxes.center_z[ i ] +
+          plane.w;
+      float radius = glm::abs(plane.x) * boxes.extent_x[ i ] +
+          glm::abs(plane.y) * boxes.extent_y[ i ] +
+          glm::abs(plane.z) * boxes.extent_z[ i ];
+      inside = distance + radius >= 0.0f;
+    }
+    visible[ i ] = inside ? 1 : 0;
+    num_visible += visible[ i ];
+  }
+#endif
+
+  return num_visible;
+}
+
+} // namespace oncgl
@@ -0,0 +1,58 @@
+#ifndef ONCGL_SCENE_CULLING_H
+#define ONCGL_SCENE_CULLING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera/frustum.h"
+
+namespace oncgl {
+
+/**
+ * World space boxes (center and half extents) as structure of arrays
+ * The arrays are padded to a multiple of four, so the culling loop always
+ * works on full SSE registers.
+ */
+struct BoxArray {
+
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> extent_x;
+  std::vector<float> extent_y;
+  std::vector<float> extent_z;
+
+  /**
+   * @param count   number of boxes, existing boxes are kept
+   */
+  void Resize(size_t count);
+
+  size_t size() const;
+
+  void Set(size_t index, const glm::vec3 &center, const glm::vec3 &extents);
+
+ private:
+  size_t count_;
+};
+
+/**
+ * Test a range of boxes against a frustum, four boxes per iteration (SSE)
+ * Bvh::QueryFrustum tests the leaves of the subtrees crossing a plane with it.
+ *
+ * @param frustum   frustum to test against
+ * @param boxes     boxes to test
+ * @param begin     first box, must be a multiple of 4
+ * @param end       one past the last box
+ * @param visible   receives 1 for boxes intersecting the frustum, else 0
+ * @returns number of visible boxes in the range
+ */
+size_t CullBoxes(const Frustum &frustum, const BoxArray &boxes, size_t begin,
+                 size_t end, uint8_t *visible);
+
+} // namespace oncgl
+
+#endif // ONCGL_SCENE_CULLING_H
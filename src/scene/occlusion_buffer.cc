@@ -0,0 +1,419 @@
+#include "scene/occlusion_buffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <future>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace oncgl {
+
+const int OcclusionBuffer::kTileWidth;
+const int OcclusionBuffer::kTileHeight;
+
+namespace {
+
+// smallest clip w of a vertex, closer vertices are treated as crossing the eye
+const float kMinW = 1e-4f;
+
+// triangles with less screen area in pixels are skipped
+const float kMinArea = 1e-3f;
+
+// all pixels of a tile covered
+const uint32_t kFullMask = 0xffffffffu;
+
+// tile rows rasterized per task at least
+const int kMinBandRows = 4;
+
+struct ScreenVertex {
+
+  float x, y, z;
+};
+
+/**
+ * Coverage of a tile, bit (row * kTileWidth + column) is set if the center
+ * of that pixel is inside all three edges
+ *
+ * @param edges   edge functions of the triangle, silhouettes moved inward by
+ *                half a pixel so a covered center means a covered pixel
+ * @param x       left pixel of the tile
+ * @param y       bottom pixel of the tile
+ */
+uint32_t TileCoverage(const float (&edges)[ 3 ][ 3 ], float x, float y) {
+
+  uint32_t mask = 0;
+
+#ifdef __SSE__
+  __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  __m128 e_row[ 3 ];
+  __m128 e_step_y[ 3 ];
+  __m128 e_step_x[ 3 ];
+  for (int i = 0; i < 3; ++i) {
+    __m128 a = _mm_set1_ps(edges[ i ][ 0 ]);
+    e_row[ i ] = _mm_add_ps(
+        _mm_mul_ps(a, _mm_add_ps(_mm_set1_ps(x), lanes)),
+        _mm_set1_ps(edges[ i ][ 1 ] * (y + 0.5f) + edges[ i ][ 2 ]));
+    e_step_y[ i ] = _mm_set1_ps(edges[ i ][ 1 ]);
+    e_step_x[ i ] = _mm_set1_ps(edges[ i ][ 0 ] * 4.0f);
+  }
+
+  for (int row = 0; row < OcclusionBuffer::kTileHeight; ++row) {
+    for (int half = 0; half < 2; ++half) {
+      __m128 e0 = e_row[ 0 ], e1 = e_row[ 1 ], e2 = e_row[ 2 ];
+      if (half) {
+        e0 = _mm_add_ps(e0, e_step_x[ 0 ]);
+        e1 = _mm_add_ps(e1, e_step_x[ 1 ]);
+        e2 = _mm_add_ps(e2, e_step_x[ 2 ]);
+      }
+      // the sign bit of the smallest edge is set outside
+      int outside = _mm_movemask_ps(_mm_min_ps(_mm_min_ps(e0, e1), e2));
+      mask |= static_cast<uint32_t>(~outside & 0xf)
+              << (row * OcclusionBuffer::kTileWidth + half * 4);
+    }
+    for (int i = 0; i < 3; ++i) {
+      e_row[ i ] = _mm_add_ps(e_row[ i ], e_step_y[ i ]);
+    }
+  }
+#else
+  for (int row = 0; row < OcclusionBuffer::kTileHeight; ++row) {
+    float py = y + row + 0.5f;
+    for (int column = 0; column < OcclusionBuffer::kTileWidth; ++column) {
+      float px = x + column + 0.5f;
+      bool inside = true;
+      for (int i = 0; i < 3 && inside; ++i) {
+        inside = edges[ i ][ 0 ] * px + edges[ i ][ 1 ] * py
+                 + edges[ i ][ 2 ] >= 0.0f;
+      }
+      if (inside) {
+        mask |= 1u << (row * OcclusionBuffer::kTileWidth + column);
+      }
+    }
+  }
+#endif
+
+  return mask;
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : tiles_x_(std::max(1, (width + kTileWidth - 1) / kTileWidth)),
+      tiles_y_(std::max(1, (height + kTileHeight - 1) / kTileHeight)),
+      view_projection_(1.0f),
+      far_depths_(tiles_x_ * tiles_y_, 1.0f),
+      layer_depths_(tiles_x_ * tiles_y_, 0.0f),
+      layer_masks_(tiles_x_ * tiles_y_, 0),
+      num_triangles_(0) {
+}
+
+void OcclusionBuffer::Begin(const glm::mat4 &view_projection) {
+
+  view_projection_ = view_projection;
+  std::fill(far_depths_.begin(), far_depths_.end(), 1.0f);
+  std::fill(layer_depths_.begin(), layer_depths_.end(), 0.0f);
+  std::fill(layer_masks_.begin(), layer_masks_.end(), 0);
+  num_triangles_ = 0;
+}
+
+void OcclusionBuffer::RenderOccluders(const std::vector<Occluder> &occluders,
+                                      ThreadPool *pool) {
+
+  triangles_.clear();
+  for (size_t i = 0; i < occluders.size(); ++i) {
+    SetupTriangles(occluders[ i ]);
+  }
+  if (triangles_.empty()) {
+    return;
+  }
+  num_triangles_ += triangles_.size();
+
+  // bands of tile rows never share a tile, so they need no locking
+  int num_bands = 1;
+  if (pool != NULL) {
+    num_bands = std::min(static_cast<int>(pool->size()) + 1,
+                         std::max(1, tiles_y_ / kMinBandRows));
+  }
+  int rows_per_band = (tiles_y_ + num_bands - 1) / num_bands;
+
+  std::vector<std::future<void> > bands;
+  for (int first = rows_per_band; first < tiles_y_; first += rows_per_band) {
+    int end = std::min(first + rows_per_band, tiles_y_);
+    bands.push_back(pool->Submit([this, first, end]() {
+      RasterizeBand(first, end);
+    }));
+  }
+  RasterizeBand(0, std::min(rows_per_band, tiles_y_));
+  for (size_t i = 0; i < bands.size(); ++i) {
+    bands[ i ].get();
+  }
+}
+
+bool OcclusionBuffer::TestBox(const glm::vec3 &min,
+                              const glm::vec3 &max) const {
+
+  if (num_triangles_ == 0) {
+    return true;
+  }
+
+  float min_x = FLT_MAX, min_y = FLT_MAX, min_z = FLT_MAX;
+  float max_x = -FLT_MAX, max_y = -FLT_MAX;
+  for (int i = 0; i < 8; ++i) {
+    glm::vec4 clip = view_projection_ * glm::vec4(i & 1 ? max.x : min.x,
+                                                  i & 2 ? max.y : min.y,
+                                                  i & 4 ? max.z : min.z, 1.0f);
+    // the box reaches the near plane, it may cover everything
+    if (clip.w < kMinW || clip.z < -clip.w) {
+      return true;
+    }
+    float inverse_w = 1.0f / clip.w;
+    float x = (clip.x * inverse_w * 0.5f + 0.5f) * width();
+    float y = (clip.y * inverse_w * 0.5f + 0.5f) * height();
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_z = std::min(min_z, clip.z * inverse_w * 0.5f + 0.5f);
+  }
+
+  float w = static_cast<float>(width());
+  float h = static_cast<float>(height());
+  if (max_x < 0.0f || max_y < 0.0f || min_x > w || min_y > h) {
+    // off screen, left to the frustum test
+    return true;
+  }
+
+  int tile_min_x = static_cast<int>(std::max(min_x, 0.0f)) / kTileWidth;
+  int tile_min_y = static_cast<int>(std::max(min_y, 0.0f)) / kTileHeight;
+  int tile_max_x = std::min(
+      tiles_x_ - 1, static_cast<int>(std::min(max_x, w)) / kTileWidth);
+  int tile_max_y = std::min(
+      tiles_y_ - 1, static_cast<int>(std::min(max_y, h)) / kTileHeight);
+
+#ifdef __SSE__
+  __m128 box_z = _mm_set1_ps(min_z);
+#endif
+  for (int y = tile_min_y; y <= tile_max_y; ++y) {
+    const float *row = &far_depths_[ y * tiles_x_ ];
+    int x = tile_min_x;
+#ifdef __SSE__
+    for (; x + 4 <= tile_max_x + 1; x += 4) {
+      if (_mm_movemask_ps(_mm_cmplt_ps(box_z, _mm_loadu_ps(row + x)))) {
+        return true;
+      }
+    }
+#endif
+    for (; x <= tile_max_x; ++x) {
+      if (min_z < row[ x ]) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+float OcclusionBuffer::ScreenSize(const glm::vec3 &center,
+                                  float radius) const {
+
+  float w = (view_projection_ * glm::vec4(center, 1.0f)).w;
+  if (w <= radius) {
+    return FLT_MAX;
+  }
+  return radius / w;
+}
+
+int OcclusionBuffer::width() const {
+  return tiles_x_ * kTileWidth;
+}
+
+int OcclusionBuffer::height() const {
+  return tiles_y_ * kTileHeight;
+}
+
+float OcclusionBuffer::tile_depth(int tile_x, int tile_y) const {
+  return far_depths_[ tile_y * tiles_x_ + tile_x ];
+}
+
+size_t OcclusionBuffer::num_triangles() const {
+  return num_triangles_;
+}
+
+void OcclusionBuffer::SetupTriangles(const Occluder &occluder) {
+
+  const OccluderMesh &mesh = *occluder.mesh;
+  glm::mat4 transform = view_projection_ * occluder.transform;
+
+  std::vector<ScreenVertex> vertices(mesh.positions.size());
+  std::vector<bool> clipped(mesh.positions.size());
+  float w = static_cast<float>(width());
+  float h = static_cast<float>(height());
+  for (size_t i = 0; i < mesh.positions.size(); ++i) {
+    glm::vec4 clip = transform * glm::vec4(mesh.positions[ i ], 1.0f);
+    clipped[ i ] = clip.w < kMinW || clip.z < -clip.w;
+    if (!clipped[ i ]) {
+      float inverse_w = 1.0f / clip.w;
+      vertices[ i ].x = (clip.x * inverse_w * 0.5f + 0.5f) * w;
+      vertices[ i ].y = (clip.y * inverse_w * 0.5f + 0.5f) * h;
+      vertices[ i ].z = std::min(clip.z * inverse_w * 0.5f + 0.5f, 1.0f);
+    }
+  }
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    GLuint i0 = mesh.indices[ i ];
+    GLuint i1 = mesh.indices[ i + 1 ];
+    GLuint i2 = mesh.indices[ i + 2 ];
+    // no near plane clipping, a missing occluder only costs efficiency
+    if (clipped[ i0 ] || clipped[ i1 ] || clipped[ i2 ]) {
+      continue;
+    }
+
+    ScreenVertex v0 = vertices[ i0 ];
+    ScreenVertex v1 = vertices[ i1 ];
+    ScreenVertex v2 = vertices[ i2 ];
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::fabs(area) < kMinArea) {
+      continue;
+    }
+    // vertices opposite of the edges v0 v1, v1 v2 and v2 v0
+    GLuint opposite[ 3 ] = { kNoOccluderNeighbor, kNoOccluderNeighbor,
+                             kNoOccluderNeighbor };
+    if (!mesh.neighbors.empty()) {
+      for (int e = 0; e < 3; ++e) {
+        opposite[ e ] = mesh.neighbors[ i + e ];
+      }
+    }
+    // the geometry pass draws both faces, make every triangle counterclockwise
+    if (area < 0.0f) {
+      std::swap(v1, v2);
+      std::swap(opposite[ 0 ], opposite[ 2 ]);
+      area = -area;
+    }
+
+    float min_x = std::min(v0.x, std::min(v1.x, v2.x));
+    float max_x = std::max(v0.x, std::max(v1.x, v2.x));
+    float min_y = std::min(v0.y, std::min(v1.y, v2.y));
+    float max_y = std::max(v0.y, std::max(v1.y, v2.y));
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= w || min_y >= h) {
+      continue;
+    }
+
+    Triangle triangle;
+    triangle.tile_min_x =
+        static_cast<int>(std::max(min_x, 0.0f)) / kTileWidth;
+    triangle.tile_min_y =
+        static_cast<int>(std::max(min_y, 0.0f)) / kTileHeight;
+    triangle.tile_max_x = std::min(
+        tiles_x_ - 1, static_cast<int>(std::min(max_x, w)) / kTileWidth);
+    triangle.tile_max_y = std::min(
+        tiles_y_ - 1, static_cast<int>(std::min(max_y, h)) / kTileHeight);
+
+    const ScreenVertex *corners[ 3 ] = { &v0, &v1, &v2 };
+    for (int e = 0; e < 3; ++e) {
+      const ScreenVertex &a = *corners[ e ];
+      const ScreenVertex &b = *corners[ (e + 1) % 3 ];
+      float edge_a = a.y - b.y;
+      float edge_b = b.x - a.x;
+      float edge_c = a.x * b.y - b.x * a.y;
+      triangle.edges[ e ][ 0 ] = edge_a;
+      triangle.edges[ e ][ 1 ] = edge_b;
+      triangle.edges[ e ][ 2 ] = edge_c;
+
+      // an edge with a rasterized neighbour on its other side is inside the
+      // occluder, the pixel centers decide like on the GPU and the two
+      // triangles leave no gap between them
+      GLuint o = opposite[ e ];
+      if (o != kNoOccluderNeighbor && !clipped[ o ] &&
+          edge_a * vertices[ o ].x + edge_b * vertices[ o ].y + edge_c <
+          -kMinArea) {
+        continue;
+      }
+      // a silhouette is moved inward by the half pixel extent along its
+      // normal, only pixels completely inside count as covered
+      triangle.edges[ e ][ 2 ] -=
+          0.5f * (std::fabs(edge_a) + std::fabs(edge_b));
+    }
+
+    float dz1 = v1.z - v0.z;
+    float dz2 = v2.z - v0.z;
+    triangle.depth[ 0 ] =
+        (dz1 * (v2.y - v0.y) - dz2 * (v1.y - v0.y)) / area;
+    triangle.depth[ 1 ] =
+        (dz2 * (v1.x - v0.x) - dz1 * (v2.x - v0.x)) / area;
+    triangle.depth[ 2 ] =
+        v0.z - triangle.depth[ 0 ] * v0.x - triangle.depth[ 1 ] * v0.y;
+    triangle.max_depth = std::max(v0.z, std::max(v1.z, v2.z));
+
+    triangles_.push_back(triangle);
+  }
+}
+
+void OcclusionBuffer::RasterizeBand(int first_row, int end_row) {
+
+  for (size_t t = 0; t < triangles_.size(); ++t) {
+    const Triangle &triangle = triangles_[ t ];
+    int min_y = std::max(triangle.tile_min_y, first_row);
+    int max_y = std::min(triangle.tile_max_y, end_row - 1);
+
+    for (int y = min_y; y <= max_y; ++y) {
+      float pixel_y = static_cast<float>(y * kTileHeight);
+      // far corner of the tile for the depth plane
+      float far_y = triangle.depth[ 1 ] > 0.0f ? pixel_y + kTileHeight
+                                               : pixel_y;
+
+      for (int x = triangle.tile_min_x; x <= triangle.tile_max_x; ++x) {
+        float pixel_x = static_cast<float>(x * kTileWidth);
+        uint32_t mask = TileCoverage(triangle.edges, pixel_x, pixel_y);
+        if (mask == 0) {
+          continue;
+        }
+        float far_x = triangle.depth[ 0 ] > 0.0f ? pixel_x + kTileWidth
+                                                 : pixel_x;
+        float depth = std::min(triangle.max_depth,
+                               triangle.depth[ 0 ] * far_x
+                               + triangle.depth[ 1 ] * far_y
+                               + triangle.depth[ 2 ]);
+        UpdateTile(y * tiles_x_ + x, mask, depth);
+      }
+    }
+  }
+}
+
+void OcclusionBuffer::UpdateTile(size_t tile, uint32_t mask, float depth) {
+
+  float &far_depth = far_depths_[ tile ];
+  if (depth >= far_depth) {
+    return;
+  }
+
+  float &layer_depth = layer_depths_[ tile ];
+  uint32_t &layer_mask = layer_masks_[ tile ];
+
+  if (mask == kFullMask) {
+    far_depth = depth;
+    if (layer_depth >= far_depth) {
+      layer_depth = 0.0f;
+      layer_mask = 0;
+    }
+    return;
+  }
+
+  // a triangle far in front of the working layer starts a new one, merging
+  // would push the layer towards the committed depth and gain nothing
+  if (layer_mask != 0 && layer_depth - depth > far_depth - layer_depth) {
+    layer_depth = 0.0f;
+    layer_mask = 0;
+  }
+
+  layer_depth = std::max(layer_depth, depth);
+  layer_mask |= mask;
+  if (layer_mask == kFullMask) {
+    far_depth = std::min(far_depth, layer_depth);
+    layer_depth = 0.0f;
+    layer_mask = 0;
+  }
+}
+
+} // namespace oncgl
@@ -0,0 +1,134 @@
+#ifndef ONCGL_SCENE_OCCLUSION_BUFFER_H
+#define ONCGL_SCENE_OCCLUSION_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "misc/thread_pool.h"
+#include "model/objects.h"
+
+namespace oncgl {
+
+/**
+ * Low resolution depth buffer rasterized on the CPU, to skip meshes hidden
+ * behind large occluders
+ *
+ * The buffer is split into tiles of 8x4 pixels and stores no per pixel depth.
+ * Every tile keeps a conservative far depth for all its pixels and a working
+ * layer: a 32 bit coverage mask with the farthest depth of the covered pixels
+ * (masked occlusion culling, Andersson et al.). When the mask is full the
+ * working layer becomes the new far depth. Along the silhouettes of an
+ * occluder a pixel only counts as covered if it is completely inside, a
+ * buffer pixel spans several screen pixels and must not hide what peeks past
+ * the edge. Edges shared by two triangles on either side are sampled at the
+ * pixel centers, so the inside of an occluder has no seams (see
+ * OccluderMesh::neighbors). Occluders are rasterized with SSE, one tile row
+ * of four pixels per instruction, in horizontal bands on the thread pool.
+ * Occludees are tested by their screen rectangle and nearest depth against
+ * the far depths of the tiles.
+ * Does not touch OpenGL.
+ */
+class OcclusionBuffer {
+ public:
+  static const int kTileWidth = 8;
+  static const int kTileHeight = 4;
+
+  struct Occluder {
+
+    const OccluderMesh *mesh;
+    glm::mat4 transform;
+  };
+
+  /**
+   * @param width   width in pixels, rounded up to whole tiles
+   * @param height  height in pixels, rounded up to whole tiles
+   */
+  OcclusionBuffer(int width, int height);
+
+  /**
+   * Clear the buffer and set the camera for the next occluders and tests
+   *
+   * @param view_projection   projection * view, e.g. Camera::matrix()
+   */
+  void Begin(const glm::mat4 &view_projection);
+
+  /**
+   * Rasterize occluders, triangles crossing the near plane are skipped
+   *
+   * @param occluders   meshes and their world transforms
+   * @param pool        pool the bands are rasterized on
+   */
+  void RenderOccluders(const std::vector<Occluder> &occluders,
+                       ThreadPool *pool = &ThreadPool::Instance());
+
+  /**
+   * Test a world space box against the occluders
+   *
+   * @returns false - if the box is completely hidden, otherwise true
+   */
+  bool TestBox(const glm::vec3 &min, const glm::vec3 &max) const;
+
+  /**
+   * Projected size of a sphere, its radius relative to its view depth
+   * Used to pick occluders that cover a large part of the screen.
+   */
+  float ScreenSize(const glm::vec3 &center, float radius) const;
+
+  int width() const;
+
+  int height() const;
+
+  // conservative far depth of a tile, in [0, 1]
+  float tile_depth(int tile_x, int tile_y) const;
+
+  // triangles rasterized since Begin
+  size_t num_triangles() const;
+
+ private:
+  // screen space triangle ready for rasterization
+  struct Triangle {
+
+    // edge functions a * x + b * y + c, >= 0 inside
+    float edges[ 3 ][ 3 ];
+    // depth plane z = a * x + b * y + c
+    float depth[ 3 ];
+    float max_depth;
+    // tile rectangle, inclusive
+    int tile_min_x, tile_min_y, tile_max_x, tile_max_y;
+  };
+
+  int tiles_x_;
+  int tiles_y_;
+  glm::mat4 view_projection_;
+
+  // per tile, structure of arrays so TestBox can compare four tiles at once
+  std::vector<float> far_depths_;
+  std::vector<float> layer_depths_;
+  std::vector<uint32_t> layer_masks_;
+
+  std::vector<Triangle> triangles_;
+  size_t num_triangles_;
+
+  /**
+   * Set up the triangles of an occluder
+   */
+  void SetupTriangles(const Occluder &occluder);
+
+  /**
+   * Rasterize all set up triangles into the tile rows [first_row, end_row)
+   */
+  void RasterizeBand(int first_row, int end_row);
+
+  /**
+   * Merge the coverage of a triangle into a tile
+   */
+  void UpdateTile(size_t tile, uint32_t mask, float depth);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_SCENE_OCCLUSION_BUFFER_H
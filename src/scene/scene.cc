@@ -0,0 +1,508 @@
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <utility>
+
+#include "renderer/gl_state.h"
+
+namespace oncgl {
+
+namespace {
+
+// leaves of the hierarchy are enlarged by this, so small moves are free
+const float kBvhMargin = 0.1f;
+
+// up to one in this many entries moved, their leaves are moved one by one
+// and the tree is restructured
+const size_t kMoveDivisor = 64;
+
+// up to one in this many entries moved, only their ancestors are refitted,
+// beyond that one pass over the whole tree is cheaper
+const size_t kRefitDivisor = 10;
+
+// visible entries larger than this on screen (radius / depth) are occluders
+const float kMinOccluderSize = 0.1f;
+
+// occluders drawn per frame at most, the largest win
+const size_t kMaxOccluders = 32;
+
+// entries tested against the occlusion buffer per task
+const size_t kOcclusionTestChunk = 4096;
+
+} // namespace
+
+const GLint Scene::kWorldTransformTextureUnit;
+const GLint Scene::kInstanceNodeTextureUnit;
+
+Scene::Scene() :
+    num_instances_(0),
+    world_buffer_(0),
+    world_texture_(0),
+    world_capacity_(0),
+    node_buffer_(0),
+    node_texture_(0),
+    node_capacity_(0),
+    nodes_dirty_(false),
+    bvh_(kBvhMargin) {
+
+  cull_stats_.tested = 0;
+  cull_stats_.visible = 0;
+  cull_stats_.occluded = 0;
+  cull_stats_.occluders = 0;
+}
+
+Scene::~Scene() {
+
+  if (world_texture_) {
+    GLState::Instance().DeleteTextures(1, &world_texture_);
+    glDeleteBuffers(1, &world_buffer_);
+  }
+  if (node_texture_) {
+    GLState::Instance().DeleteTextures(1, &node_texture_);
+    glDeleteBuffers(1, &node_buffer_);
+  }
+}
+
+Scene::AssetId Scene::AddAsset(const Model &model) {
+
+  Asset asset(model);
+  asset.mesh_nodes.resize(model.num_meshes());
+  asset.mesh_instances.resize(model.num_meshes());
+  asset.first_nodes.resize(model.num_meshes(), 0);
+  asset.visible_nodes.resize(model.num_meshes(), 0);
+  assets_.push_back(asset);
+  return assets_.size() - 1;
+}
+
+Scene::InstanceId Scene::AddInstance(AssetId asset_id,
+                                     const glm::mat4 &transform,
+                                     InstanceId parent) {
+
+  Asset &asset = assets_[ asset_id ];
+  InstanceId root = graph_.AddNode(parent, transform);
+
+  // the model's own hierarchy hangs below the instance node
+  const std::vector<ModelNode> &model_nodes = asset.model.nodes();
+  std::vector<SceneGraph::NodeId> ids(model_nodes.size());
+  for (size_t i = 0; i < model_nodes.size(); i++) {
+    const ModelNode &model_node = model_nodes[ i ];
+    SceneGraph::NodeId node_parent = model_node.parent < 0 ?
+                                     root : ids[ model_node.parent ];
+    ids[ i ] = graph_.AddNode(node_parent, model_node.transform);
+
+    for (size_t j = 0; j < model_node.meshes.size(); j++) {
+      asset.mesh_nodes[ model_node.meshes[ j ]].push_back(ids[ i ]);
+      asset.mesh_instances[ model_node.meshes[ j ]].push_back(root);
+    }
+  }
+
+  // models without hierarchy draw all meshes at the instance
+  if (model_nodes.empty()) {
+    for (size_t j = 0; j < asset.mesh_nodes.size(); j++) {
+      asset.mesh_nodes[ j ].push_back(root);
+      asset.mesh_instances[ j ].push_back(root);
+    }
+  }
+
+  num_instances_++;
+  nodes_dirty_ = true;
+  return root;
+}
+
+void Scene::set_transform(InstanceId instance, const glm::mat4 &transform) {
+  graph_.set_local(instance, transform);
+}
+
+glm::mat4 Scene::transform(InstanceId instance) const {
+  return graph_.local(instance);
+}
+
+void Scene::Update() {
+
+  SceneGraph::NodeId first, last;
+  bool moved = graph_.Update(&first, &last, &changed_nodes_);
+  if (moved) {
+    UploadWorldTransforms(first, last);
+  }
+
+  if (nodes_dirty_) {
+    BuildEntries();
+    nodes_dirty_ = false;
+  } else if (moved) {
+    UpdateEntryBounds(changed_nodes_);
+  }
+}
+
+void Scene::Cull(const Frustum *frustum, OcclusionBuffer *occlusion) {
+
+  size_t count = entry_nodes_.size();
+  cull_stats_.tested = count;
+  cull_stats_.occluded = 0;
+  cull_stats_.occluders = 0;
+  if (frustum) {
+    std::fill(entry_visible_.begin(), entry_visible_.end(), 0);
+    query_entries_.clear();
+    bvh_.QueryFrustum(*frustum, &query_entries_);
+    for (size_t i = 0; i < query_entries_.size(); i++) {
+      entry_visible_[ query_entries_[ i ]] = 1;
+    }
+    cull_stats_.visible = query_entries_.size();
+    if (occlusion) {
+      CullOccluded(occlusion);
+    }
+  } else {
+    std::fill(entry_visible_.begin(), entry_visible_.end(), 1);
+    cull_stats_.visible = count;
+  }
+
+  // move the visible nodes of every mesh to the front of its range, so the
+  // offsets of the draws stay the same
+  for (size_t i = 0; i < assets_.size(); i++) {
+    Asset &asset = assets_[ i ];
+    for (size_t j = 0; j < asset.mesh_nodes.size(); j++) {
+      size_t begin = asset.first_nodes[ j ];
+      size_t end = begin + asset.mesh_nodes[ j ].size();
+      size_t visible = begin;
+      for (size_t k = begin; k < end; k++) {
+        if (entry_visible_[ k ]) {
+          visible_nodes_[ visible++ ] = entry_nodes_[ k ];
+        }
+      }
+      asset.visible_nodes[ j ] = visible - begin;
+    }
+  }
+
+  UploadInstanceNodes();
+}
+
+void Scene::CullOccluded(OcclusionBuffer *occlusion) {
+
+  // the entries of the last frustum query are the visible ones
+  std::vector<std::pair<float, uint32_t> > candidates;
+  for (size_t i = 0; i < query_entries_.size(); i++) {
+    uint32_t entry = query_entries_[ i ];
+    if (!entry_occluders_[ entry ]) {
+      continue;
+    }
+    const Bounds &bounds = entry_world_bounds_[ entry ];
+    float size = occlusion->ScreenSize(bounds.center(), bounds.radius);
+    if (size > kMinOccluderSize) {
+      candidates.push_back(std::make_pair(size, entry));
+    }
+  }
+  if (candidates.empty()) {
+    return;
+  }
+  if (candidates.size() > kMaxOccluders) {
+    std::partial_sort(candidates.begin(), candidates.begin() + kMaxOccluders,
+                      candidates.end(),
+                      std::greater<std::pair<float, uint32_t> >());
+    candidates.resize(kMaxOccluders);
+  }
+
+  std::vector<OcclusionBuffer::Occluder> occluders(candidates.size());
+  for (size_t i = 0; i < candidates.size(); i++) {
+    uint32_t entry = candidates[ i ].second;
+    occluders[ i ].mesh = entry_occluders_[ entry ];
+    occluders[ i ].transform = graph_.world(entry_nodes_[ entry ]);
+    // an occluder is never hidden, not even behind its own triangles
+    entry_visible_[ entry ] = 2;
+  }
+  occlusion->RenderOccluders(occluders);
+  cull_stats_.occluders = occluders.size();
+
+  const OcclusionBuffer &buffer = *occlusion;
+  auto test = [this, &buffer](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t entry = query_entries_[ i ];
+      const Bounds &bounds = entry_world_bounds_[ entry ];
+      if (entry_visible_[ entry ] == 1
+          && !buffer.TestBox(bounds.min, bounds.max)) {
+        entry_visible_[ entry ] = 0;
+      }
+    }
+  };
+
+  // every task writes only the flags of its own entries
+  ThreadPool &pool = ThreadPool::Instance();
+  std::vector<std::future<void> > chunks;
+  size_t count = query_entries_.size();
+  for (size_t begin = kOcclusionTestChunk; begin < count;
+       begin += kOcclusionTestChunk) {
+    size_t end = std::min(begin + kOcclusionTestChunk, count);
+    chunks.push_back(pool.Submit([test, begin, end]() { test(begin, end); }));
+  }
+  test(0, std::min(kOcclusionTestChunk, count));
+  for (size_t i = 0; i < chunks.size(); i++) {
+    chunks[ i ].get();
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (!entry_visible_[ query_entries_[ i ]]) {
+      cull_stats_.occluded++;
+    }
+  }
+  cull_stats_.visible -= cull_stats_.occluded;
+}
+
+bool Scene::Pick(const glm::vec3 &origin, const glm::vec3 &direction,
+                 float max_distance, InstanceId *instance,
+                 float *distance) const {
+
+  uint32_t entry;
+  if (!bvh_.Raycast(origin, direction, max_distance, &entry, distance)) {
+    return false;
+  }
+  *instance = entry_instances_[ entry ];
+  return true;
+}
+
+void Scene::BuildEntries() {
+
+  entry_nodes_.clear();
+  entry_instances_.clear();
+  entry_bounds_.clear();
+  entry_occluders_.clear();
+  for (size_t i = 0; i < assets_.size(); i++) {
+    Asset &asset = assets_[ i ];
+    for (size_t j = 0; j < asset.mesh_nodes.size(); j++) {
+      const std::vector<SceneGraph::NodeId> &nodes = asset.mesh_nodes[ j ];
+      asset.first_nodes[ j ] = entry_nodes_.size();
+      entry_nodes_.insert(entry_nodes_.end(), nodes.begin(), nodes.end());
+      entry_instances_.insert(entry_instances_.end(),
+                              asset.mesh_instances[ j ].begin(),
+                              asset.mesh_instances[ j ].end());
+      entry_bounds_.insert(entry_bounds_.end(), nodes.size(),
+                           asset.model.mesh(j)->bounds());
+      entry_occluders_.insert(entry_occluders_.end(), nodes.size(),
+                              asset.model.mesh(j)->occluder());
+    }
+  }
+
+  // entries per node, counted and then filled like a prefix sum
+  node_entry_offsets_.assign(graph_.size() + 1, 0);
+  for (size_t i = 0; i < entry_nodes_.size(); i++) {
+    node_entry_offsets_[ entry_nodes_[ i ] + 1 ]++;
+  }
+  for (size_t i = 1; i < node_entry_offsets_.size(); i++) {
+    node_entry_offsets_[ i ] += node_entry_offsets_[ i - 1 ];
+  }
+  node_entries_.resize(entry_nodes_.size());
+  std::vector<uint32_t> fill(node_entry_offsets_.begin(),
+                             node_entry_offsets_.end() - 1);
+  for (size_t i = 0; i < entry_nodes_.size(); i++) {
+    node_entries_[ fill[ entry_nodes_[ i ]]++ ] = i;
+  }
+
+  // an empty mesh gets empty world bounds and no leaf, it is never visible
+  entry_world_bounds_.resize(entry_nodes_.size());
+  for (size_t i = 0; i < entry_nodes_.size(); i++) {
+    entry_world_bounds_[ i ] = Bounds::Empty();
+    entry_world_bounds_[ i ].Merge(entry_bounds_[ i ],
+                                   graph_.world(entry_nodes_[ i ]));
+  }
+  // the entries are regrouped, so the hierarchy is built from scratch
+  bvh_.Build(entry_world_bounds_, &entry_proxies_);
+
+  entry_visible_.resize(entry_nodes_.size());
+  visible_nodes_.resize(entry_nodes_.size());
+}
+
+void Scene::UpdateEntryBounds(const std::vector<SceneGraph::NodeId> &nodes) {
+
+  // only the entries of the recomputed nodes, nodes added since the entries
+  // were built have none
+  std::vector<uint32_t> &moved = moved_entries_;
+  moved.clear();
+  for (size_t n = 0; n < nodes.size(); n++) {
+    SceneGraph::NodeId node = nodes[ n ];
+    if (node + 1 >= node_entry_offsets_.size()) {
+      continue;
+    }
+    for (uint32_t k = node_entry_offsets_[ node ];
+         k < node_entry_offsets_[ node + 1 ]; k++) {
+      uint32_t i = node_entries_[ k ];
+      if (entry_proxies_[ i ] == Bvh::kNoProxy) {
+        continue;
+      }
+      entry_world_bounds_[ i ] = Bounds::Empty();
+      entry_world_bounds_[ i ].Merge(entry_bounds_[ i ], graph_.world(node));
+      moved.push_back(i);
+    }
+  }
+
+  // moving leaves one by one walks up the tree and rotates for each of them,
+  // that only pays off for a few
+  if (moved.size() > entry_nodes_.size() / kRefitDivisor) {
+    bvh_.RefitAll(entry_world_bounds_);
+    return;
+  }
+  if (moved.size() > entry_nodes_.size() / kMoveDivisor) {
+    moved_proxies_.resize(moved.size());
+    for (size_t i = 0; i < moved.size(); i++) {
+      moved_proxies_[ i ] = entry_proxies_[ moved[ i ]];
+    }
+    bvh_.Refit(moved_proxies_, entry_world_bounds_);
+    return;
+  }
+  for (size_t i = 0; i < moved.size(); i++) {
+    bvh_.Move(entry_proxies_[ moved[ i ]], entry_world_bounds_[ moved[ i ]]);
+  }
+}
+
+void Scene::UploadWorldTransforms(SceneGraph::NodeId first,
+                                  SceneGraph::NodeId last) {
+
+  // every matrix is four RGBA32F texels, one per column
+  if (ReserveTextureBuffer(&world_buffer_, &world_texture_, GL_RGBA32F,
+                           &world_capacity_, graph_.size(),
+                           sizeof(glm::mat4))) {
+    first = 0;
+    last = graph_.size() - 1;
+  }
+
+  glBindBuffer(GL_TEXTURE_BUFFER, world_buffer_);
+  glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(glm::mat4),
+                  (last - first + 1) * sizeof(glm::mat4),
+                  graph_.world_matrices() + first);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Scene::UploadInstanceNodes() {
+
+  if (visible_nodes_.empty()) {
+    return;
+  }
+
+  ReserveTextureBuffer(&node_buffer_, &node_texture_, GL_R32UI,
+                       &node_capacity_, visible_nodes_.size(),
+                       sizeof(SceneGraph::NodeId));
+
+  // node ids grouped by asset and mesh, only the visible prefix of each
+  // group is read
+  glBindBuffer(GL_TEXTURE_BUFFER, node_buffer_);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0,
+                  visible_nodes_.size() * sizeof(SceneGraph::NodeId),
+                  &visible_nodes_[ 0 ]);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+bool Scene::ReserveTextureBuffer(GLuint *buffer, GLuint *texture,
+                                 GLenum internal_format, size_t *capacity,
+                                 size_t count, size_t element_size) {
+
+  if (count <= *capacity) {
+    return false;
+  }
+
+  if (!*texture) {
+    glGenBuffers(1, buffer);
+    glGenTextures(1, texture);
+  }
+
+  // grow by doubling, the texture has to be re-attached only then
+  *capacity = std::max(count, *capacity * 2);
+  glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+  glBufferData(GL_TEXTURE_BUFFER, *capacity * element_size, NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, *texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, internal_format, *buffer);
+  GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+  return true;
+}
+
+void Scene::Enqueue(RenderQueue *queue, unsigned int pass,
+                    Program *const programs[ NUM_VERTEX_FORMATS ],
+                    const glm::vec3 &eye, float far_plane) {
+
+  if (!world_texture_ || !node_texture_) {
+    return;
+  }
+
+  for (size_t i = 0; i < assets_.size(); i++) {
+    Asset &asset = assets_[ i ];
+    VertexFormat format = asset.model.vertex_format();
+
+    for (size_t j = 0; j < asset.mesh_nodes.size(); j++) {
+      GLsizei num_visible = asset.visible_nodes[ j ];
+      if (num_visible == 0) {
+        continue;
+      }
+
+      Mesh *mesh = asset.model.mesh(j);
+      SceneGraph::NodeId first = visible_nodes_[ asset.first_nodes[ j ]];
+      glm::vec3 position(graph_.world(first)[ 3 ]);
+      float depth = glm::length(position - eye) / far_plane;
+
+      DrawPacket packet;
+      packet.key = RenderQueue::MakeKey(pass, format, mesh->material_id(),
+                                        format, depth);
+      packet.program = programs[ format ];
+      packet.mesh = mesh;
+      packet.format = format;
+      packet.instance_offset = asset.first_nodes[ j ];
+      packet.num_instances = num_visible;
+      queue->Push(packet);
+    }
+  }
+}
+
+void Scene::BindTransforms(Program *program) const {
+
+  GLState &state = GLState::Instance();
+  state.BindTexture(kWorldTransformTextureUnit, GL_TEXTURE_BUFFER,
+                    world_texture_);
+  state.BindTexture(kInstanceNodeTextureUnit, GL_TEXTURE_BUFFER,
+                    node_texture_);
+  program->setUniform("worldTransforms", kWorldTransformTextureUnit);
+  program->setUniform("instanceNodes", kInstanceNodeTextureUnit);
+}
+
+void Scene::UnbindTransforms() const {
+
+  GLState &state = GLState::Instance();
+  state.BindTexture(kInstanceNodeTextureUnit, GL_TEXTURE_BUFFER, 0);
+  state.BindTexture(kWorldTransformTextureUnit, GL_TEXTURE_BUFFER, 0);
+}
+
+size_t Scene::num_assets() const {
+  return assets_.size();
+}
+
+size_t Scene::num_instances() const {
+  return num_instances_;
+}
+
+const Model &Scene::asset(AssetId asset) const {
+  return assets_[ asset ].model;
+}
+
+const SceneGraph &Scene::graph() const {
+  return graph_;
+}
+
+const Scene::CullStats &Scene::cull_stats() const {
+  return cull_stats_;
+}
+
+bool Scene::HasInstances(VertexFormat format) const {
+
+  for (size_t i = 0; i < assets_.size(); i++) {
+    const Asset &asset = assets_[ i ];
+    if (asset.model.vertex_format() != format) {
+      continue;
+    }
+    for (size_t j = 0; j < asset.mesh_nodes.size(); j++) {
+      if (!asset.mesh_nodes[ j ].empty()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+} // namespace oncgl
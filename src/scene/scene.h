@@ -0,0 +1,272 @@
+#ifndef ONCGL_SCENE_SCENE_H
+#define ONCGL_SCENE_SCENE_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "camera/frustum.h"
+#include "model/model.h"
+#include "renderer/render_queue.h"
+#include "scene/bvh.h"
+#include "scene/occlusion_buffer.h"
+#include "scene/scene_graph.h"
+#include "shader_program/shader_program.h"
+
+namespace oncgl {
+
+/**
+ * Models placed in the world
+ *
+ * A model (asset) is uploaded once and drawn at any number of places
+ * (instances). Every instance is a node of the SceneGraph with the nodes of
+ * the model file below it, so multi-part models keep their layout and
+ * instances can be attached to each other.
+ *
+ * The world transforms of the graph are uploaded as they are into one texture
+ * buffer (worldTransforms); only the range that changed is re-uploaded. A
+ * second buffer (instanceNodes) lists, per asset and mesh, the nodes the mesh
+ * is drawn at, so every mesh of an asset is one instanced draw call. The
+ * vertex shader reads its node at instanceOffset + gl_InstanceID.
+ *
+ * Every (mesh, node) pair keeps its box in world space in a Bvh. Cull queries
+ * it with the view frustum and uploads only the visible nodes, so culled
+ * instances cost neither a vertex nor a draw call; Pick uses the same
+ * hierarchy. Given an OcclusionBuffer, Cull also draws the largest visible
+ * meshes into it as occluders and drops the entries hidden behind them.
+ * Must only be used on the thread the OpenGL context is current on.
+ */
+class Scene {
+ public:
+  typedef size_t AssetId;
+  // root node of the instance in the scene graph
+  typedef SceneGraph::NodeId InstanceId;
+
+  // texture units the buffers are bound to while drawing
+  static const GLint kWorldTransformTextureUnit = 15;
+  static const GLint kInstanceNodeTextureUnit = 14;
+
+  /**
+   * Counters of the last Cull
+   */
+  struct CullStats {
+    // (mesh, node) pairs tested against the frustum
+    size_t tested;
+    // pairs inside the frustum and not occluded, drawn by the next Enqueue
+    size_t visible;
+    // pairs inside the frustum but hidden behind the occluders
+    size_t occluded;
+    // pairs drawn into the occlusion buffer
+    size_t occluders;
+  };
+
+  Scene();
+
+  ~Scene();
+
+  /**
+   * Add a model that can be instanced
+   *
+   * @param model   uploaded model, copies share the geometry
+   * @returns id of the asset
+   */
+  AssetId AddAsset(const Model &model);
+
+  /**
+   * Place an asset in the world
+   *
+   * @param asset       asset to place
+   * @param transform   transformation relative to the parent
+   * @param parent      parent instance, SceneGraph::kNoNode for the world
+   * @returns id of the instance
+   */
+  InstanceId AddInstance(AssetId asset, const glm::mat4 &transform,
+                         InstanceId parent = SceneGraph::kNoNode);
+
+  /**
+   * Move an instance relative to its parent, the instance and everything
+   * attached to it follow with the next Update
+   */
+  void set_transform(InstanceId instance, const glm::mat4 &transform);
+
+  glm::mat4 transform(InstanceId instance) const;
+
+  /**
+   * Recompute the moved parts of the scene graph, upload their transforms and
+   * move their world space boxes
+   */
+  void Update();
+
+  /**
+   * Select the instances to draw and upload their nodes
+   * Must be called after Update and before Enqueue.
+   *
+   * @param frustum   frustum of the camera in world space, NULL to draw
+   *                  everything
+   * @param occlusion buffer to cull occluded entries with, NULL to skip
+   *                  occlusion culling; Begin must have been called with the
+   *                  camera of the frustum
+   */
+  void Cull(const Frustum *frustum, OcclusionBuffer *occlusion = NULL);
+
+  /**
+   * Find the instance whose bounds a ray hits first
+   *
+   * @param origin        start of the ray
+   * @param direction     direction of the ray, normalized
+   * @param max_distance  length of the ray
+   * @param instance      receives the hit instance
+   * @param distance      receives the distance to the bounds of the hit
+   * @returns true - if an instance was hit, otherwise false
+   */
+  bool Pick(const glm::vec3 &origin, const glm::vec3 &direction,
+            float max_distance, InstanceId *instance, float *distance) const;
+
+  /**
+   * Add one draw packet per mesh and asset with visible instances to a render
+   * queue
+   * The depth of an instanced draw is the distance to its first visible
+   * instance.
+   *
+   * @param queue     queue to add the packets to
+   * @param pass      pass field of the sort keys
+   * @param programs  program for each vertex format
+   * @param eye       position of the camera
+   * @param far_plane distance that maps to the farthest depth key
+   */
+  void Enqueue(RenderQueue *queue, unsigned int pass,
+               Program *const programs[ NUM_VERTEX_FORMATS ],
+               const glm::vec3 &eye, float far_plane);
+
+  /**
+   * Bind the transform buffers to their texture units and point the samplers
+   * of the program to them
+   *
+   * @param program   program in use
+   */
+  void BindTransforms(Program *program) const;
+
+  void UnbindTransforms() const;
+
+  size_t num_assets() const;
+
+  size_t num_instances() const;
+
+  const Model &asset(AssetId asset) const;
+
+  const SceneGraph &graph() const;
+
+  /**
+   * @returns true - if at least one instance has the given vertex format
+   */
+  bool HasInstances(VertexFormat format) const;
+
+  const CullStats &cull_stats() const;
+
+ private:
+  struct Asset {
+
+    explicit Asset(const Model &model) : model(model) { }
+
+    Model model;
+    // per mesh the nodes it is drawn at
+    std::vector<std::vector<SceneGraph::NodeId> > mesh_nodes;
+    // per mesh the instance of each of its nodes
+    std::vector<std::vector<InstanceId> > mesh_instances;
+    // per mesh the position of its first node in the instance node buffer
+    std::vector<GLint> first_nodes;
+    // per mesh the number of nodes that passed the last Cull
+    std::vector<GLsizei> visible_nodes;
+  };
+
+  std::vector<Asset> assets_;
+  size_t num_instances_;
+  SceneGraph graph_;
+
+  GLuint world_buffer_;
+  GLuint world_texture_;
+  // in matrices
+  size_t world_capacity_;
+
+  GLuint node_buffer_;
+  GLuint node_texture_;
+  // in node ids
+  size_t node_capacity_;
+  // set when instances were added, the draw entries are rebuilt
+  bool nodes_dirty_;
+
+  // one entry per (mesh, node) pair, grouped by asset and mesh like the
+  // instance node buffer
+  std::vector<SceneGraph::NodeId> entry_nodes_;
+  std::vector<InstanceId> entry_instances_;
+  // bounds of the mesh of the entry, relative to its node
+  std::vector<Bounds> entry_bounds_;
+  // bounds of the entries in world space
+  std::vector<Bounds> entry_world_bounds_;
+  // hierarchy over the world bounds, the value of a leaf is its entry
+  Bvh bvh_;
+  std::vector<Bvh::ProxyId> entry_proxies_;
+  // entries of node n are node_entries_[ node_entry_offsets_[ n ] ..
+  // node_entry_offsets_[ n + 1 ]), so a move only visits its own entries
+  std::vector<uint32_t> node_entry_offsets_;
+  std::vector<uint32_t> node_entries_;
+  // scratch of Update: recomputed nodes, their entries and proxies
+  std::vector<SceneGraph::NodeId> changed_nodes_;
+  std::vector<uint32_t> moved_entries_;
+  std::vector<Bvh::ProxyId> moved_proxies_;
+  // CPU triangles of the mesh of the entry, NULL if it cannot occlude
+  std::vector<const OccluderMesh *> entry_occluders_;
+  // result of the frustum query per entry
+  std::vector<uint8_t> entry_visible_;
+  // scratch for the queries
+  mutable std::vector<uint32_t> query_entries_;
+  // visible nodes, each mesh's nodes start at its first_nodes
+  std::vector<SceneGraph::NodeId> visible_nodes_;
+  CullStats cull_stats_;
+
+  void UploadWorldTransforms(SceneGraph::NodeId first,
+                             SceneGraph::NodeId last);
+
+  /**
+   * Rebuild the draw entries after instances were added
+   */
+  void BuildEntries();
+
+  /**
+   * Move the world space bounds of the entries of the given nodes and update
+   * the hierarchy
+   *
+   * @param nodes   nodes whose world transform was recomputed
+   */
+  void UpdateEntryBounds(const std::vector<SceneGraph::NodeId> &nodes);
+
+  /**
+   * Draw the largest visible entries into the buffer and hide the visible
+   * entries behind them
+   */
+  void CullOccluded(OcclusionBuffer *occlusion);
+
+  void UploadInstanceNodes();
+
+  /**
+   * Make sure a texture buffer holds at least the given number of elements
+   * The content is lost when the buffer grows.
+   *
+   * @returns true - if the buffer was reallocated, otherwise false
+   */
+  static bool ReserveTextureBuffer(GLuint *buffer, GLuint *texture,
+                                   GLenum internal_format, size_t *capacity,
+                                   size_t count, size_t element_size);
+
+  //copying disabled
+  Scene(const Scene &);
+
+  const Scene &operator=(const Scene &);
+};
+
+} // namespace oncgl
+
+#endif // ONCGL_SCENE_SCENE_H
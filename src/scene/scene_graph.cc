@@ -0,0 +1,176 @@
+#include "scene/scene_graph.h"
+
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace oncgl {
+
+namespace {
+
+#ifdef __SSE__
+// out = a * b, all column major
+inline void MultiplySse(const float *a, const float *b, float *out) {
+
+  __m128 a0 = _mm_loadu_ps(a);
+  __m128 a1 = _mm_loadu_ps(a + 4);
+  __m128 a2 = _mm_loadu_ps(a + 8);
+  __m128 a3 = _mm_loadu_ps(a + 12);
+
+  for (int column = 0; column < 4; ++column) {
+    const float *b_column = b + column * 4;
+    __m128 result = _mm_mul_ps(a0, _mm_set1_ps(b_column[ 0 ]));
+    result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b_column[ 1 ])));
+    result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b_column[ 2 ])));
+    result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b_column[ 3 ])));
+    _mm_storeu_ps(out + column * 4, result);
+  }
+}
+#endif
+
+} // namespace
+
+const SceneGraph::NodeId SceneGraph::kNoNode;
+
+void MultiplyWorldTransforms(const SceneGraph::NodeId *ids, size_t count,
+                             const SceneGraph::NodeId *parents,
+                             const glm::mat4 *locals, glm::mat4 *worlds) {
+
+  for (size_t i = 0; i < count; ++i) {
+    SceneGraph::NodeId id = ids[ i ];
+    SceneGraph::NodeId parent = parents[ id ];
+    if (parent == SceneGraph::kNoNode) {
+      worlds[ id ] = locals[ id ];
+      continue;
+    }
+#ifdef __SSE__
+    MultiplySse(&worlds[ parent ][ 0 ][ 0 ], &locals[ id ][ 0 ][ 0 ],
+                &worlds[ id ][ 0 ][ 0 ]);
+#else
+    worlds[ id ] = worlds[ parent ] * locals[ id ];
+#endif
+  }
+}
+
+SceneGraph::NodeId SceneGraph::AddNode(NodeId parent, const glm::mat4 &local) {
+
+  NodeId node = parents_.size();
+  parents_.push_back(parent);
+  first_children_.push_back(kNoNode);
+  next_siblings_.push_back(kNoNode);
+  depths_.push_back(parent == kNoNode ? 0 : depths_[ parent ] + 1);
+  locals_.push_back(local);
+  worlds_.push_back(local);
+  scheduled_.push_back(false);
+
+  if (parent != kNoNode) {
+    next_siblings_[ node ] = first_children_[ parent ];
+    first_children_[ parent ] = node;
+  }
+
+  MarkDirty(node);
+  return node;
+}
+
+void SceneGraph::set_local(NodeId node, const glm::mat4 &local) {
+  locals_[ node ] = local;
+  MarkDirty(node);
+}
+
+const glm::mat4 &SceneGraph::local(NodeId node) const {
+  return locals_[ node ];
+}
+
+const glm::mat4 &SceneGraph::world(NodeId node) const {
+  return worlds_[ node ];
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId node) const {
+  return parents_[ node ];
+}
+
+size_t SceneGraph::size() const {
+  return parents_.size();
+}
+
+const glm::mat4 *SceneGraph::world_matrices() const {
+  return worlds_.empty() ? NULL : &worlds_[ 0 ];
+}
+
+bool SceneGraph::Update(NodeId *first_changed, NodeId *last_changed,
+                        std::vector<NodeId> *changed) {
+
+  changed->clear();
+  if (dirty_roots_.empty()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < dirty_roots_.size(); ++i) {
+    ScheduleSubtree(dirty_roots_[ i ]);
+  }
+  dirty_roots_.clear();
+
+  // a level only depends on the levels above, so every level is one batch
+  NodeId first = kNoNode;
+  NodeId last = 0;
+  for (size_t depth = 0; depth < levels_.size(); ++depth) {
+    std::vector<NodeId> &level = levels_[ depth ];
+    if (level.empty()) {
+      continue;
+    }
+
+    // ascending ids keep the matrix accesses close together
+    std::sort(level.begin(), level.end());
+    MultiplyWorldTransforms(&level[ 0 ], level.size(), &parents_[ 0 ],
+                            &locals_[ 0 ], &worlds_[ 0 ]);
+
+    first = std::min(first, level.front());
+    last = std::max(last, level.back());
+    changed->insert(changed->end(), level.begin(), level.end());
+    for (size_t i = 0; i < level.size(); ++i) {
+      scheduled_[ level[ i ]] = false;
+    }
+    level.clear();
+  }
+
+  *first_changed = first;
+  *last_changed = last;
+  return true;
+}
+
+void SceneGraph::MarkDirty(NodeId node) {
+  dirty_roots_.push_back(node);
+}
+
+void SceneGraph::ScheduleSubtree(NodeId root) {
+
+  if (scheduled_[ root ]) {
+    return;
+  }
+
+  // iterative walk over the subtree, skipping parts scheduled before
+  std::vector<NodeId> stack(1, root);
+  while (!stack.empty()) {
+    NodeId node = stack.back();
+    stack.pop_back();
+    if (scheduled_[ node ]) {
+      continue;
+    }
+    scheduled_[ node ] = true;
+
+    uint32_t depth = depths_[ node ];
+    if (depth >= levels_.size()) {
+      levels_.resize(depth + 1);
+    }
+    levels_[ depth ].push_back(node);
+
+    for (NodeId child = first_children_[ node ]; child != kNoNode;
+         child = next_siblings_[ child ]) {
+      stack.push_back(child);
+    }
+  }
+}
+
+} // namespace oncgl
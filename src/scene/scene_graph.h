@@ -0,0 +1,107 @@
+#ifndef ONCGL_SCENE_SCENE_GRAPH_H
+#define ONCGL_SCENE_SCENE_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace oncgl {
+
+/**
+ * Transform hierarchy stored as flat arrays (structure of arrays)
+ *
+ * Nodes are identified by their index. A node is always added after its
+ * parent, so the arrays are in topological order. Changing a local transform
+ * only marks the node dirty; Update recomputes the world transforms of the
+ * dirty subtrees, level by level, with batched SIMD matrix multiplies. Clean
+ * parts of the hierarchy are never visited.
+ */
+class SceneGraph {
+ public:
+  typedef uint32_t NodeId;
+
+  static const NodeId kNoNode = 0xFFFFFFFFu;
+
+  /**
+   * Append a node
+   *
+   * @param parent  parent node or kNoNode for a root
+   * @param local   transformation relative to the parent
+   * @returns id of the node
+   */
+  NodeId AddNode(NodeId parent, const glm::mat4 &local);
+
+  /**
+   * Set the transformation relative to the parent, the world transforms of
+   * the node and its descendants are updated by the next Update
+   */
+  void set_local(NodeId node, const glm::mat4 &local);
+
+  const glm::mat4 &local(NodeId node) const;
+
+  // world transform as of the last Update
+  const glm::mat4 &world(NodeId node) const;
+
+  NodeId parent(NodeId node) const;
+
+  size_t size() const;
+
+  /**
+   * Recompute the world transforms of all dirty subtrees
+   *
+   * @param first_changed   receives the smallest id that changed
+   * @param last_changed    receives the largest id that changed
+   * @param changed         receives the ids of all recomputed nodes, parents
+   *                        first
+   * @returns true - if any world transform was recomputed, otherwise false
+   */
+  bool Update(NodeId *first_changed, NodeId *last_changed,
+              std::vector<NodeId> *changed);
+
+  /**
+   * World transforms of all nodes, indexed by node id
+   */
+  const glm::mat4 *world_matrices() const;
+
+ private:
+  std::vector<NodeId> parents_;
+  std::vector<NodeId> first_children_;
+  std::vector<NodeId> next_siblings_;
+  std::vector<uint32_t> depths_;
+  std::vector<glm::mat4> locals_;
+  std::vector<glm::mat4> worlds_;
+
+  // nodes whose local transform changed since the last Update
+  std::vector<NodeId> dirty_roots_;
+  // set for nodes already scheduled in the current Update
+  std::vector<bool> scheduled_;
+  // dirty nodes of the current Update, one list per depth
+  std::vector<std::vector<NodeId> > levels_;
+
+  void MarkDirty(NodeId node);
+
+  // schedule a node and all its descendants
+  void ScheduleSubtree(NodeId root);
+};
+
+/**
+ * result[ i ] = parents[ parent_ids[ i ]] * locals[ ids[ i ]] for a batch of
+ * nodes whose parents are already final (SSE when available)
+ *
+ * @param ids       nodes to compute
+ * @param count     number of nodes
+ * @param parents   parent id of every node, kNoNode for roots
+ * @param locals    local transforms of all nodes
+ * @param worlds    world transforms of all nodes, read for the parents and
+ *                  written for the nodes
+ */
+void MultiplyWorldTransforms(const SceneGraph::NodeId *ids, size_t count,
+                             const SceneGraph::NodeId *parents,
+                             const glm::mat4 *locals, glm::mat4 *worlds);
+
+} // namespace oncgl
+
+#endif // ONCGL_SCENE_SCENE_GRAPH_H
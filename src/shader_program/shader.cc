@@ -71,7 +71,7 @@ Shader &Shader::operator=(const Shader &other) {
 }
 
 Shader Shader::ShaderFromFile(const std::string &file_path,
-                              GLenum shader_type) {
+                              GLenum shader_type, const std::string &defines) {
   //open file
   std::ifstream f;
   f.open(file_path.c_str(), std::ios::in | std::ios::binary);
@@ -83,8 +83,16 @@ Shader Shader::ShaderFromFile(const std::string &file_path,
   std::stringstream buffer;
   buffer << f.rdbuf();
 
+  //the #version directive has to stay the first line
+  std::string code = buffer.str();
+  if (!defines.empty()) {
+    size_t line_end = code.find('\n');
+    size_t insert_at = line_end == std::string::npos ? code.size() : line_end + 1;
+    code.insert(insert_at, defines);
+  }
+
   //return new shader
-  Shader shader(buffer.str(), shader_type);
+  Shader shader(code, shader_type);
   return shader;
 }
 
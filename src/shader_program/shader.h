@@ -18,10 +18,13 @@ class Shader {
    *
    * @param  filePath          The path to the shaderfile
    * @param  shaderType        Type of shader. For example GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+   * @param  defines           Lines inserted after the #version line, e.g.
+   *                           "#define PACKED_VERTICES\n"
    * @throws std::exception    On error
    */
   static Shader
-  ShaderFromFile(const std::string &file_path, GLenum shader_type);
+  ShaderFromFile(const std::string &file_path, GLenum shader_type,
+                 const std::string &defines = "");
 
   /**
    * Creates a shader from a string of shader source code.
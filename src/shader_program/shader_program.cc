@@ -1,7 +1,23 @@
 #include "shader_program/shader_program.h"
 
+#include "renderer/gl_state.h"
+
 using namespace oncgl;
 
+namespace {
+
+// FNV-1a, names are short so this is cheaper than a std::string
+uint32_t HashName(const char *name) {
+
+  uint32_t hash = 2166136261u;
+  for (; *name; ++name) {
+    hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+  }
+  return hash;
+}
+
+} // namespace
+
 Program::Program(const std::vector<Shader>& shaders):
     object_(0) {
 
@@ -40,14 +56,16 @@ Program::Program(const std::vector<Shader>& shaders):
     msg += str_info_log;
     delete[] str_info_log;
 
-    glDeleteProgram(object_); object_ = 0;
+    GLState::Instance().DeleteProgram(object_); object_ = 0;
     throw std::runtime_error(msg);
   }
+
+  ReflectUniforms();
 }
 
 Program::~Program() {
   //might be 0 if ctor fails by throwing exception
-  if(object_ != 0) glDeleteProgram(object_);
+  if(object_ != 0) GLState::Instance().DeleteProgram(object_);
 }
 
 GLuint Program::object() const {
@@ -55,18 +73,17 @@ GLuint Program::object() const {
 }
 
 void Program::Use() const {
-  glUseProgram(object_);
+  GLState::Instance().UseProgram(object_);
 }
 
 bool Program::IsInUse() const {
-  GLint currentProgram = 0;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-  return (currentProgram == (GLint) object_);
+  // the shadowed binding, asking GL would stall the pipeline
+  return GLState::Instance().program() == object_;
 }
 
 void Program::StopUsing() const {
   assert(IsInUse());
-  glUseProgram(0);
+  GLState::Instance().UseProgram(0);
 }
 
 GLint Program::attrib(const GLchar *attribName) const {
@@ -86,13 +103,111 @@ GLint Program::uniform(const GLchar* uniformName) const {
     throw std::runtime_error("uniformName was NULL");
   }
 
-  GLint uniform = glGetUniformLocation(object_, uniformName);
+  GLint uniform = FindUniform(uniformName);
   if(uniform == -1) {
     throw std::runtime_error(std::string("Program uniform not found: ") + uniformName);
   }
   return uniform;
 }
 
+GLint Program::FindUniform(const GLchar *uniformName) const {
+
+  if (uniform_slots_.empty()) {
+    return -1;
+  }
+
+  uint32_t hash = HashName(uniformName);
+  size_t mask = uniform_slots_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const UniformSlot &slot = uniform_slots_[ i ];
+    if (slot.location == -1) {
+      return -1;
+    }
+    if (slot.hash == hash && slot.name == uniformName) {
+      return slot.location;
+    }
+  }
+}
+
+bool Program::BindUniformBlock(const GLchar *blockName, GLuint binding) {
+
+  GLuint index = glGetUniformBlockIndex(object_, blockName);
+  if (index == GL_INVALID_INDEX) {
+    return false;
+  }
+  glUniformBlockBinding(object_, index, binding);
+  return true;
+}
+
+void Program::ReflectUniforms() {
+
+  GLint count = 0;
+  GLint max_length = 0;
+  glGetProgramiv(object_, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(object_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+  std::vector<std::pair<std::string, GLint> > uniforms;
+  std::vector<GLchar> buffer(max_length + 1);
+  for (GLint i = 0; i < count; ++i) {
+    GLint size = 0;
+    GLenum type;
+    glGetActiveUniform(object_, i, buffer.size(), NULL, &size, &type,
+                       buffer.data());
+    std::string name(buffer.data());
+    GLint location = glGetUniformLocation(object_, name.c_str());
+    // members of uniform blocks have no location
+    if (location == -1) {
+      continue;
+    }
+    uniforms.push_back(std::make_pair(name, location));
+
+    // arrays are reported as "name[0]", make "name" and every element
+    // findable too
+    size_t bracket = name.rfind("[0]");
+    if (bracket == std::string::npos || bracket + 3 != name.size()) {
+      continue;
+    }
+    std::string base = name.substr(0, bracket);
+    uniforms.push_back(std::make_pair(base, location));
+    for (GLint element = 1; element < size; ++element) {
+      std::string element_name = base + '[' + std::to_string(element) + ']';
+      uniforms.push_back(std::make_pair(
+          element_name, glGetUniformLocation(object_, element_name.c_str())));
+    }
+  }
+
+  // at most half full, so probe sequences stay short and always end
+  size_t capacity = 1;
+  while (capacity < uniforms.size() * 2) {
+    capacity *= 2;
+  }
+  UniformSlot empty = { 0, -1, std::string() };
+  uniform_slots_.assign(capacity, empty);
+  for (size_t i = 0; i < uniforms.size(); ++i) {
+    AddUniform(uniforms[ i ].first, uniforms[ i ].second);
+  }
+}
+
+void Program::AddUniform(const std::string &name, GLint location) {
+
+  if (location == -1) {
+    return;
+  }
+
+  uint32_t hash = HashName(name.c_str());
+  size_t mask = uniform_slots_.size() - 1;
+  size_t i = hash & mask;
+  while (uniform_slots_[ i ].location != -1) {
+    if (uniform_slots_[ i ].name == name) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  uniform_slots_[ i ].hash = hash;
+  uniform_slots_[ i ].location = location;
+  uniform_slots_[ i ].name = name;
+}
+
 #define ATTRIB_N_UNIFORM_SETTERS(OGL_TYPE, TYPE_PREFIX, TYPE_SUFFIX)    \
                                                                         \
   void Program::setAttrib(const GLchar* name, OGL_TYPE v0)              \
@@ -176,17 +291,20 @@ void Program::setUniform(const GLchar* uniformName, const glm::vec4& v) {
 
 void Program::setUniform(const GLchar* uniformName, const PointLight& light) {
 
-  std::string uniName(uniformName);
+  if (pointLightName_ != uniformName) {
+    std::string uniName(uniformName);
+    pointLightName_ = uniName;
 
-  pointLightLocation_.position = glGetUniformLocation(object_, (uniName + ".position").c_str());
+    pointLightLocation_.position = FindUniform((uniName + ".position").c_str());
 
-  pointLightLocation_.color = glGetUniformLocation(object_, (uniName + ".light.color").c_str());
-  pointLightLocation_.ambient_intensity = glGetUniformLocation(object_, (uniName + ".light.ambient_intensity").c_str());
-  pointLightLocation_.diffuse_intensity = glGetUniformLocation(object_, (uniName + ".light.diffuse_intensity").c_str());
+    pointLightLocation_.color = FindUniform((uniName + ".light.color").c_str());
+    pointLightLocation_.ambient_intensity = FindUniform((uniName + ".light.ambient_intensity").c_str());
+    pointLightLocation_.diffuse_intensity = FindUniform((uniName + ".light.diffuse_intensity").c_str());
 
-  pointLightLocation_.attenuation.constant = glGetUniformLocation(object_, (uniName + ".atten.constant").c_str());
-  pointLightLocation_.attenuation.linear = glGetUniformLocation(object_, (uniName + ".atten.linear").c_str());
-  pointLightLocation_.attenuation.exponent = glGetUniformLocation(object_, (uniName + ".atten.exponent").c_str());
+    pointLightLocation_.attenuation.constant = FindUniform((uniName + ".atten.constant").c_str());
+    pointLightLocation_.attenuation.linear = FindUniform((uniName + ".atten.linear").c_str());
+    pointLightLocation_.attenuation.exponent = FindUniform((uniName + ".atten.exponent").c_str());
+  }
 
   glUniform3f(pointLightLocation_.position, light.position.x, light.position.y, light.position.z);
 
@@ -201,13 +319,16 @@ void Program::setUniform(const GLchar* uniformName, const PointLight& light) {
 
 void Program::setUniform(const GLchar* uniformName, const DirectionalLight& light) {
 
-  std::string uniName(uniformName);
+  if (directionalLightName_ != uniformName) {
+    std::string uniName(uniformName);
+    directionalLightName_ = uniName;
 
-  directionalLightLocation_.direction = glGetUniformLocation(object_, (uniName + ".direction").c_str());
+    directionalLightLocation_.direction = FindUniform((uniName + ".direction").c_str());
 
-  directionalLightLocation_.color = glGetUniformLocation(object_, (uniName + ".light.color").c_str());
-  directionalLightLocation_.ambient_intensity = glGetUniformLocation(object_, (uniName + ".light.ambient_intensity").c_str());
-  directionalLightLocation_.diffuse_intensity = glGetUniformLocation(object_, (uniName + ".light.diffuse_intensity").c_str());
+    directionalLightLocation_.color = FindUniform((uniName + ".light.color").c_str());
+    directionalLightLocation_.ambient_intensity = FindUniform((uniName + ".light.ambient_intensity").c_str());
+    directionalLightLocation_.diffuse_intensity = FindUniform((uniName + ".light.diffuse_intensity").c_str());
+  }
 
   glUniform3f(directionalLightLocation_.direction, light.direction.x, light.direction.y, light.direction.z);
 
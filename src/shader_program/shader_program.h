@@ -1,6 +1,9 @@
 #ifndef ONCGL_SHADER_PROGRAM_SHADER_PROGRAM_H
 #define ONCGL_SHADER_PROGRAM_SHADER_PROGRAM_H
 
+#include <stdint.h>
+
+#include <string>
 #include <vector>
 #include <stdexcept>
 
@@ -49,13 +52,33 @@ class Program {
   void StopUsing() const;
 
   /**
-   * Get the uniform index for a given name from glGetUniformLocation
+   * Get the location of an active uniform
+   * Looked up in the table built after linking, no GL call is made.
    *
    * @param  uniformName    Name of unform
    * @result uniformIndex
+   * @throws std::exception    if the uniform is not active
    */
   GLint uniform(const GLchar *uniformName) const;
 
+  /**
+   * Like uniform, but for uniforms the shaders may not use
+   *
+   * @param  uniformName    Name of the uniform, e.g. "lights[2].color"
+   * @result location, -1 if the uniform is not active
+   */
+  GLint FindUniform(const GLchar *uniformName) const;
+
+  /**
+   * Connect a uniform block to a binding point, GLSL 330 has no binding
+   * layout qualifier
+   *
+   * @param  blockName   Name of the block, e.g. "FrameConstants"
+   * @param  binding     Binding point of the buffer
+   * @result true - if the program uses the block, otherwise false
+   */
+  bool BindUniformBlock(const GLchar *blockName, GLuint binding);
+
   /**
    * Setters for attribute and uniform variables.
    * These are convenience methods for the glVertexAttrib* and glUniform* functions.
@@ -124,11 +147,30 @@ class Program {
  private:
   GLuint object_;
 
+  // open addressing table of the active uniforms, filled after linking
+  struct UniformSlot {
+
+    uint32_t hash;
+    GLint location;
+    std::string name;
+  };
+
+  std::vector<UniformSlot> uniform_slots_;
+
+  // fill uniform_slots_ from GL_ACTIVE_UNIFORMS
+  void ReflectUniforms();
+
+  void AddUniform(const std::string &name, GLint location);
+
   //copying disabled
   Program(const Program &);
 
   const Program &operator=(const Program &);
 
+  // the light struct locations are looked up again only if the name changes
+  std::string pointLightName_;
+  std::string directionalLightName_;
+
   struct {
 
     GLint color;
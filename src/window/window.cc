@@ -2,13 +2,24 @@
 #include <lib/glew/include/GL/glew.h>
 
 #include "window/window.h"
+#include "renderer/gl_state.h"
+
+#ifdef ONCGL_HAVE_EGL
+#include <EGL/eglext.h>
+#endif
 
 namespace oncgl {
 
 Window::Window(std::string window_title, int width, int height) :
+    window_(NULL),
     width_(width),
     height_(height),
-    window_title_(window_title) {
+    window_title_(window_title),
+    headless_(false),
+    should_close_(false),
+    framebuffer_(0),
+    color_renderbuffer_(0),
+    depth_renderbuffer_(0) {
 }
 
 void Window::init(void (*KeyCallback)(GLFWwindow *, int, int, int, int),
@@ -41,15 +52,92 @@ void Window::init(void (*KeyCallback)(GLFWwindow *, int, int, int, int),
   glfwMakeContextCurrent(window_);
   glfwSetKeyCallback(window_, KeyCallback);
 
+  InitGlew(true);
+
+  // enable mutlisampling
+  GLState::Instance().Enable(GL_MULTISAMPLE);
+}
+
+void Window::InitHeadless() {
+
+#ifdef ONCGL_HAVE_EGL
+  headless_ = true;
+
+  // prefer the surfaceless platform, it works without any display-server
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  egl_display_ = EGL_NO_DISPLAY;
+  if (get_platform_display) {
+    egl_display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    egl_display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  EGLint major, minor;
+  if (egl_display_ == EGL_NO_DISPLAY ||
+      !eglInitialize(egl_display_, &major, &minor)) {
+    throw std::runtime_error("[Window.cpp] Failed to init EGL display");
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    throw std::runtime_error("[Window.cpp] EGL has no desktop OpenGL support");
+  }
+
+  // the surfaceless platform has no configs at all, we never create a surface
+  // anyway so a context without config is fine (EGL_KHR_no_config_context)
+  EGLint config_attribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(egl_display_, config_attribs, &config, 1,
+                       &num_configs) || num_configs == 0) {
+    config = EGL_NO_CONFIG_KHR;
+  }
+
+  EGLint context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  egl_context_ = eglCreateContext(egl_display_, config, EGL_NO_CONTEXT,
+                                  context_attribs);
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    throw std::runtime_error(
+        "[Window.cpp] eglCreateContext failed. Is OpenGL 3.3 available?");
+  }
+
+  if (!eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                      egl_context_)) {
+    throw std::runtime_error(
+        "[Window.cpp] eglMakeCurrent failed. Surfaceless contexts unsupported?");
+  }
+
+  InitGlew(false);
+
+  CreateOffscreenFramebuffer();
+#else
+  throw std::runtime_error(
+      "[Window.cpp] oncgl was built without EGL, headless mode is unavailable");
+#endif
+}
+
+void Window::InitGlew(bool glx) {
+
   // initialise GLEW
   //stops glew crashing on OSX :-/
   glewExperimental = GL_TRUE;
-  if (glewInit() != GLEW_OK) {
+  // glewInit also initializes GLXEW, which queries the current X display,
+  // an EGL context has none
+  GLenum result = glx ? glewInit() : glewContextInit();
+  if (result != GLEW_OK) {
     throw std::runtime_error("glewInit failed");
   }
 
-  // enable mutlisampling
-  glEnable(GL_MULTISAMPLE);
+  // glewExperimental may leave a GL_INVALID_ENUM behind, clear it
+  glGetError();
 
   // print out some info about the graphics drivers
   std::cout << K_GREEN << "OpenGL version: " << K_RESET <<
@@ -67,6 +155,34 @@ void Window::init(void (*KeyCallback)(GLFWwindow *, int, int, int, int),
   }
 }
 
+void Window::CreateOffscreenFramebuffer() {
+
+  glGenFramebuffers(1, &framebuffer_);
+  glGenRenderbuffers(1, &color_renderbuffer_);
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+
+  GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_renderbuffer_);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error(
+        "[Window.cpp] Failed to create the offscreen framebuffer");
+  }
+
+  glViewport(0, 0, width_, height_);
+}
+
 GLFWwindow *Window::window() const {
   return window_;
 }
@@ -79,11 +195,32 @@ float Window::height() const {
   return height_;
 }
 
+GLuint Window::framebuffer() const {
+  return framebuffer_;
+}
+
+bool Window::headless() const {
+  return headless_;
+}
+
+void Window::SwapBuffers() {
+  if (!headless_) {
+    glfwSwapBuffers(window_);
+  }
+}
+
 void Window::Close() {
-  glfwSetWindowShouldClose(window_, GL_TRUE);
+  if (headless_) {
+    should_close_ = true;
+  } else {
+    glfwSetWindowShouldClose(window_, GL_TRUE);
+  }
 }
 
 int Window::ShouldClose() {
+  if (headless_) {
+    return should_close_;
+  }
   return glfwWindowShouldClose(window_);
 }
 
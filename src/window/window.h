@@ -6,6 +6,10 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#ifdef ONCGL_HAVE_EGL
+#include <EGL/egl.h>
+#endif
+
 #include "window/window.h"
 #include "misc/constants.h"
 
@@ -20,12 +24,35 @@ class Window {
             void (*OnScrollCallback)(GLFWwindow *, double, double),
             void (*OnError)(int, const char *));
 
+  /**
+   * Create an OpenGL context without any visible window
+   * The context is created with EGL on a surfaceless display (Mesa), so no
+   * X-server and no GPU is required. Everything is rendered into an offscreen
+   * framebuffer of the size of the window.
+   *
+   * @throws std::runtime_error   if no context could be created
+   */
+  void InitHeadless();
+
   GLFWwindow *window() const;
 
   float width() const;
 
   float height() const;
 
+  /**
+   * Framebuffer which is presented by SwapBuffers
+   * @returns 0 for a visible window, the offscreen framebuffer otherwise
+   */
+  GLuint framebuffer() const;
+
+  bool headless() const;
+
+  /**
+   * Present the rendered frame. Does nothing in headless mode.
+   */
+  void SwapBuffers();
+
   /**
    * Tell the window it should close
    */
@@ -43,6 +70,29 @@ class Window {
   float width_;
   float height_;
   std::string window_title_;
+
+  bool headless_;
+  bool should_close_;
+
+  // offscreen target for headless rendering
+  GLuint framebuffer_;
+  GLuint color_renderbuffer_;
+  GLuint depth_renderbuffer_;
+
+#ifdef ONCGL_HAVE_EGL
+  EGLDisplay egl_display_;
+  EGLContext egl_context_;
+#endif
+
+  /**
+   * Load the GL entry points of the current context
+   *
+   * @param glx   false for an EGL context, skips the GLX part of GLEW that
+   *              needs a current X display
+   */
+  void InitGlew(bool glx);
+
+  void CreateOffscreenFramebuffer();
 };
 
 } // namespace oncgl
@@ -0,0 +1,137 @@
+#include "scene/occlusion_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model/mesh_optimizer.h"
+
+// Times rasterizing occluders and testing boxes against the CPU occlusion
+// buffer at the resolution the renderer uses, needs no GPU.
+// Usage: occlusion_buffer_benchmark [iterations]
+
+namespace oncgl {
+
+namespace {
+
+typedef std::chrono::high_resolution_clock Clock;
+
+const int kWidth = 320;
+const int kHeight = 176;
+const int kNumOccluders = 64;
+const int kNumBoxes = 100000;
+
+// deterministic, every run times the same scene
+float Random(unsigned int *state, float min, float max) {
+
+  *state = *state * 1664525u + 1013904223u;
+  return min + (max - min) * ((*state >> 8) / 16777216.0f);
+}
+
+// the 12 triangles of a box
+void AddBox(const glm::vec3 &min, const glm::vec3 &max, OccluderMesh *mesh) {
+
+  GLuint base = static_cast<GLuint>(mesh->positions.size());
+  for (int i = 0; i < 8; ++i) {
+    mesh->positions.push_back(glm::vec3(i & 1 ? max.x : min.x,
+                                        i & 2 ? max.y : min.y,
+                                        i & 4 ? max.z : min.z));
+  }
+  const GLuint indices[ 36 ] = {
+    0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+  };
+  for (int i = 0; i < 36; ++i) {
+    mesh->indices.push_back(base + indices[ i ]);
+  }
+}
+
+double Milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+} // namespace oncgl
+
+int main(int argc, char **argv) {
+
+  using namespace oncgl;
+
+  int iterations = argc > 1 ? std::max(1, std::atoi(argv[ 1 ])) : 100;
+
+  glm::mat4 view_projection =
+      glm::perspective(glm::radians(60.0f),
+                       static_cast<float>(kWidth) / kHeight, 0.1f, 500.0f);
+
+  // walls and pillars in front of the camera, boxes scattered behind them
+  unsigned int state = 1;
+  OccluderMesh mesh;
+  for (int i = 0; i < kNumOccluders; ++i) {
+    glm::vec3 center(Random(&state, -40.0f, 40.0f),
+                     Random(&state, -20.0f, 20.0f),
+                     Random(&state, -60.0f, -10.0f));
+    glm::vec3 extent(Random(&state, 1.0f, 8.0f), Random(&state, 1.0f, 8.0f),
+                     Random(&state, 0.5f, 2.0f));
+    AddBox(center - extent, center + extent, &mesh);
+  }
+  FindOccluderNeighbors(&mesh);
+  std::vector<OcclusionBuffer::Occluder> occluders(1);
+  occluders[ 0 ].mesh = &mesh;
+  occluders[ 0 ].transform = glm::mat4(1.0f);
+
+  std::vector<glm::vec3> boxes;
+  boxes.reserve(kNumBoxes);
+  for (int i = 0; i < kNumBoxes; ++i) {
+    glm::vec3 center(Random(&state, -100.0f, 100.0f),
+                     Random(&state, -50.0f, 50.0f),
+                     Random(&state, -200.0f, -20.0f));
+    float extent = Random(&state, 0.2f, 2.0f);
+    boxes.push_back(center - glm::vec3(extent));
+    boxes.push_back(center + glm::vec3(extent));
+  }
+
+  OcclusionBuffer buffer(kWidth, kHeight);
+  ThreadPool pool(std::thread::hardware_concurrency());
+  Clock::duration rasterize_serial(0);
+  Clock::duration rasterize_pool(0);
+  Clock::duration test(0);
+  size_t visible = 0;
+  for (int i = 0; i < iterations; ++i) {
+    Clock::time_point start = Clock::now();
+    buffer.Begin(view_projection);
+    buffer.RenderOccluders(occluders, NULL);
+    rasterize_serial += Clock::now() - start;
+
+    start = Clock::now();
+    buffer.Begin(view_projection);
+    buffer.RenderOccluders(occluders, &pool);
+    rasterize_pool += Clock::now() - start;
+
+    start = Clock::now();
+    visible = 0;
+    for (size_t b = 0; b < boxes.size(); b += 2) {
+      visible += buffer.TestBox(boxes[ b ], boxes[ b + 1 ]);
+    }
+    test += Clock::now() - start;
+  }
+
+#ifdef __SSE__
+  std::cout << "occlusion buffer " << kWidth << "x" << kHeight << ", SSE, "
+#else
+  std::cout << "occlusion buffer " << kWidth << "x" << kHeight << ", scalar, "
+#endif
+            << iterations << " iterations" << std::endl;
+  std::cout << "  rasterize " << buffer.num_triangles() << " triangles: "
+            << Milliseconds(rasterize_serial) / iterations << " ms, "
+            << Milliseconds(rasterize_pool) / iterations << " ms on "
+            << pool.size() + 1 << " threads" << std::endl;
+  std::cout << "  test " << kNumBoxes << " boxes: "
+            << Milliseconds(test) / iterations << " ms, " << visible
+            << " visible" << std::endl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+#include "scene/occlusion_buffer.h"
+
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "misc/constants.h"
+#include "model/mesh_optimizer.h"
+
+// Tests of the CPU occlusion buffer, built once with and once without SSE.
+// Returns a non-zero exit code if any check fails.
+
+namespace oncgl {
+
+namespace {
+
+const int kWidth = 320;
+const int kHeight = 176;
+
+int gFailures = 0;
+
+void Check(bool condition, const char *what) {
+
+  if (!condition) {
+    std::cout << K_RED << "FAILED: " << what << K_RESET << std::endl;
+    gFailures++;
+  }
+}
+
+// quad from two triangles, counterclockwise seen from +z
+void AddQuad(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+             const glm::vec3 &d, OccluderMesh *mesh) {
+
+  GLuint base = static_cast<GLuint>(mesh->positions.size());
+  mesh->positions.push_back(a);
+  mesh->positions.push_back(b);
+  mesh->positions.push_back(c);
+  mesh->positions.push_back(d);
+  const GLuint indices[ 6 ] = { 0, 1, 2, 0, 2, 3 };
+  for (int i = 0; i < 6; ++i) {
+    mesh->indices.push_back(base + indices[ i ]);
+  }
+}
+
+// links the triangles like the model import does
+void Render(OccluderMesh *mesh, ThreadPool *pool, OcclusionBuffer *buffer) {
+
+  FindOccluderNeighbors(mesh);
+  std::vector<OcclusionBuffer::Occluder> occluders(1);
+  occluders[ 0 ].mesh = mesh;
+  occluders[ 0 ].transform = glm::mat4(1.0f);
+  buffer->RenderOccluders(occluders, pool);
+}
+
+// The view projection is the identity, positions are in NDC and the
+// occluders sit at depth 0.5. Two quads leave a gap 0.3 pixels wide.
+void TestGap(ThreadPool *pool) {
+
+  OcclusionBuffer buffer(kWidth, kHeight);
+  buffer.Begin(glm::mat4(1.0f));
+
+  const float pixel = 2.0f / kWidth;
+  const float gap_min = 0.1f;
+  const float gap_max = gap_min + 0.3f * pixel;
+  OccluderMesh mesh;
+  AddQuad(glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(gap_min, -1.0f, 0.0f),
+          glm::vec3(gap_min, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f),
+          &mesh);
+  AddQuad(glm::vec3(gap_max, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f),
+          glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(gap_max, 1.0f, 0.0f),
+          &mesh);
+  Render(&mesh, pool, &buffer);
+  Check(buffer.num_triangles() == 4, "gap: all triangles rasterized");
+
+  Check(buffer.TestBox(glm::vec3(gap_min + 0.05f * pixel, -0.2f, 0.5f),
+                       glm::vec3(gap_max - 0.05f * pixel, 0.2f, 0.6f)),
+        "gap: box behind the gap is visible");
+  Check(!buffer.TestBox(glm::vec3(-0.3f, -0.9f, 0.5f),
+                        glm::vec3(-0.2f, -0.7f, 0.6f)),
+        "gap: box behind the left quad is culled");
+  Check(!buffer.TestBox(glm::vec3(0.4f, 0.2f, 0.5f),
+                        glm::vec3(0.7f, 0.6f, 0.6f)),
+        "gap: box behind the diagonal of the right quad is culled");
+  Check(buffer.TestBox(glm::vec3(-0.3f, -0.9f, -0.6f),
+                       glm::vec3(-0.2f, -0.7f, -0.5f)),
+        "gap: box in front of the quads is visible");
+}
+
+// A perspective camera at the origin looking down -z, occluders crossing the
+// near plane are skipped but must not break the others.
+void TestNearPlane(ThreadPool *pool) {
+
+  glm::mat4 view_projection =
+      glm::perspective(glm::radians(60.0f),
+                       static_cast<float>(kWidth) / kHeight, 0.1f, 100.0f);
+  OcclusionBuffer buffer(kWidth, kHeight);
+  buffer.Begin(view_projection);
+
+  // floor from behind the camera to far in front of it
+  OccluderMesh crossing;
+  AddQuad(glm::vec3(-20.0f, -1.0f, 5.0f), glm::vec3(20.0f, -1.0f, 5.0f),
+          glm::vec3(20.0f, -1.0f, -50.0f), glm::vec3(-20.0f, -1.0f, -50.0f),
+          &crossing);
+  Render(&crossing, pool, &buffer);
+  Check(buffer.num_triangles() == 0,
+        "near plane: crossing triangles are skipped");
+  Check(buffer.TestBox(glm::vec3(-1.0f, -3.0f, -11.0f),
+                       glm::vec3(1.0f, -2.0f, -10.0f)),
+        "near plane: box below the skipped floor is visible");
+
+  // wall covering the whole screen
+  OccluderMesh wall;
+  AddQuad(glm::vec3(-20.0f, -20.0f, -5.0f), glm::vec3(20.0f, -20.0f, -5.0f),
+          glm::vec3(20.0f, 20.0f, -5.0f), glm::vec3(-20.0f, 20.0f, -5.0f),
+          &wall);
+  Render(&wall, pool, &buffer);
+  Check(buffer.num_triangles() == 2, "near plane: wall rasterized");
+  Check(!buffer.TestBox(glm::vec3(-1.0f, -1.0f, -11.0f),
+                        glm::vec3(1.0f, 1.0f, -10.0f)),
+        "near plane: box behind the wall is culled");
+  Check(buffer.TestBox(glm::vec3(-1.0f, -1.0f, -4.0f),
+                       glm::vec3(1.0f, 1.0f, -3.0f)),
+        "near plane: box in front of the wall is visible");
+  Check(buffer.TestBox(glm::vec3(-1.0f, -1.0f, -1.0f),
+                       glm::vec3(1.0f, 1.0f, 1.0f)),
+        "near plane: box around the camera is visible");
+}
+
+} // namespace
+
+} // namespace oncgl
+
+int main() {
+
+#ifdef __SSE__
+  std::cout << "occlusion buffer test, SSE" << std::endl;
+#else
+  std::cout << "occlusion buffer test, scalar" << std::endl;
+#endif
+
+  // once on the calling thread only and once in bands on a pool
+  oncgl::ThreadPool pool(3);
+  oncgl::ThreadPool *pools[ 2 ] = { NULL, &pool };
+  for (int i = 0; i < 2; ++i) {
+    oncgl::TestGap(pools[ i ]);
+    oncgl::TestNearPlane(pools[ i ]);
+  }
+
+  if (oncgl::gFailures) {
+    std::cout << oncgl::gFailures << " checks failed" << std::endl;
+    return 1;
+  }
+  std::cout << "all checks passed" << std::endl;
+  return 0;
+}